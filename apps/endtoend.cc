@@ -1,12 +1,15 @@
 #include "address.hh"
 #include "arp_message.hh"
 #include "bidirectional_stream_copy.hh"
+#include "decoded_frame.hh"
 #include "exception.hh"
+#include "packet_pool.hh"
 #include "router.hh"
 #include "tcp_minnow_socket.cc"
 #include "tcp_over_ip.hh"
 
 #include <cstdlib>
+#include <deque>
 #include <iostream>
 #include <thread>
 
@@ -40,19 +43,18 @@ EthernetAddress random_router_ethernet_address()
 string summary( const EthernetFrame& frame )
 {
   std::string out = frame.header.to_string() + ", payload: ";
+  DecodedFrame decoded { frame };
   switch ( frame.header.type ) {
     case EthernetHeader::TYPE_IPv4: {
-      InternetDatagram dgram;
-      if ( parse( dgram, frame.payload ) ) {
-        out.append( "IPv4: " + dgram.header.to_string() );
+      if ( const InternetDatagram* dgram = decoded.ipv4() ) {
+        out.append( "IPv4: " + dgram->header.to_string() );
       } else {
         out.append( "bad IPv4 datagram" );
       }
     } break;
     case EthernetHeader::TYPE_ARP: {
-      ARPMessage arp;
-      if ( parse( arp, frame.payload ) ) {
-        out.append( "ARP: " + arp.to_string() );
+      if ( const ARPMessage* arp = decoded.arp() ) {
+        out.append( "ARP: " + arp->to_string() );
       } else {
         out.append( "bad ARP message" );
       }
@@ -81,6 +83,44 @@ optional<EthernetFrame> maybe_receive_frame( FileDescriptor& fd )
   return frame;
 }
 
+// maximum number of frames moved by one system call between the router and its sockets
+static constexpr size_t FRAME_BATCH = 32;
+
+// receive up to FRAME_BATCH frames with one system call
+vector<EthernetFrame> receive_frames( DatagramSocket& socket, DatagramBatch& batch )
+{
+  socket.recv_batch( batch );
+
+  vector<EthernetFrame> frames;
+  for ( size_t i = 0; i < batch.size(); ++i ) {
+    EthernetFrame frame;
+    string bytes = PacketPool::take( batch[i].size() );
+    bytes.assign( batch[i] );
+    if ( parse( frame, { Buffer { move( bytes ) } } ) ) {
+      frames.push_back( move( frame ) );
+    }
+  }
+  return frames;
+}
+
+// send up to FRAME_BATCH frames from the front of the queue with one system call
+void send_frames( DatagramSocket& socket,
+                  deque<EthernetFrame>& frames,
+                  const string& debug_prefix,
+                  const bool debug )
+{
+  vector<vector<Buffer>> datagrams;
+  for ( size_t i = 0; i < min( FRAME_BATCH, frames.size() ); ++i ) {
+    if ( debug ) {
+      cerr << debug_prefix << summary( frames[i] ) << "\n";
+    }
+    datagrams.push_back( serialize( frames[i] ) );
+  }
+
+  const size_t sent = socket.send_batch( datagrams );
+  frames.erase( frames.begin(), frames.begin() + static_cast<ptrdiff_t>( sent ) );
+}
+
 class NetworkInterfaceAdapter : public TCPOverIPv4Adapter
 {
 private:
@@ -215,40 +255,34 @@ void program_body( bool is_client, const string& bounce_host, const string& boun
 
   atomic<bool> exit_flag {};
 
-  queue<EthernetFrame> router_to_host;
-  queue<EthernetFrame> router_to_internet;
+  deque<EthernetFrame> router_to_host;
+  deque<EthernetFrame> router_to_internet;
+
+  /* the router's end of the host's frame socket pair */
+  LocalDatagramSocket host_frames { sock.adapter().frame_fd().duplicate() };
+  DatagramBatch inbound_batch { FRAME_BATCH, 16384 };
 
   /* set up the network */
   thread network_thread( [&]() {
     try {
       EventLoop event_loop;
       // Frames from host to router
-      event_loop.add_rule( "frames from host to router", sock.adapter().frame_fd(), Direction::In, [&] {
-        auto frame_opt = maybe_receive_frame( sock.adapter().frame_fd() );
-        if ( not frame_opt ) {
-          return;
-        }
-        EthernetFrame frame = move( frame_opt.value() );
-        if ( debug ) {
-          cerr << "     Host->router:     " << summary( frame ) << "\n";
+      event_loop.add_rule( "frames from host to router", host_frames, Direction::In, [&] {
+        for ( const auto& frame : receive_frames( host_frames, inbound_batch ) ) {
+          if ( debug ) {
+            cerr << "     Host->router:     " << summary( frame ) << "\n";
+          }
+          router.interface( host_side ).recv_frame( frame );
         }
-        router.interface( host_side ).recv_frame( frame );
         router.route();
       } );
 
       // Frames from router to host
       event_loop.add_rule(
         "frames from router to host",
-        sock.adapter().frame_fd(),
+        host_frames,
         Direction::Out,
-        [&] {
-          auto& f = router_to_host;
-          if ( debug ) {
-            cerr << "     Router->host:     " << summary( f.front() ) << "\n";
-          }
-          sock.adapter().frame_fd().write( serialize( f.front() ) );
-          f.pop();
-        },
+        [&] { send_frames( host_frames, router_to_host, "     Router->host:     ", debug ); },
         [&] { return not router_to_host.empty(); } );
 
       // Frames from router to Internet
@@ -256,27 +290,17 @@ void program_body( bool is_client, const string& bounce_host, const string& boun
         "frames from router to Internet",
         internet_socket,
         Direction::Out,
-        [&] {
-          auto& f = router_to_internet;
-          if ( debug ) {
-            cerr << "     Router->Internet: " << summary( f.front() ) << "\n";
-          }
-          internet_socket.write( serialize( f.front() ) );
-          f.pop();
-        },
+        [&] { send_frames( internet_socket, router_to_internet, "     Router->Internet: ", debug ); },
         [&] { return not router_to_internet.empty(); } );
 
       // Frames from Internet to router
       event_loop.add_rule( "frames from Internet to router", internet_socket, Direction::In, [&] {
-        auto frame_opt = maybe_receive_frame( internet_socket );
-        if ( not frame_opt ) {
-          return;
-        }
-        EthernetFrame frame = move( frame_opt.value() );
-        if ( debug ) {
-          cerr << "     Internet->router: " << summary( frame ) << "\n";
+        for ( const auto& frame : receive_frames( internet_socket, inbound_batch ) ) {
+          if ( debug ) {
+            cerr << "     Internet->router: " << summary( frame ) << "\n";
+          }
+          router.interface( internet_side ).recv_frame( frame );
         }
-        router.interface( internet_side ).recv_frame( frame );
         router.route();
       } );
 
@@ -288,10 +312,10 @@ void program_body( bool is_client, const string& bounce_host, const string& boun
         router.interface( host_side ).tick( 10 );
         router.interface( internet_side ).tick( 10 );
         while ( auto frame = router.interface( host_side ).maybe_send() ) {
-          router_to_host.push( move( frame.value() ) );
+          router_to_host.push_back( move( frame.value() ) );
         }
         while ( auto frame = router.interface( internet_side ).maybe_send() ) {
-          router_to_internet.push( move( frame.value() ) );
+          router_to_internet.push_back( move( frame.value() ) );
         }
 
         if ( exit_flag ) {
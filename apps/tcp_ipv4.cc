@@ -11,6 +11,7 @@
 #include <span>
 #include <string>
 #include <tuple>
+#include <utility>
 
 using namespace std;
 
@@ -34,7 +35,8 @@ static void show_usage( const char* argv0, const char* msg )
 
        << "   -t <tmout>      Set rt_timeout to tmout                         " << TCPConfig::TIMEOUT_DFLT << "\n\n"
 
-       << "   -d <tundev>     Connect to tun <tundev>                         " << TUN_DFLT << "\n\n"
+       << "   -d <tundev>     Connect to tun <tundev>                         " << TUN_DFLT << "\n"
+       << "   -V              Use virtio-net headers (checksum offload, GSO)  (off)\n\n"
 
        << "   -Lu <loss>      Set uplink loss to <rate> (float in 0..1)       (no loss)\n"
        << "   -Ld <loss>      Set downlink loss to <rate> (float in 0..1)     (no loss)\n\n"
@@ -55,7 +57,7 @@ static void check_argc( const span<char*>& args, size_t curr, const char* err )
   }
 }
 
-static tuple<TCPConfig, FdAdapterConfig, bool, const char*> get_config( const span<char*>& args )
+static tuple<TCPConfig, FdAdapterConfig, bool, const char*, bool> get_config( const span<char*>& args )
 {
   TCPConfig c_fsm {};
   FdAdapterConfig c_filt {};
@@ -63,6 +65,7 @@ static tuple<TCPConfig, FdAdapterConfig, bool, const char*> get_config( const sp
 
   size_t curr = 1;
   bool listen = false;
+  bool vnet_hdr = false;
   const size_t argc = args.size();
 
   string source_address = LOCAL_ADDRESS_DFLT;
@@ -73,6 +76,10 @@ static tuple<TCPConfig, FdAdapterConfig, bool, const char*> get_config( const sp
       listen = true;
       curr += 1;
 
+    } else if ( strncmp( "-V", args[curr], 3 ) == 0 ) {
+      vnet_hdr = true;
+      curr += 1;
+
     } else if ( strncmp( "-a", args[curr], 3 ) == 0 ) {
       check_argc( args, curr, "ERROR: -a requires one argument." );
       source_address = args[curr + 1];
@@ -136,7 +143,7 @@ static tuple<TCPConfig, FdAdapterConfig, bool, const char*> get_config( const sp
     c_filt.source = { source_address, source_port };
   }
 
-  return make_tuple( c_fsm, c_filt, listen, tundev );
+  return make_tuple( c_fsm, c_filt, listen, tundev, vnet_hdr );
 }
 
 int main( int argc, char** argv )
@@ -153,9 +160,10 @@ int main( int argc, char** argv )
       return EXIT_FAILURE;
     }
 
-    auto [c_fsm, c_filt, listen, tun_dev_name] = get_config( args );
-    LossyTCPOverIPv4MinnowSocket tcp_socket( LossyTCPOverIPv4OverTunFdAdapter(
-      TCPOverIPv4OverTunFdAdapter( TunFD( tun_dev_name == nullptr ? TUN_DFLT : tun_dev_name ) ) ) );
+    auto [c_fsm, c_filt, listen, tun_dev_name, vnet_hdr] = get_config( args );
+    TunFD tun { tun_dev_name == nullptr ? TUN_DFLT : tun_dev_name, false, vnet_hdr };
+    LossyTCPOverIPv4MinnowSocket tcp_socket(
+      LossyTCPOverIPv4OverTunFdAdapter( TCPOverIPv4OverTunFdAdapter( move( tun ) ) ) );
 
     if ( listen ) {
       tcp_socket.listen_and_accept( c_fsm, c_filt );
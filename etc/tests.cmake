@@ -55,8 +55,29 @@ ttest(send_close)
 ttest(send_extra)
 
 ttest(net_interface)
+ttest(arp_table)
+ttest(net_interface_queues)
 
 ttest(router)
+ttest(prefix_trie)
+ttest(dir_24_8)
+ttest(route_cache)
+ttest(router_batch)
+ttest(router_parallel)
+ttest(router_ecmp)
+
+ttest(io_uring_loopback)
+ttest(vnet_offload)
+ttest(tun_queues)
+
+ttest(checksum)
+ttest(buffer_slices)
+ttest(packet_pool)
+ttest(packet_builder)
+ttest(header_layout)
+ttest(packet_view)
+ttest(ethernet_frame)
+ttest(tcp_demux)
 
 add_custom_target (check0 COMMAND ${CMAKE_CTEST_COMMAND} --output-on-failure --stop-on-failure --timeout 12 -R 'webget|^byte_stream_')
 
@@ -90,3 +111,14 @@ set_tests_properties(${compile_name_opt} PROPERTIES FIXTURES_SETUP compile_opt)
 
 stest(byte_stream_speed_test)
 stest(reassembler_speed_test)
+stest(udp_batch_speed_test)
+stest(checksum_speed_test)
+stest(router_speed_test)
+stest(route_lookup_speed_test)
+stest(route_cache_speed_test)
+stest(router_parallel_speed_test)
+stest(arp_cache_speed_test)
+stest(forwarding_alloc_speed_test)
+stest(parse_speed_test)
+stest(send_path_speed_test)
+stest(header_codec_speed_test)
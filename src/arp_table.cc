@@ -0,0 +1,94 @@
+#include "arp_table.hh"
+
+#include <utility>
+
+using namespace std;
+
+void ArpTable::learn( const uint32_t ip_address, const EthernetAddress& ethernet_address, const uint64_t deadline )
+{
+  this->set( Entry { ip_address, ethernet_address, true, deadline } );
+  this->resolved_expiries_.push_back( { deadline, ip_address } );
+}
+
+void ArpTable::request_sent( const uint32_t ip_address, const uint64_t deadline )
+{
+  this->set( Entry { ip_address, ETHERNET_BROADCAST, false, deadline } );
+  this->pending_expiries_.push_back( { deadline, ip_address } );
+}
+
+void ArpTable::set( const Entry& entry )
+{
+  if ( ( this->size_ + 1 ) * 2 > this->slots_.size() ) {
+    this->grow();
+  }
+  size_t i = this->slot_for( entry.ip_address );
+  while ( this->slots_[i].occupied and this->slots_[i].entry.ip_address != entry.ip_address ) {
+    i = ( i + 1 ) & this->mask_;
+  }
+  if ( not this->slots_[i].occupied ) {
+    this->slots_[i].occupied = true;
+    this->size_++;
+  }
+  this->slots_[i].entry = entry;
+}
+
+bool ArpTable::erase( const uint32_t ip_address )
+{
+  size_t i = this->slot_for( ip_address );
+  while ( this->slots_[i].occupied and this->slots_[i].entry.ip_address != ip_address ) {
+    i = ( i + 1 ) & this->mask_;
+  }
+  if ( not this->slots_[i].occupied ) {
+    return false;
+  }
+
+  // Close the gap: move back any later entry in the run whose home slot is at or before the gap
+  size_t gap = i;
+  for ( size_t j = ( gap + 1 ) & this->mask_; this->slots_[j].occupied; j = ( j + 1 ) & this->mask_ ) {
+    const size_t home = this->slot_for( this->slots_[j].entry.ip_address );
+    if ( ( ( j - home ) & this->mask_ ) >= ( ( j - gap ) & this->mask_ ) ) {
+      this->slots_[gap] = this->slots_[j];
+      gap = j;
+    }
+  }
+  this->slots_[gap] = Slot {};
+  this->size_--;
+  return true;
+}
+
+vector<uint32_t> ArpTable::expire( const uint64_t now )
+{
+  vector<uint32_t> unanswered;
+  this->expire( this->resolved_expiries_, now, nullptr );
+  this->expire( this->pending_expiries_, now, &unanswered );
+  return unanswered;
+}
+
+// unanswered: where to add the addresses of the pending entries that are removed (or nullptr)
+void ArpTable::expire( deque<Expiry>& expiries, const uint64_t now, vector<uint32_t>* unanswered )
+{
+  while ( not expiries.empty() and expiries.front().deadline <= now ) {
+    const Expiry expiry = expiries.front();
+    expiries.pop_front();
+    const Entry* entry = this->find( expiry.ip_address );
+    if ( entry != nullptr and entry->deadline <= now ) { // (not renewed since)
+      if ( unanswered != nullptr and not entry->resolved ) {
+        unanswered->push_back( expiry.ip_address );
+      }
+      this->erase( expiry.ip_address );
+    }
+  }
+}
+
+void ArpTable::grow()
+{
+  vector<Slot> old = move( this->slots_ );
+  this->slots_ = vector<Slot>( old.size() * 2 );
+  this->mask_ = this->slots_.size() - 1;
+  this->size_ = 0;
+  for ( const Slot& slot : old ) {
+    if ( slot.occupied ) {
+      this->set( slot.entry );
+    }
+  }
+}
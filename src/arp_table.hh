@@ -0,0 +1,87 @@
+#pragma once
+
+#include "ethernet_header.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// The neighbours that a NetworkInterface knows about: a flat, open-addressing (linear probing)
+// hash table from IP address to Ethernet address, plus the addresses with an ARP request in
+// flight but no reply yet.
+//
+// Every entry has a deadline, after which it disappears. All resolved entries live equally long,
+// and so do all pending ones, so each kind gets a queue that is already in deadline order:
+// expiring entries only ever looks at the front of the two queues. Erased entries are really
+// removed (by shifting the rest of their probe sequence back), so the table does not fill up
+// with dead entries.
+class ArpTable
+{
+public:
+  struct Entry
+  {
+    uint32_t ip_address {};
+    EthernetAddress ethernet_address {};
+    bool resolved {}; // false: a request is pending
+    uint64_t deadline {};
+  };
+
+  // The entry for `ip_address`, or nullptr
+  const Entry* find( const uint32_t ip_address ) const
+  {
+    for ( size_t i = slot_for( ip_address );; i = ( i + 1 ) & mask_ ) {
+      const Slot& slot = slots_[i];
+      if ( not slot.occupied ) {
+        return nullptr;
+      }
+      if ( slot.entry.ip_address == ip_address ) {
+        return &slot.entry;
+      }
+    }
+  }
+
+  // Remember that `ip_address` is at `ethernet_address`, until `deadline`
+  void learn( uint32_t ip_address, const EthernetAddress& ethernet_address, uint64_t deadline );
+
+  // Remember that an ARP request for `ip_address` is in flight, until `deadline`
+  void request_sent( uint32_t ip_address, uint64_t deadline );
+
+  // Remove the entry for `ip_address`; returns false if there was none
+  bool erase( uint32_t ip_address );
+
+  // Remove every entry whose deadline is at or before `now`; returns the addresses whose requests
+  // were still pending (unanswered) when they expired
+  std::vector<uint32_t> expire( uint64_t now );
+
+  size_t size() const { return size_; }
+
+private:
+  struct Slot
+  {
+    bool occupied {};
+    Entry entry {};
+  };
+
+  // A deadline as queued when it was set (outdated if the entry has since been renewed or removed)
+  struct Expiry
+  {
+    uint64_t deadline;
+    uint32_t ip_address;
+  };
+
+  std::vector<Slot> slots_ = std::vector<Slot>( 16 );
+  size_t mask_ { 15 };
+  size_t size_ {};
+  std::deque<Expiry> resolved_expiries_ {};
+  std::deque<Expiry> pending_expiries_ {};
+
+  size_t slot_for( const uint32_t ip_address ) const
+  {
+    return ( static_cast<uint64_t>( ip_address ) * 0x9e3779b97f4a7c15 >> 32 ) & mask_;
+  }
+
+  void set( const Entry& entry );
+  void expire( std::deque<Expiry>& expiries, uint64_t now, std::vector<uint32_t>* unanswered );
+  void grow();
+};
@@ -0,0 +1,38 @@
+#include "dir_24_8.hh"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+Dir24_8Table::Dir24_8Table( vector<Route> routes ) : tbl24_( size_t { 1 } << 24, NO_ROUTE )
+{
+  // Install shorter prefixes first, so that longer ones overwrite the parts they cover
+  ranges::stable_sort( routes, {}, &Route::length );
+
+  for ( const auto& route : routes ) {
+    if ( route.next_hop == NO_ROUTE or route.next_hop > MAX_NEXT_HOP or route.length > 32 ) {
+      throw runtime_error( "Dir24_8Table: invalid route" );
+    }
+    const uint32_t prefix = route.length == 0 ? 0 : route.prefix & ( 0xffffffff << ( 32 - route.length ) );
+
+    if ( route.length <= 24 ) {
+      const auto first = tbl24_.begin() + ( prefix >> 8 );
+      fill( first, first + ( size_t { 1 } << ( 24 - route.length ) ), route.next_hop );
+      continue;
+    }
+
+    uint16_t& entry = tbl24_[prefix >> 8];
+    if ( not( entry & OVERFLOW ) ) {
+      // give this /24 an overflow block, starting out with whatever covered the whole /24
+      const size_t block = tbl8_.size() >> 8;
+      if ( block >= MAX_OVERFLOW_BLOCKS ) {
+        throw runtime_error( "Dir24_8Table: too many prefixes longer than /24" );
+      }
+      tbl8_.resize( tbl8_.size() + 256, entry );
+      entry = static_cast<uint16_t>( OVERFLOW | block );
+    }
+    const auto first = tbl8_.begin() + ( static_cast<size_t>( entry & ~OVERFLOW ) << 8 | ( prefix & 0xff ) );
+    fill( first, first + ( size_t { 1 } << ( 32 - route.length ) ), route.next_hop );
+  }
+}
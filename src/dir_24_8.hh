@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A DIR-24-8 forwarding table (Gupta, Lin & McKeown, "Routing Lookups in Hardware at Memory
+// Access Speeds", 1998): one entry for every /24, indexed directly by the top 24 bits of the
+// address, plus a 256-entry overflow block for each /24 that contains longer prefixes.
+// A lookup takes one memory access, or two for addresses covered by a prefix longer than /24.
+//
+// The table maps addresses to small next-hop numbers; the owner keeps the next hops themselves.
+// It is built all at once and is not modified afterwards.
+class Dir24_8Table
+{
+public:
+  static constexpr uint16_t NO_ROUTE = 0;
+  static constexpr uint16_t MAX_NEXT_HOP = 0x7fff;
+  static constexpr size_t MAX_OVERFLOW_BLOCKS = 0x8000; // (so the most /24s with prefixes longer than /24)
+
+  struct Route
+  {
+    uint32_t prefix;
+    uint8_t length;
+    uint16_t next_hop; // 1 to MAX_NEXT_HOP
+  };
+
+  // Build the table from a set of routes (with distinct prefixes)
+  explicit Dir24_8Table( std::vector<Route> routes );
+
+  // The next hop of the longest prefix that matches `address`, or NO_ROUTE
+  uint16_t lookup( const uint32_t address ) const
+  {
+    const uint16_t entry = tbl24_[address >> 8];
+    if ( not( entry & OVERFLOW ) ) {
+      return entry;
+    }
+    return tbl8_[static_cast<size_t>( entry & ~OVERFLOW ) << 8 | ( address & 0xff )];
+  }
+
+  // Number of /24s that needed an overflow block
+  size_t overflow_blocks() const { return tbl8_.size() >> 8; }
+
+private:
+  static constexpr uint16_t OVERFLOW = 0x8000; // the rest of the entry is the index of an overflow block
+
+  std::vector<uint16_t> tbl24_;
+  std::vector<uint16_t> tbl8_ {};
+};
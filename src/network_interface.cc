@@ -2,8 +2,10 @@
 
 #include "address.hh"
 #include "arp_message.hh"
+#include "decoded_frame.hh"
 #include "ethernet_frame.hh"
 #include "ethernet_header.hh"
+#include "packet_view.hh"
 #include "parser.hh"
 #include <optional>
 #include <utility>
@@ -19,7 +21,9 @@ NetworkInterface::NetworkInterface( const EthernetAddress& ethernet_address, con
   , arq_cache_timeout_( 30 * 1000 )
   , time( 0 )
   , arp_cache_()
-  , buffer_()
+  , ready_()
+  , waiting_()
+  , waiting_drops_( 0 )
 {
   cerr << "DEBUG: Network interface has Ethernet address " << to_string( ethernet_address_ ) << " and IP address "
        << ip_address.ip() << "\n";
@@ -36,31 +40,71 @@ void NetworkInterface::send_datagram( const InternetDatagram& dgram, const Addre
   if ( dgram.header.dst == 0 ) {
     cerr << "DEBUG: Interface need send TCP packet which dst is 0" << endl;
   }
-  EthernetFrame frame {
-    .header { .dst = ETHERNET_BROADCAST, .src = this->ethernet_address_, .type = EthernetHeader::TYPE_IPv4 },
-    .payload = serialize( dgram ) };
-  if ( this->arp_cache_.count( next_hop.ipv4_numeric() ) && this->arp_cache_[next_hop.ipv4_numeric()].work ) {
-    frame.header.dst = this->arp_cache_[next_hop.ipv4_numeric()].addr;
+  this->send_or_wait( dgram, next_hop );
+}
+
+// datagram: the bytes of an IPv4 datagram, header included
+void NetworkInterface::send_datagram( const Buffer& datagram, const Address& next_hop )
+{
+  this->send_or_wait( datagram, next_hop );
+}
+
+template<class Datagram>
+void NetworkInterface::send_or_wait( const Datagram& datagram, const Address& next_hop )
+{
+  const uint32_t next_hop_ip = next_hop.ipv4_numeric();
+  const ArpTable::Entry* neighbor = this->arp_cache_.find( next_hop_ip );
+  if ( neighbor != nullptr && neighbor->resolved ) {
+    this->ready_.push( ipv4_frame( datagram, neighbor->ethernet_address ) );
+    return;
+  }
+
+  // Park the datagram until the ARP reply comes (asking now, unless a request is already in flight)
+  auto& waiting = this->waiting_[next_hop_ip];
+  if ( waiting.size() >= MAX_WAITING_FRAMES ) {
+    this->waiting_drops_++;
+  } else {
+    waiting.push( datagram );
+  }
+  if ( neighbor == nullptr ) {
+    this->send_arp_request( next_hop_ip );
   }
-  this->buffer_.push_back( make_pair( std::move( frame ), next_hop ) );
 }
 
 // frame: the incoming Ethernet frame
 optional<InternetDatagram> NetworkInterface::recv_frame( const EthernetFrame& frame )
+{
+  const optional<Buffer> raw = this->recv_frame_raw( frame );
+  InternetDatagram idata;
+  if ( !raw.has_value() || !parse( idata, { raw.value() } ) ) {
+    return {};
+  }
+  return idata;
+}
+
+optional<Buffer> NetworkInterface::recv_frame_raw( const EthernetFrame& frame )
 {
   if ( frame.header.dst != ETHERNET_BROADCAST && frame.header.dst != this->ethernet_address_ ) {
     return {};
   }
   if ( frame.header.type == EthernetHeader::TYPE_ARP ) {
-    ARPMessage m;
-    if ( !parse( m, frame.payload ) ) {
+    DecodedFrame decoded { frame };
+    const ARPMessage* arp = decoded.arp();
+    if ( arp == nullptr || !arp->supported() ) {
       return {};
     }
-    if ( !m.supported() ) {
-      return {};
+    const ARPMessage& m = *arp;
+    this->arp_cache_.learn( m.sender_ip_address, m.sender_ethernet_address, this->time + this->arq_cache_timeout_ );
+    auto waiting = this->waiting_.find( m.sender_ip_address );
+    if ( waiting != this->waiting_.end() ) {
+      // release every datagram that was waiting for this address
+      for ( ; !waiting->second.empty(); waiting->second.pop() ) {
+        this->ready_.push( visit(
+          [&]( const auto& datagram ) { return this->ipv4_frame( datagram, m.sender_ethernet_address ); },
+          waiting->second.front() ) );
+      }
+      this->waiting_.erase( waiting );
     }
-    this->arp_cache_[m.sender_ip_address] = ArpResponse( true, this->time, m.sender_ethernet_address, false );
-    // = ArpResponse { .work = true, .time = this->time, .addr = m.sender_ethernet_address, .sended = false };
     if ( this->ip_address_.ipv4_numeric() != m.target_ip_address || frame.header.dst != ETHERNET_BROADCAST ) {
       return {};
     }
@@ -72,14 +116,21 @@ optional<InternetDatagram> NetworkInterface::recv_frame( const EthernetFrame& fr
     EthernetFrame send_frame {
       .header { .dst = frame.header.src, .src = this->ethernet_address_, .type = EthernetHeader::TYPE_ARP },
       .payload = serialize( res ) };
-    this->buffer_.push_back( make_pair( std::move( send_frame ), std::nullopt ) );
+    this->ready_.push( std::move( send_frame ) );
     return {};
   } else if ( frame.header.type == EthernetHeader::TYPE_IPv4 ) {
-    InternetDatagram idata;
-    if ( !parse( idata, frame.payload ) ) {
+    // the datagram stays as it arrived (gathered into one buffer only if it came in pieces)
+    Buffer datagram;
+    if ( frame.payload.size() == 1 ) {
+      datagram = frame.payload.front();
+    } else {
+      Parser parser { frame.payload };
+      parser.all_remaining( datagram );
+    }
+    if ( !ConstIPv4View::valid( datagram ) ) {
       return {};
     }
-    return idata;
+    return datagram;
   } else {
     return {};
   }
@@ -94,42 +145,48 @@ void NetworkInterface::tick( const size_t ms_since_last_tick )
 
 void NetworkInterface::gc()
 {
-  for ( auto& x : this->arp_cache_ ) {
-    if ( x.second.work && this->time - x.second.time >= this->arq_cache_timeout_ ) {
-      x.second = {};
+  // Ask again for any address whose request went unanswered but still has frames waiting
+  // (frames only wait for an address with a request pending, so no other address needs looking at)
+  for ( const uint32_t ip_address : this->arp_cache_.expire( this->time ) ) {
+    if ( this->waiting_.contains( ip_address ) ) {
+      this->send_arp_request( ip_address );
     }
   }
 }
 
+void NetworkInterface::send_arp_request( const uint32_t ip_address )
+{
+  ARPMessage req { .sender_ethernet_address = this->ethernet_address_,
+                   .sender_ip_address = this->ip_address_.ipv4_numeric(),
+                   .target_ethernet_address = {},
+                   .target_ip_address = ip_address };
+  req.opcode = ARPMessage::OPCODE_REQUEST;
+  this->arp_cache_.request_sent( ip_address, this->time + this->arq_req_timeout_ );
+  this->ready_.push( EthernetFrame {
+    .header { .dst = ETHERNET_BROADCAST, .src = this->ethernet_address_, .type = EthernetHeader::TYPE_ARP },
+    .payload = serialize( req ) } );
+}
+
+EthernetFrame NetworkInterface::ipv4_frame( const InternetDatagram& dgram, const EthernetAddress& dst ) const
+{
+  // Only the IPv4 header is serialized; the payload buffers are shared all the way to the write
+  return { .header { .dst = dst, .src = this->ethernet_address_, .type = EthernetHeader::TYPE_IPv4 },
+           .payload = serialize( dgram ) };
+}
+
+EthernetFrame NetworkInterface::ipv4_frame( const Buffer& datagram, const EthernetAddress& dst ) const
+{
+  // The datagram goes out as it is: nothing is serialized
+  return { .header { .dst = dst, .src = this->ethernet_address_, .type = EthernetHeader::TYPE_IPv4 },
+           .payload = { datagram } };
+}
+
 optional<EthernetFrame> NetworkInterface::maybe_send()
 {
-  for ( auto iter = this->buffer_.begin(); iter != this->buffer_.end(); iter++ ) {
-    if ( iter->first.header.type == EthernetHeader::TYPE_ARP ) {
-      EthernetFrame m = std::move( iter->first );
-      this->buffer_.erase( iter );
-      return m;
-    }
-    if ( this->arp_cache_[iter->second->ipv4_numeric()].work ) {
-      EthernetFrame m = std::move( iter->first );
-      m.header.dst = this->arp_cache_[iter->second->ipv4_numeric()].addr;
-      this->buffer_.erase( iter );
-      return m;
-    } else if ( this->arp_cache_[iter->second->ipv4_numeric()].sended
-                && this->time - this->arp_cache_[iter->second->ipv4_numeric()].time < this->arq_req_timeout_ ) {
-      continue;
-    } else {
-      ARPMessage req { .sender_ethernet_address = this->ethernet_address_,
-                       .sender_ip_address = this->ip_address_.ipv4_numeric(),
-                       .target_ethernet_address = {},
-                       .target_ip_address = iter->second->ipv4_numeric() };
-      req.opcode = ARPMessage::OPCODE_REQUEST;
-      this->arp_cache_[iter->second->ipv4_numeric()] = ArpResponse( false, this->time, ETHERNET_BROADCAST, true );
-      // { .work = false, .time = this->time, .addr = ETHERNET_BROADCAST, .sended = true };
-
-      return EthernetFrame {
-        .header { .dst = ETHERNET_BROADCAST, .src = this->ethernet_address_, .type = EthernetHeader::TYPE_ARP },
-        .payload = serialize( req ) };
-    }
+  if ( this->ready_.empty() ) {
+    return {};
   }
-  return {};
+  EthernetFrame frame = std::move( this->ready_.front() );
+  this->ready_.pop();
+  return frame;
 }
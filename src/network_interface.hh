@@ -1,17 +1,18 @@
 #pragma once
 
 #include "address.hh"
+#include "arp_table.hh"
 #include "ethernet_frame.hh"
 #include "ethernet_header.hh"
 #include "ipv4_datagram.hh"
 
 #include <cstdint>
 #include <iostream>
-#include <list>
 #include <optional>
 #include <queue>
 #include <unordered_map>
 #include <utility>
+#include <variant>
 
 // A "network interface" that connects IP (the internet layer, or network layer)
 // with Ethernet (the network access layer, or link layer).
@@ -45,23 +46,28 @@ private:
   const uint64_t arq_req_timeout_ = 5 * 1000;    // 5s
   const uint64_t arq_cache_timeout_ = 30 * 1000; // 30s
   uint64_t time;
-  struct ArpResponse
-  {
-    bool work = false;
-    uint64_t time = 0;
-    EthernetAddress addr = ETHERNET_BROADCAST;
-    bool sended = false;
-    ArpResponse( bool _work, uint64_t _time, const EthernetAddress& _addr, bool _sended )
-      : work( _work ), time( _time ), addr( _addr ), sended( _sended )
-    {}
-    ArpResponse() {}
-  };
-  // Mapping from IP address to Ethernet address
-  std::unordered_map<uint32_t, ArpResponse> arp_cache_;
-  std::list<std::pair<EthernetFrame, std::optional<Address>>> buffer_;
+  // Mapping from IP address to Ethernet address (and the addresses being looked up)
+  ArpTable arp_cache_;
+  // Frames ready to be sent, in order
+  std::queue<EthernetFrame> ready_;
+  // Datagrams waiting for the Ethernet address of their next hop, by next hop (kept as they were given:
+  // unserialized, so that a datagram that is dropped, or that never gets an answer, costs no serialization,
+  // or as raw bytes)
+  std::unordered_map<uint32_t, std::queue<std::variant<InternetDatagram, Buffer>>> waiting_;
+  size_t waiting_drops_;
   void gc();
+  void send_arp_request( uint32_t ip_address );
+  // Encapsulate `dgram` in a frame to `dst` (the frame shares the datagram's payload buffers)
+  EthernetFrame ipv4_frame( const InternetDatagram& dgram, const EthernetAddress& dst ) const;
+  EthernetFrame ipv4_frame( const Buffer& datagram, const EthernetAddress& dst ) const;
+  // Send a datagram (in either form) to `next_hop`, or park it until its Ethernet address is known
+  template<class Datagram>
+  void send_or_wait( const Datagram& datagram, const Address& next_hop );
 
 public:
+  // Most datagrams kept waiting for any one next hop's Ethernet address (further ones are dropped)
+  static constexpr size_t MAX_WAITING_FRAMES = 64;
+
   // Construct a network interface with given Ethernet (network-access-layer) and IP (internet-layer)
   // addresses
   NetworkInterface( const EthernetAddress& ethernet_address, const Address& ip_address );
@@ -76,12 +82,22 @@ public:
   // but please consider the frame sent as soon as it is generated.)
   void send_datagram( const InternetDatagram& dgram, const Address& next_hop );
 
+  // Sends an IPv4 datagram that is already serialized (e.g. one being forwarded), as it is.
+  void send_datagram( const Buffer& datagram, const Address& next_hop );
+
   // Receives an Ethernet frame and responds appropriately.
   // If type is IPv4, returns the datagram.
   // If type is ARP request, learn a mapping from the "sender" fields, and send an ARP reply.
   // If type is ARP reply, learn a mapping from the "sender" fields.
   std::optional<InternetDatagram> recv_frame( const EthernetFrame& frame );
 
+  // Receives an Ethernet frame like recv_frame(), but returns an IPv4 datagram undecoded: its bytes, in
+  // one Buffer, once checked to be a datagram that an IPv4View can be laid over.
+  std::optional<Buffer> recv_frame_raw( const EthernetFrame& frame );
+
   // Called periodically when time elapses
   void tick( size_t ms_since_last_tick );
+
+  // Number of datagrams dropped because too many were already waiting for the same next hop
+  size_t waiting_drops() const { return waiting_drops_; }
 };
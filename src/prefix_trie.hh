@@ -0,0 +1,209 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// A path-compressed binary (Patricia) trie that maps IPv4 prefixes to values and finds the
+// longest prefix that matches an address.
+//
+// Every node stands for a prefix. A node only exists if it holds a value or if two subtrees
+// branch at it, so a lookup visits at most 33 nodes and usually far fewer. Nodes are a few words
+// each and live in one vector, referring to each other (and to their values, kept apart) by index;
+// the slots of erased nodes and values are reused.
+template<class T>
+class PrefixTrie
+{
+  static constexpr uint32_t NONE = 0;            // the root is never anyone's child
+  static constexpr uint32_t NO_VALUE = UINT32_MAX; // the node only separates subtrees
+
+  struct Node
+  {
+    uint32_t prefix {};
+    uint8_t length {};
+    uint32_t value { NO_VALUE }; // index in values_
+    std::array<uint32_t, 2> child { NONE, NONE };
+
+    bool has_value() const { return value != NO_VALUE; }
+  };
+
+  std::vector<Node> nodes_ { Node {} }; // nodes_[0] is the root (the zero-length prefix)
+  std::vector<uint32_t> free_nodes_ {};
+  std::vector<std::optional<T>> values_ {};
+  std::vector<uint32_t> free_values_ {};
+  size_t size_ {};
+
+  static uint32_t mask( const uint8_t length ) { return length == 0 ? 0 : 0xffffffff << ( 32 - length ); }
+
+  // The bit of `address` just after the first `length` bits
+  static size_t bit_after( const uint32_t address, const uint8_t length )
+  {
+    return ( address >> ( 31 - length ) ) & 1;
+  }
+
+  uint32_t new_node( const uint32_t prefix, const uint8_t length )
+  {
+    const Node node { .prefix = prefix, .length = length };
+    if ( free_nodes_.empty() ) {
+      nodes_.push_back( node );
+      return nodes_.size() - 1;
+    }
+    const uint32_t index = free_nodes_.back();
+    free_nodes_.pop_back();
+    nodes_[index] = node;
+    return index;
+  }
+
+  // Remove node `index` (child `side` of `parent`) if it holds no value and no longer separates two subtrees
+  void prune( const uint32_t parent, const size_t side, const uint32_t index )
+  {
+    Node& node = nodes_[index];
+    if ( index == 0 or node.has_value() or ( node.child[0] != NONE and node.child[1] != NONE ) ) {
+      return;
+    }
+    nodes_[parent].child[side] = node.child[0] != NONE ? node.child[0] : node.child[1];
+    node = Node {};
+    free_nodes_.push_back( index );
+  }
+
+public:
+  // Number of prefixes in the trie
+  size_t size() const { return size_; }
+
+  // Map `prefix`/`length` to `value`, unless it already has a value (which is kept: the first value
+  // for a prefix wins); returns false in that case. Bits of `prefix` beyond `length` are ignored.
+  bool insert( uint32_t prefix, const uint8_t length, T value )
+  {
+    prefix &= mask( length );
+    uint32_t current = 0;
+    while ( nodes_[current].length < length ) {
+      const size_t side = bit_after( prefix, nodes_[current].length );
+      const uint32_t next = nodes_[current].child[side];
+      if ( next == NONE ) {
+        const uint32_t leaf = new_node( prefix, length );
+        nodes_[current].child[side] = leaf;
+        current = leaf;
+        break;
+      }
+
+      const Node& child = nodes_[next];
+      const uint8_t common = std::min<uint8_t>(
+        std::min( length, child.length ), static_cast<uint8_t>( std::countl_zero( prefix ^ child.prefix ) ) );
+      if ( common == child.length ) {
+        current = next; // the child's prefix is a prefix of ours: descend
+        continue;
+      }
+
+      // the child's prefix and ours part ways after `common` bits: insert a node there
+      const uint32_t split = new_node( prefix & mask( common ), common );
+      nodes_[split].child[bit_after( nodes_[next].prefix, common )] = next;
+      nodes_[current].child[side] = split;
+      current = split;
+    }
+
+    if ( nodes_[current].has_value() ) {
+      return false;
+    }
+    if ( free_values_.empty() ) {
+      values_.emplace_back( std::move( value ) );
+      nodes_[current].value = values_.size() - 1;
+    } else {
+      nodes_[current].value = free_values_.back();
+      free_values_.pop_back();
+      values_[nodes_[current].value] = std::move( value );
+    }
+    ++size_;
+    return true;
+  }
+
+  // Remove `prefix`/`length`; returns false if it was not in the trie
+  bool erase( uint32_t prefix, const uint8_t length )
+  {
+    prefix &= mask( length );
+    uint32_t grandparent = 0;
+    size_t parent_side = 0;
+    uint32_t parent = 0;
+    size_t side = 0;
+    uint32_t current = 0; // (the root has no parent, but is never pruned)
+    while ( nodes_[current].length < length ) {
+      grandparent = parent;
+      parent_side = side;
+      parent = current;
+      side = bit_after( prefix, nodes_[current].length );
+      current = nodes_[current].child[side];
+      if ( current == NONE or nodes_[current].length > length
+           or ( prefix & mask( nodes_[current].length ) ) != nodes_[current].prefix ) {
+        return false;
+      }
+    }
+    if ( nodes_[current].prefix != prefix or not nodes_[current].has_value() ) {
+      return false;
+    }
+
+    values_[nodes_[current].value].reset();
+    free_values_.push_back( nodes_[current].value );
+    nodes_[current].value = NO_VALUE;
+    --size_;
+    if ( current != 0 ) {
+      const bool leaf = nodes_[current].child[0] == NONE and nodes_[current].child[1] == NONE;
+      prune( parent, side, current );
+      if ( leaf and parent != 0 ) {
+        prune( grandparent, parent_side, parent ); // the parent may have been holding two subtrees apart
+      }
+    }
+    return true;
+  }
+
+  // The value of exactly `prefix`/`length`, if it is in the trie
+  const T* find( uint32_t prefix, const uint8_t length ) const
+  {
+    prefix &= mask( length );
+    uint32_t current = 0;
+    while ( nodes_[current].length < length ) {
+      current = nodes_[current].child[bit_after( prefix, nodes_[current].length )];
+      if ( current == NONE or nodes_[current].length > length
+           or ( prefix & mask( nodes_[current].length ) ) != nodes_[current].prefix ) {
+        return nullptr;
+      }
+    }
+    const Node& node = nodes_[current];
+    return node.prefix == prefix and node.has_value() ? &values_[node.value].value() : nullptr;
+  }
+
+  // The value of the longest prefix that matches `address`, if any
+  const T* lookup( const uint32_t address ) const
+  {
+    const Node* node = nodes_.data();
+    uint32_t best = node->value;
+    while ( node->length < 32 ) {
+      const uint32_t next = node->child[bit_after( address, node->length )];
+      if ( next == NONE ) {
+        break;
+      }
+      node = &nodes_[next];
+      if ( ( address & mask( node->length ) ) != node->prefix ) {
+        break;
+      }
+      if ( node->has_value() ) {
+        best = node->value;
+      }
+    }
+    return best == NO_VALUE ? nullptr : &values_[best].value();
+  }
+
+  // Call `visit( prefix, length, value )` for every prefix in the trie
+  template<class Visitor>
+  void for_each( Visitor&& visit ) const
+  {
+    for ( const Node& node : nodes_ ) {
+      if ( node.has_value() ) {
+        visit( node.prefix, node.length, values_[node.value].value() );
+      }
+    }
+  }
+};
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// A small set-associative cache of route lookups, keyed by destination address.
+//
+// Each address maps to one set of WAYS entries; within a set, entries are replaced in turn.
+// Every entry records the generation it was filled in, and invalidate() simply starts a new
+// generation, so that clearing the cache after the route table changes costs O(1).
+template<class T>
+class RouteCache
+{
+public:
+  static constexpr size_t WAYS = 4;
+
+private:
+  struct Entry
+  {
+    uint32_t address {};
+    uint32_t generation {}; // 0: never filled
+    T value {};
+  };
+
+  struct Set
+  {
+    std::array<Entry, WAYS> entries {};
+    size_t next_victim {};
+  };
+
+  std::vector<Set> sets_;
+  uint32_t generation_ { 1 };
+  size_t hits_ {};
+  size_t misses_ {};
+
+  Set& set_for( const uint32_t address )
+  {
+    // Fibonacci hashing spreads neighbouring addresses over the sets
+    const uint32_t hash = address * 2654435769U;
+    return sets_[hash >> ( 32 - std::countr_zero( sets_.size() ) )];
+  }
+
+public:
+  // A cache of `num_sets` (a power of two) sets
+  explicit RouteCache( const size_t num_sets = 1024 ) : sets_( num_sets )
+  {
+    if ( num_sets < 2 or ( num_sets & ( num_sets - 1 ) ) ) {
+      throw std::invalid_argument( "RouteCache: number of sets must be a power of two" );
+    }
+  }
+
+  // The cached value for `address`, if there is one from the current generation
+  std::optional<T> lookup( const uint32_t address )
+  {
+    for ( const Entry& entry : set_for( address ).entries ) {
+      if ( entry.address == address and entry.generation == generation_ ) {
+        ++hits_;
+        return entry.value;
+      }
+    }
+    ++misses_;
+    return {};
+  }
+
+  // Remember the value for `address` (which lookup() has just missed)
+  void insert( const uint32_t address, T value )
+  {
+    Set& set = set_for( address );
+    set.entries[set.next_victim] = { address, generation_, std::move( value ) };
+    set.next_victim = ( set.next_victim + 1 ) % WAYS;
+  }
+
+  // Forget every entry
+  void invalidate()
+  {
+    if ( ++generation_ == 0 ) {
+      // after 2^32 generations, old entries could look current again: really clear them
+      sets_.assign( sets_.size(), Set {} );
+      generation_ = 1;
+    }
+  }
+
+  size_t capacity() const { return sets_.size() * WAYS; }
+  size_t hits() const { return hits_; }
+  size_t misses() const { return misses_; }
+};
@@ -1,10 +1,46 @@
 #include "router.hh"
 #include "address.hh"
+#include "packet_view.hh"
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <limits>
+#include <map>
+#include <stdexcept>
+#include <string_view>
+#include <tuple>
+#include <utility>
 
 using namespace std;
+using namespace std::chrono;
+
+// A hash of the datagram's flow: its addresses, protocol and (for TCP and UDP) ports.
+// Fragments other than the first carry no ports, so fragmented datagrams are hashed without them.
+static uint32_t flow_hash( const ConstIPv4View& datagram )
+{
+  uint64_t ports_and_proto = datagram.proto();
+  if ( datagram.has_ports() ) {
+    const uint32_t ports = static_cast<uint32_t>( datagram.src_port() ) << 16 | datagram.dst_port();
+    ports_and_proto |= static_cast<uint64_t>( ports ) << 8;
+  }
+
+  // mix with the finalizer of MurmurHash3, so that every input bit affects every output bit
+  uint64_t hash = ( ( static_cast<uint64_t>( datagram.src() ) << 32 ) | datagram.dst() )
+                  ^ ( ports_and_proto * 0x9e3779b97f4a7c15 );
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccd;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53;
+  hash ^= hash >> 33;
+  return static_cast<uint32_t>( hash );
+}
+
+// The next hop for the datagram, among the rule's next hops
+static const RouterRule::NextHop& next_hop_for( const RouterRule& rule, const ConstIPv4View& datagram )
+{
+  return rule.next_hops().size() == 1 ? rule.next_hops().front() : rule.next_hop_for( flow_hash( datagram ) );
+}
 
 // route_prefix: The "up-to-32-bit" IPv4 address prefix to match the datagram's destination address against
 // prefix_length: For this route to be applicable, how many high-order (most-significant) bits of
@@ -21,55 +57,500 @@ void Router::add_route( const uint32_t route_prefix,
        << static_cast<int>( prefix_length ) << " => " << ( next_hop.has_value() ? next_hop->ip() : "(direct)" )
        << " on interface " << interface_num << "\n";
 
-  this->rules_.emplace_back( route_prefix, prefix_length, next_hop, interface_num );
+  this->insert_rule( RouterRule { route_prefix, prefix_length, next_hop, interface_num } );
+}
+
+void Router::add_route( const uint32_t route_prefix,
+                        const uint8_t prefix_length,
+                        vector<RouterRule::NextHop> next_hops )
+{
+  cerr << "DEBUG: adding route " << Address::from_ipv4_numeric( route_prefix ).ip() << "/"
+       << static_cast<int>( prefix_length ) << " =>";
+  for ( const auto& hop : next_hops ) {
+    cerr << " " << ( hop.address.has_value() ? hop.address->ip() : "(direct)" ) << " on interface "
+         << hop.interface_num << " (weight " << hop.weight << ")";
+  }
+  cerr << "\n";
+
+  this->insert_rule( RouterRule { route_prefix, prefix_length, move( next_hops ) } );
+}
+
+void Router::insert_rule( RouterRule&& rule )
+{
+  const uint32_t route_prefix = rule.route_prefix();
+  const uint8_t prefix_length = rule.prefix_length();
+  if ( this->rules_.find( route_prefix, prefix_length ) != nullptr ) {
+    cerr << "DEBUG: route for " << Address::from_ipv4_numeric( route_prefix ).ip() << "/"
+         << static_cast<int>( prefix_length ) << " already present; keeping the first one\n";
+    return;
+  }
+
+  NextHopSet hops = next_hop_set( rule );
+  if ( not this->next_hop_set_uses_.contains( hops )
+       and this->next_hop_set_uses_.size() >= Dir24_8Table::MAX_NEXT_HOP ) {
+    throw runtime_error( "Router: too many distinct sets of next hops" );
+  }
+  const bool long_prefix = prefix_length > 24;
+  if ( long_prefix and not this->long_prefix_uses_.contains( route_prefix >> 8 )
+       and this->long_prefix_uses_.size() >= Dir24_8Table::MAX_OVERFLOW_BLOCKS ) {
+    throw runtime_error( "Router: too many /24s with prefixes longer than /24" );
+  }
+
+  {
+    const lock_guard lock { this->rules_mutex_ };
+    this->rules_.insert( route_prefix, prefix_length, move( rule ) );
+    this->routes_version_++;
+  }
+  this->next_hop_set_uses_[move( hops )]++;
+  if ( long_prefix ) {
+    this->long_prefix_uses_[route_prefix >> 8]++;
+  }
+  this->route_cache_.invalidate();
+  this->rules_changed_.notify_one();
+}
+
+bool Router::remove_route( const uint32_t route_prefix, const uint8_t prefix_length )
+{
+  cerr << "DEBUG: removing route " << Address::from_ipv4_numeric( route_prefix ).ip() << "/"
+       << static_cast<int>( prefix_length ) << "\n";
+
+  const RouterRule* rule = this->rules_.find( route_prefix, prefix_length );
+  if ( rule == nullptr ) {
+    return false;
+  }
+  const auto hops = this->next_hop_set_uses_.find( next_hop_set( *rule ) );
+  if ( --hops->second == 0 ) {
+    this->next_hop_set_uses_.erase( hops );
+  }
+  if ( prefix_length > 24 ) {
+    const auto block = this->long_prefix_uses_.find( route_prefix >> 8 );
+    if ( --block->second == 0 ) {
+      this->long_prefix_uses_.erase( block );
+    }
+  }
+
+  {
+    const lock_guard lock { this->rules_mutex_ };
+    this->rules_.erase( route_prefix, prefix_length );
+    this->routes_version_++;
+  }
+  this->route_cache_.invalidate();
+  this->rules_changed_.notify_one();
+  return true;
+}
+
+Router::NextHopSet Router::next_hop_set( const RouterRule& rule )
+{
+  NextHopSet hops;
+  for ( const auto& hop : rule.next_hops() ) {
+    hops.emplace_back( hop.interface_num,
+                       hop.address.has_value() ? optional { hop.address->ipv4_numeric() } : nullopt,
+                       hop.weight );
+  }
+  return hops;
+}
+
+void Router::use_flat_table( const bool enable )
+{
+  if ( not enable and not this->workers_.empty() ) {
+    throw runtime_error( "Router: the worker threads need the flat table" );
+  }
+  this->use_flat_table_ = enable;
+  if ( enable and not this->builder_.joinable() ) {
+    this->stop_builder_ = false;
+    this->builder_ = thread { [this] { this->builder_loop(); } };
+  } else if ( not enable ) {
+    this->stop_builder();
+    this->flat_table_.store( nullptr );
+  }
+}
+
+void Router::wait_for_flat_table()
+{
+  unique_lock lock { this->rules_mutex_ };
+  if ( not this->builder_.joinable() ) {
+    throw runtime_error( "Router: the flat table is not in use" );
+  }
+  this->table_built_.wait( lock, [&] {
+    const auto flat_table = this->flat_table_.load();
+    return flat_table and flat_table->version == this->routes_version_;
+  } );
+}
+
+void Router::builder_loop()
+{
+  unique_lock lock { this->rules_mutex_ };
+  optional<uint64_t> built;
+  while ( true ) {
+    this->rules_changed_.wait( lock, [&] { return this->stop_builder_ or built != this->routes_version_; } );
+    if ( this->stop_builder_ ) {
+      return;
+    }
+
+    // Copy the rules out, so that routes can change again while the table is built
+    const uint64_t version = this->routes_version_;
+    vector<RouterRule> rules;
+    rules.reserve( this->rules_.size() );
+    this->rules_.for_each( [&]( uint32_t, uint8_t, const RouterRule& rule ) { rules.push_back( rule ); } );
+    lock.unlock();
+
+    this->flat_table_.store( build_flat_table( rules, version ) );
+
+    lock.lock();
+    built = version;
+    this->table_built_.notify_all();
+  }
+}
+
+void Router::stop_builder()
+{
+  if ( not this->builder_.joinable() ) {
+    return;
+  }
+  {
+    const lock_guard lock { this->rules_mutex_ };
+    this->stop_builder_ = true;
+  }
+  this->rules_changed_.notify_one();
+  this->builder_.join();
+}
+
+shared_ptr<const Router::FlatTable> Router::build_flat_table( const vector<RouterRule>& rules,
+                                                              const uint64_t version )
+{
+  // (insert_rule() saw to it that there are no more sets of next hops, nor /24s with longer prefixes, than fit)
+  map<NextHopSet, uint16_t> numbers;
+  vector<RouterRule> next_hops;
+  vector<Dir24_8Table::Route> routes;
+  routes.reserve( rules.size() );
+  for ( const auto& rule : rules ) {
+    auto [it, inserted]
+      = numbers.try_emplace( next_hop_set( rule ), static_cast<uint16_t>( next_hops.size() + 1 ) );
+    if ( inserted ) {
+      next_hops.push_back( rule );
+    }
+    routes.push_back( Dir24_8Table::Route { rule.route_prefix(), rule.prefix_length(), it->second } );
+  }
+
+  return make_shared<const FlatTable>( FlatTable { Dir24_8Table { move( routes ) }, move( next_hops ), version } );
+}
+
+const RouterRule* Router::lookup_cached( const uint32_t address )
+{
+  if ( const auto cached = this->route_cache_.lookup( address ) ) {
+    return cached.value();
+  }
+  const RouterRule* rule = this->rules_.lookup( address );
+  this->route_cache_.insert( address, rule );
+  return rule;
+}
+
+const RouterRule* Router::FlatTable::lookup( const uint32_t address ) const
+{
+  const uint16_t next_hop = this->table.lookup( address );
+  return next_hop == Dir24_8Table::NO_ROUTE ? nullptr : &this->next_hops[next_hop - 1];
+}
+
+void Router::set_max_batch( const size_t max_batch )
+{
+  this->max_batch_.store( std::max<size_t>( max_batch, 1 ), memory_order_relaxed );
 }
 
 void Router::route()
 {
-  // For each interface, use the maybe_receive() method to consume every incoming datagram and
-  // send it on one of interfaces to the correct next hop. The router
-  // chooses the outbound interface and next-hop as specified by the
-  // route with the longest prefix_length that matches the datagram's
-  // destination address.
-  for ( size_t i = 0; i < this->interfaces_.size(); i++ ) {
-    auto& interface = this->interface( i );
+  // Consume every incoming datagram on every interface and send it on one of
+  // interfaces to the correct next hop. The router chooses the outbound
+  // interface and next-hop as specified by the route with the longest
+  // prefix_length that matches the datagram's destination address.
+  shared_ptr<const FlatTable> flat_table;
+  if ( this->use_flat_table_ ) {
+    // (until the builder catches up with the latest route changes, look routes up in the trie instead)
+    flat_table = this->flat_table_.load();
+    if ( flat_table and flat_table->version != this->routes_version_ ) {
+      flat_table.reset();
+    }
+  }
 
-    auto maybe_datagram = interface.maybe_receive();
-    if ( !maybe_datagram.has_value() ) {
-      continue;
+  const size_t num_interfaces = this->interfaces_.size();
+  if ( num_interfaces == 0 ) {
+    return;
+  }
+  const size_t max_batch = this->max_batch_.load( memory_order_relaxed );
+
+  // Round-robin over the interfaces, a batch from each, until they are all empty.
+  // (Forwarding only queues frames to send, so no new datagrams arrive meanwhile.)
+  bool any_received = true;
+  while ( any_received ) {
+    any_received = false;
+    for ( size_t n = 0; n < num_interfaces; n++ ) {
+      auto& interface = this->interface( ( this->first_interface_ + n ) % num_interfaces );
+      if ( interface.receive_batch( this->batch_, max_batch ) > 0 ) {
+        any_received = true;
+        this->forward_batch( flat_table.get() );
+      }
     }
-    auto datagram = maybe_datagram.value();
-    if ( datagram.header.ttl <= 1 ) {
+  }
+  this->first_interface_ = ( this->first_interface_ + 1 ) % num_interfaces;
+}
+
+void Router::forward_batch( const FlatTable* flat_table )
+{
+  // First decide where each datagram goes...
+  this->batch_hops_.clear();
+  for ( auto& datagram : this->batch_ ) {
+    const RouterRule::NextHop* hop = nullptr;
+    if ( ConstIPv4View { datagram.data(), datagram.size() }.ttl() > 1 ) {
+      IPv4View view { datagram.mutable_data(), datagram.size() };
+      view.decrement_ttl();
+      auto destination_address_numeric = view.dst();
+      const RouterRule* best_rule = flat_table ? flat_table->lookup( destination_address_numeric )
+                                               : this->lookup_cached( destination_address_numeric );
+      if ( best_rule == nullptr ) {
+        cerr << "DEBUG: no route for " << Address::from_ipv4_numeric( destination_address_numeric ) << "\n";
+      } else {
+        hop = &next_hop_for( *best_rule, view );
+      }
+    }
+    this->batch_hops_.push_back( hop );
+  }
+
+  // ...then send them all (a null next hop means the datagram is dropped)
+  for ( size_t i = 0; i < this->batch_.size(); i++ ) {
+    const RouterRule::NextHop* hop = this->batch_hops_[i];
+    if ( hop == nullptr ) {
       continue;
     }
-    datagram.header.ttl--;
-    datagram.header.compute_checksum();
-
-    auto destination_address_numeric = datagram.header.dst;
-    auto best_rule = this->rules_.end();
-    for ( auto rule = this->rules_.begin(); rule != this->rules_.end(); rule++ ) {
-      if ( rule->is_match( destination_address_numeric ) ) {
-        if ( best_rule == this->rules_.end() ) {
-          best_rule = rule;
-        } else if ( rule->prefix_length() > best_rule->prefix_length() ) {
-          best_rule = rule;
+    const Buffer& datagram = this->batch_[i];
+    if ( hop->address.has_value() ) {
+      this->interface( hop->interface_num ).send_datagram( datagram, hop->address.value() );
+    } else {
+      const ConstIPv4View view { datagram.data(), datagram.size() };
+      this->interface( hop->interface_num ).send_datagram( datagram, Address::from_ipv4_numeric( view.dst() ) );
+    }
+  }
+  this->batch_.clear();
+}
+
+Router::~Router()
+{
+  this->stop_workers();
+  this->stop_builder();
+}
+
+void Router::start_workers( const size_t num_workers )
+{
+  if ( not this->workers_.empty() ) {
+    throw runtime_error( "Router: workers already running" );
+  }
+  if ( num_workers == 0 or this->interfaces_.empty() ) {
+    throw runtime_error( "Router: need at least one worker and one interface" );
+  }
+
+  // The workers carry on with whatever table there is while a newer one is built; but they need one to start
+  this->use_flat_table( true );
+  if ( not this->flat_table_.load() ) {
+    this->wait_for_flat_table();
+  }
+
+  this->num_workers_ = min( num_workers, this->interfaces_.size() );
+  this->rx_rings_.clear();
+  this->tx_rings_.clear();
+  for ( size_t i = 0; i < this->interfaces_.size(); i++ ) {
+    this->rx_rings_.push_back( make_unique<SPSCRing<EthernetFrame>>( RING_SIZE ) );
+    this->tx_rings_.push_back( make_unique<SPSCRing<EthernetFrame>>( RING_SIZE ) );
+  }
+  this->handoff_rings_.clear();
+  for ( size_t i = 0; i < this->num_workers_ * this->num_workers_; i++ ) {
+    this->handoff_rings_.push_back( make_unique<SPSCRing<Handoff>>( RING_SIZE ) );
+  }
+  this->wakeups_.clear();
+  for ( size_t w = 0; w < this->num_workers_; w++ ) {
+    this->wakeups_.push_back( make_unique<Wakeup>() );
+  }
+
+  this->stop_workers_ = false;
+  for ( size_t w = 0; w < this->num_workers_; w++ ) {
+    this->workers_.emplace_back( [this, w] { this->worker_loop( w ); } );
+  }
+}
+
+void Router::stop_workers()
+{
+  this->stop_workers_ = true;
+  for ( auto& wakeup : this->wakeups_ ) {
+    const lock_guard lock { wakeup->mutex }; // (so that a worker cannot miss this between checking and waiting)
+    wakeup->condition.notify_one();
+  }
+  for ( auto& worker : this->workers_ ) {
+    worker.join();
+  }
+  this->workers_.clear();
+}
+
+bool Router::deliver_frame( const size_t interface_num, EthernetFrame&& frame )
+{
+  if ( not this->rx_rings_.at( interface_num )->push( std::move( frame ) ) ) {
+    return false;
+  }
+  this->wake_worker( interface_num % this->num_workers_ );
+  return true;
+}
+
+optional<EthernetFrame> Router::collect_frame( const size_t interface_num )
+{
+  return this->tx_rings_.at( interface_num )->pop();
+}
+
+bool Router::work_waiting( const size_t worker )
+{
+  for ( size_t i = worker; i < this->interfaces_.size(); i += this->num_workers_ ) {
+    if ( not this->rx_rings_[i]->empty() ) {
+      return true;
+    }
+  }
+  for ( size_t from = 0; from < this->num_workers_; from++ ) {
+    if ( from != worker and not this->handoff_rings_[from * this->num_workers_ + worker]->empty() ) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void Router::sleep_until_work( const size_t worker )
+{
+  Wakeup& wakeup = *this->wakeups_[worker];
+
+  // Announce the sleep before the last look at the rings: a producer that pushes after that look sees the flag
+  // (the two fences order each side's store before its load, so at least one side sees the other's store)
+  wakeup.sleeping.store( true, memory_order_relaxed );
+  atomic_thread_fence( memory_order_seq_cst );
+  if ( not this->work_waiting( worker ) ) {
+    unique_lock lock { wakeup.mutex };
+    wakeup.condition.wait_for( lock, IDLE_WAIT, [&] {
+      return not wakeup.sleeping.load( memory_order_relaxed ) or this->stop_workers_.load();
+    } );
+  }
+  wakeup.sleeping.store( false, memory_order_relaxed );
+}
+
+void Router::wake_worker( const size_t worker )
+{
+  Wakeup& wakeup = *this->wakeups_[worker];
+  atomic_thread_fence( memory_order_seq_cst ); // pairs with the one in sleep_until_work()
+  if ( wakeup.sleeping.load( memory_order_relaxed ) ) {
+    {
+      const lock_guard lock { wakeup.mutex };
+      wakeup.sleeping.store( false, memory_order_relaxed );
+    }
+    wakeup.condition.notify_one();
+  }
+}
+
+void Router::worker_loop( const size_t worker )
+{
+  const size_t num_workers = this->num_workers_;
+  vector<Buffer> batch;
+  auto last_tick = steady_clock::now();
+  size_t idle_rounds = 0;
+  vector<bool> handed_off( num_workers ); // the workers given datagrams this round, to be woken
+
+  while ( not this->stop_workers_.load( memory_order_relaxed ) ) {
+    bool busy = false;
+    const size_t max_batch = this->max_batch_.load( memory_order_relaxed );
+
+    // Take the current table; one that the builder replaces stays alive until this reference is dropped
+    const shared_ptr<const FlatTable> flat_table = this->flat_table_.load();
+
+    // Receive and route the datagrams on our own interfaces
+    for ( size_t i = worker; i < this->interfaces_.size(); i += num_workers ) {
+      auto& interface = this->interfaces_[i];
+      for ( size_t n = 0; n < max_batch; n++ ) {
+        auto frame = this->rx_rings_[i]->pop();
+        if ( not frame.has_value() ) {
+          break;
+        }
+        interface.recv_frame( frame.value() );
+      }
+
+      interface.receive_batch( batch, max_batch );
+      for ( auto& datagram : batch ) {
+        if ( ConstIPv4View { datagram.data(), datagram.size() }.ttl() <= 1 ) {
+          continue;
+        }
+        IPv4View view { datagram.mutable_data(), datagram.size() };
+        view.decrement_ttl();
+        const RouterRule* rule = flat_table->lookup( view.dst() );
+        if ( rule == nullptr ) {
+          continue;
+        }
+        const RouterRule::NextHop& hop = next_hop_for( *rule, view );
+        if ( hop.interface_num >= this->interfaces_.size() ) {
+          continue;
+        }
+        const uint32_t next_hop = hop.address.has_value() ? hop.address->ipv4_numeric() : view.dst();
+        const size_t owner = hop.interface_num % num_workers;
+        if ( owner == worker ) {
+          this->interfaces_[hop.interface_num].send_datagram( datagram, Address::from_ipv4_numeric( next_hop ) );
+        } else if ( this->handoff_rings_[worker * num_workers + owner]->push(
+                      Handoff { std::move( datagram ), next_hop, hop.interface_num } ) ) {
+          handed_off[owner] = true;
+        } else {
+          this->handoff_drops_++;
         }
       }
+      busy = busy or not batch.empty();
+      batch.clear();
     }
-    if ( best_rule == this->rules_.end() ) {
-      cerr << "DEBUG: no route for " << Address::from_ipv4_numeric( destination_address_numeric ) << "\n";
-      continue;
+    for ( size_t to = 0; to < num_workers; to++ ) {
+      if ( handed_off[to] ) {
+        this->wake_worker( to );
+        handed_off[to] = false;
+      }
+    }
+
+    // Send the datagrams that other workers routed to our interfaces
+    for ( size_t from = 0; from < num_workers; from++ ) {
+      if ( from == worker ) {
+        continue;
+      }
+      auto& ring = *this->handoff_rings_[from * num_workers + worker];
+      for ( size_t n = 0; n < max_batch; n++ ) {
+        auto handoff = ring.pop();
+        if ( not handoff.has_value() ) {
+          break;
+        }
+        this->interfaces_[handoff->interface_num].send_datagram( handoff->datagram,
+                                                                 Address::from_ipv4_numeric( handoff->next_hop ) );
+        busy = true;
+      }
+    }
+
+    // Keep our interfaces' timers running, and pass on the frames they have to send
+    const auto now = steady_clock::now();
+    const auto elapsed_ms = duration_cast<milliseconds>( now - last_tick ).count();
+    last_tick += milliseconds( elapsed_ms );
+    for ( size_t i = worker; i < this->interfaces_.size(); i += num_workers ) {
+      auto& interface = this->interfaces_[i];
+      if ( elapsed_ms > 0 ) {
+        interface.tick( elapsed_ms );
+      }
+      while ( not this->tx_rings_[i]->full() ) {
+        auto frame = interface.maybe_send();
+        if ( not frame.has_value() ) {
+          break;
+        }
+        this->tx_rings_[i]->push( std::move( frame.value() ) );
+        busy = true;
+      }
     }
-    auto& best_rule_ref = *best_rule;
-    if ( best_rule_ref.next_hop().has_value() ) {
-      // cerr << "DEBUG: forwarding " << destination_address.ip() << " to " << best_rule_next_hop->ip() << "\n";
-      // interface.send_datagram( *best_rule_next_hop, datagram.payload() );
-      this->interface( best_rule_ref.interface_num() ).send_datagram( datagram, best_rule_ref.next_hop().value() );
 
+    // Spin a little while idle (work tends to come in bursts), then sleep until there is more
+    if ( busy ) {
+      idle_rounds = 0;
+    } else if ( ++idle_rounds < IDLE_ROUNDS ) {
+      this_thread::yield();
     } else {
-      // datagram.header.
-      this->interface( best_rule_ref.interface_num() )
-        .send_datagram( datagram, Address::from_ipv4_numeric( destination_address_numeric ) );
+      this->sleep_until_work( worker );
     }
   }
 }
@@ -1,18 +1,35 @@
 #pragma once
 
+#include "dir_24_8.hh"
 #include "network_interface.hh"
+#include "prefix_trie.hh"
+#include "route_cache.hh"
+#include "spsc_ring.hh"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <queue>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <vector>
 
 // A wrapper for NetworkInterface that makes the host-side
 // interface asynchronous: instead of returning received datagrams
 // immediately (from the `recv_frame` method), it stores them for
 // later retrieval. Otherwise, behaves identically to the underlying
 // implementation of NetworkInterface.
+//
+// The received datagrams are kept as they arrived (undecoded), so that a
+// router can forward them without parsing or serializing them.
 class AsyncNetworkInterface : public NetworkInterface
 {
-  std::queue<InternetDatagram> datagrams_in_ {};
+  std::queue<Buffer> datagrams_in_ {};
 
 public:
   using NetworkInterface::NetworkInterface;
@@ -29,7 +46,7 @@ public:
   // \param[in] frame the incoming Ethernet frame
   void recv_frame( const EthernetFrame& frame )
   {
-    auto optional_dgram = NetworkInterface::recv_frame( frame );
+    auto optional_dgram = NetworkInterface::recv_frame_raw( frame );
     if ( optional_dgram.has_value() ) {
       datagrams_in_.push( std::move( optional_dgram.value() ) );
     }
@@ -38,39 +55,104 @@ public:
   // Access queue of Internet datagrams that have been received
   std::optional<InternetDatagram> maybe_receive()
   {
-    if ( datagrams_in_.empty() ) {
-      return {};
+    while ( not datagrams_in_.empty() ) {
+      InternetDatagram datagram;
+      const bool parsed = parse( datagram, { datagrams_in_.front() } );
+      datagrams_in_.pop();
+      if ( parsed ) {
+        return datagram;
+      }
     }
+    return {};
+  }
 
-    InternetDatagram datagram = std::move( datagrams_in_.front() );
-    datagrams_in_.pop();
-    return datagram;
+  // Move up to `max` received datagrams (their bytes, which an IPv4View can be laid over) onto the end
+  // of `batch`; returns how many were moved
+  size_t receive_batch( std::vector<Buffer>& batch, size_t max )
+  {
+    size_t moved = 0;
+    for ( ; moved < max and not datagrams_in_.empty(); ++moved ) {
+      batch.push_back( std::move( datagrams_in_.front() ) );
+      datagrams_in_.pop();
+    }
+    return moved;
   }
+
+  // Number of received datagrams waiting to be retrieved
+  size_t datagrams_waiting() const { return datagrams_in_.size(); }
 };
 
 class RouterRule
 {
+public:
+  // One of the paths that a route can take: out of interface `interface_num`, to `address` (or
+  // straight to the destination if empty). Paths share out flows in proportion to their weights.
+  struct NextHop
+  {
+    std::optional<Address> address {};
+    size_t interface_num {};
+    uint32_t weight { 1 };
+  };
+
+  // The most that the weights of a route's next hops may add up to (so that picking one cannot overflow)
+  static constexpr uint64_t MAX_TOTAL_WEIGHT = uint64_t { 1 } << 32;
+
 private:
   uint32_t route_prefix_;
   uint8_t prefix_length_;
-  std::optional<Address> next_hop_;
-  size_t interface_num_;
+  std::vector<NextHop> next_hops_;
+  uint64_t total_weight_ {};
 
 public:
   RouterRule( const uint32_t route_prefix,
               const uint8_t prefix_length,
               const std::optional<Address> next_hop,
               const size_t interface_num )
-    : route_prefix_( route_prefix )
-    , prefix_length_( prefix_length )
-    , next_hop_( next_hop )
-    , interface_num_( interface_num )
+    : RouterRule( route_prefix, prefix_length, { NextHop { next_hop, interface_num } } )
   {}
 
+  // A route with several next hops (equal-cost multipath), whose weights add up to at most 2^32
+  RouterRule( const uint32_t route_prefix, const uint8_t prefix_length, std::vector<NextHop> next_hops )
+    : route_prefix_( route_prefix ), prefix_length_( prefix_length ), next_hops_( std::move( next_hops ) )
+  {
+    for ( const auto& hop : next_hops_ ) {
+      if ( hop.weight == 0 ) {
+        throw std::invalid_argument( "RouterRule: next hop with zero weight" );
+      }
+      total_weight_ += hop.weight;
+    }
+    if ( next_hops_.empty() ) {
+      throw std::invalid_argument( "RouterRule: no next hops" );
+    }
+    if ( total_weight_ > MAX_TOTAL_WEIGHT ) {
+      throw std::invalid_argument( "RouterRule: next hop weights add up to more than 2^32" );
+    }
+  }
+
   inline uint32_t route_prefix() const { return route_prefix_; }
   inline uint8_t prefix_length() const { return prefix_length_; }
-  inline std::optional<Address> next_hop() const { return next_hop_; }
-  inline size_t interface_num() const { return interface_num_; }
+
+  // The first (for a single-path route, the only) next hop
+  inline std::optional<Address> next_hop() const { return next_hops_.front().address; }
+  inline size_t interface_num() const { return next_hops_.front().interface_num; }
+
+  inline const std::vector<NextHop>& next_hops() const { return next_hops_; }
+
+  // The next hop for a flow whose hash is `flow_hash`: each weight unit takes an equal share of hash values
+  inline const NextHop& next_hop_for( const uint32_t flow_hash ) const
+  {
+    if ( next_hops_.size() == 1 ) {
+      return next_hops_.front();
+    }
+    uint64_t point = ( flow_hash * total_weight_ ) >> 32; // (the product fits: total_weight_ <= 2^32)
+    for ( const auto& hop : next_hops_ ) {
+      if ( point < hop.weight ) {
+        return hop;
+      }
+      point -= hop.weight;
+    }
+    return next_hops_.back();
+  }
 
   inline bool is_match( const uint32_t ip ) const
   {
@@ -90,9 +172,128 @@ class Router
 {
   // The router's collection of network interfaces
   std::vector<AsyncNetworkInterface> interfaces_ {};
-  std::vector<RouterRule> rules_ {};
+  PrefixTrie<RouterRule> rules_ {};
+
+  // Recent results of looking up destinations in rules_ (a null rule means there was no route)
+  RouteCache<const RouterRule*> route_cache_ {};
+
+  // A DIR-24-8 table built from rules_ (as they stood at `version`), and the next hops that it refers to
+  struct FlatTable
+  {
+    Dir24_8Table table;
+    std::vector<RouterRule> next_hops; // next hop n is next_hops[n - 1]
+    uint64_t version;
+
+    const RouterRule* lookup( uint32_t address ) const;
+  };
+
+  bool use_flat_table_ {};
+  std::atomic<std::shared_ptr<const FlatTable>> flat_table_ {};
+
+  // The flat table is rebuilt on a thread of its own. Changing a route only bumps routes_version_ and wakes
+  // the builder, which copies the rules and builds one table for however many changes came in meanwhile;
+  // forwarding carries on with the previous table until the new one is swapped in.
+  std::mutex rules_mutex_ {}; // held while rules_ changes, and while the builder copies it
+  std::condition_variable rules_changed_ {};
+  std::condition_variable table_built_ {};
+  uint64_t routes_version_ {}; // changed (under rules_mutex_) only by the thread that changes the routes
+  bool stop_builder_ {};
+  std::thread builder_ {};
+
+  // The interfaces, next hops and weights of a route; routes with the same set share a next-hop number
+  using NextHopSet = std::vector<std::tuple<size_t, std::optional<uint32_t>, uint32_t>>;
+  static NextHopSet next_hop_set( const RouterRule& rule );
+
+  // How many routes use each distinct set of next hops, and how many prefixes longer than /24 are in each
+  // /24 that has any: the flat table has room for only so many of either, so a route that would need one
+  // too many is turned away when it is added (rather than the rebuild failing later)
+  std::map<NextHopSet, size_t> next_hop_set_uses_ {};
+  std::map<uint32_t, size_t> long_prefix_uses_ {};
+
+  // Build a flat table from (a copy of) the rules
+  static std::shared_ptr<const FlatTable> build_flat_table( const std::vector<RouterRule>& rules,
+                                                             uint64_t version );
+
+  // The loop of the builder thread, and how it is stopped
+  void builder_loop();
+  void stop_builder();
+
+  // Put `rule` in the table, unless there already is a route for the same prefix
+  void insert_rule( RouterRule&& rule );
+
+  // Look up a destination in rules_, through the route cache
+  const RouterRule* lookup_cached( uint32_t address );
+
+  // Largest number of datagrams taken from one interface before moving on to the next
+  // (atomic, because set_max_batch() may change it while the workers read it)
+  std::atomic<size_t> max_batch_ { 32 };
+
+  // The interface that the next pass of route() starts with (rotated for fairness)
+  size_t first_interface_ {};
+
+  // Datagrams being forwarded (undecoded: read and modified in place through IPv4Views), and the next
+  // hop chosen for each (kept to avoid reallocating every pass)
+  std::vector<Buffer> batch_ {};
+  std::vector<const RouterRule::NextHop*> batch_hops_ {};
+
+  // Check, look up and forward the datagrams in batch_, then empty it
+  void forward_batch( const FlatTable* flat_table );
+
+  // A datagram routed by one worker thread, for the worker that owns its outbound interface to send
+  struct Handoff
+  {
+    Buffer datagram {};
+    uint32_t next_hop {};
+    size_t interface_num {};
+  };
+
+  static constexpr size_t RING_SIZE = 1024;
+
+  // A worker that finds nothing to do this many rounds in a row stops yielding and sleeps, for at most
+  // IDLE_WAIT (so that its interfaces' timers keep running), until another thread gives it work
+  static constexpr size_t IDLE_ROUNDS = 64;
+  static constexpr std::chrono::milliseconds IDLE_WAIT { 1 };
+
+  // Where a sleeping worker waits to be woken
+  struct Wakeup
+  {
+    std::mutex mutex {};
+    std::condition_variable condition {};
+    std::atomic<bool> sleeping {};
+  };
+
+  size_t num_workers_ {};
+  std::vector<std::thread> workers_ {};
+  std::atomic<bool> stop_workers_ {};
+  std::atomic<size_t> handoff_drops_ {};
+
+  // Frames to and from each interface while the workers run
+  std::vector<std::unique_ptr<SPSCRing<EthernetFrame>>> rx_rings_ {};
+  std::vector<std::unique_ptr<SPSCRing<EthernetFrame>>> tx_rings_ {};
+
+  // Datagrams passed from worker `from` to worker `to` are in handoff_rings_[from * num_workers_ + to]
+  std::vector<std::unique_ptr<SPSCRing<Handoff>>> handoff_rings_ {};
+
+  std::vector<std::unique_ptr<Wakeup>> wakeups_ {};
+
+  // The forwarding loop of worker thread `worker`
+  void worker_loop( size_t worker );
+
+  // Is there a frame or a handoff waiting for worker `worker`? (only worker `worker` may ask)
+  bool work_waiting( size_t worker );
+
+  // Put worker `worker` to sleep until it is woken, unless it has work waiting (called by the worker itself)
+  void sleep_until_work( size_t worker );
+
+  // Wake worker `worker` if it is asleep (after giving it work)
+  void wake_worker( size_t worker );
 
 public:
+  Router() = default;
+  Router( const Router& other ) = delete;
+  Router& operator=( const Router& other ) = delete;
+  ~Router();
+
   // Add an interface to the router
   // interface: an already-constructed network interface
   // returns the index of the interface after it has been added to the router
@@ -105,17 +306,70 @@ public:
   // Access an interface by index
   AsyncNetworkInterface& interface( size_t N ) { return interfaces_.at( N ); }
 
-  // Add a route (a forwarding rule)
+  // Add a route (a forwarding rule). If there already is a route for the same prefix, it stays and
+  // this one is ignored: of two routes for one prefix, the first added wins (to replace a route,
+  // remove_route() it first). Throws if the route would need more distinct sets of next hops
+  // (Dir24_8Table::MAX_NEXT_HOP) or more /24s with longer prefixes in them
+  // (Dir24_8Table::MAX_OVERFLOW_BLOCKS) than the flat table has room for.
   void add_route( uint32_t route_prefix,
                   uint8_t prefix_length,
                   std::optional<Address> next_hop,
                   size_t interface_num );
 
-  // Route packets between the interfaces. For each interface, use the
-  // maybe_receive() method to consume every incoming datagram and
-  // send it on one of interfaces to the correct next hop. The router
-  // chooses the outbound interface and next-hop as specified by the
-  // route with the longest prefix_length that matches the datagram's
-  // destination address.
+  // Add a route with several next hops (equal-cost multipath). The router hashes each datagram's
+  // addresses, protocol and TCP or UDP ports to pick a next hop, so the datagrams of one flow all take
+  // the same path and stay in order, and flows are shared out in proportion to the weights.
+  void add_route( uint32_t route_prefix, uint8_t prefix_length, std::vector<RouterRule::NextHop> next_hops );
+
+  // Remove the route for exactly this prefix; returns false if there was none
+  bool remove_route( uint32_t route_prefix, uint8_t prefix_length );
+
+  // Look up routes in a DIR-24-8 table (one or two memory accesses) instead of the trie.
+  // A thread of the router's own rebuilds the table after the routes change (once for a burst of
+  // changes), and swaps it in atomically once complete, so a lookup never sees a half-built table.
+  // Meanwhile, route() looks routes up in the trie; the workers keep using the previous table.
+  void use_flat_table( bool enable );
+
+  // Wait until the flat table includes every route change made so far
+  void wait_for_flat_table();
+
+  // The cache of recent route lookups (unused with the flat table), with its hit and miss counts
+  const RouteCache<const RouterRule*>& route_cache() const { return route_cache_; }
+
+  // Take at most `max_batch` (at least 1) datagrams from one interface at a time in route()
+  // (or, while the workers run, in each of their rounds; this may be changed while they do)
+  void set_max_batch( size_t max_batch );
+
+  // Forward in parallel on `num_workers` threads (no more than there are interfaces), until
+  // stop_workers(). Worker w owns the interfaces whose index is w modulo num_workers: it alone
+  // receives, routes and sends on them, and passes datagrams bound for another worker's interface
+  // through a lock-free ring (dropping them if the ring is full). The workers share the flat
+  // table read-only, and take up each new one that is swapped in after the routes change. A
+  // worker with nothing to do sleeps until deliver_frame() or another worker gives it work.
+  //
+  // While the workers run, interface() and route() must not be used: exchange frames with
+  // deliver_frame() and collect_frame() instead, from one thread per interface. Routes may only be
+  // changed from one thread at a time.
+  void start_workers( size_t num_workers );
+  void stop_workers();
+
+  // Hand a frame that arrived on an interface to its worker; false if the worker has fallen behind
+  bool deliver_frame( size_t interface_num, EthernetFrame&& frame );
+
+  // A frame that a worker has sent on an interface, if any
+  std::optional<EthernetFrame> collect_frame( size_t interface_num );
+
+  // Number of datagrams dropped because another worker's ring was full
+  size_t handoff_drops() const { return handoff_drops_.load(); }
+
+  // Route packets between the interfaces. Every incoming datagram waiting on
+  // any interface is consumed and sent on one of interfaces to the correct
+  // next hop. The router chooses the outbound interface and next-hop as
+  // specified by the route with the longest prefix_length that matches the
+  // datagram's destination address.
+  //
+  // The interfaces take turns, each giving up to max_batch datagrams per
+  // turn, until every queue is empty; so a burst on one interface cannot
+  // hold up the others for longer than a batch.
   void route();
 };
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// A bounded lock-free queue between exactly one producer thread and one consumer thread.
+//
+// The producer only writes tail_ and the consumer only writes head_, each publishing with a
+// release store that the other side reads with an acquire load. Each side also keeps its own copy
+// of the other's index, and only rereads the shared one when the ring looks full (or empty), so
+// that the two cores do not pass the index cache lines back and forth on every element.
+template<class T>
+class SPSCRing
+{
+  static constexpr size_t CACHE_LINE = 64;
+
+  std::vector<T> slots_;
+  size_t mask_;
+
+  alignas( CACHE_LINE ) std::atomic<size_t> head_ { 0 }; // next slot to pop (written by the consumer)
+  size_t tail_seen_by_consumer_ { 0 };
+
+  alignas( CACHE_LINE ) std::atomic<size_t> tail_ { 0 }; // next slot to push (written by the producer)
+  size_t head_seen_by_producer_ { 0 };
+
+public:
+  // A ring with room for `capacity` (a power of two) elements
+  explicit SPSCRing( const size_t capacity ) : slots_( capacity ), mask_( capacity - 1 )
+  {
+    if ( capacity == 0 or ( capacity & mask_ ) ) {
+      throw std::invalid_argument( "SPSCRing: capacity must be a power of two" );
+    }
+  }
+
+  // Producer: is there no room for another element?
+  bool full()
+  {
+    const size_t tail = tail_.load( std::memory_order_relaxed );
+    if ( tail - head_seen_by_producer_ == slots_.size() ) {
+      head_seen_by_producer_ = head_.load( std::memory_order_acquire );
+    }
+    return tail - head_seen_by_producer_ == slots_.size();
+  }
+
+  // Producer: append `value`, unless the ring is full (in which case returns false)
+  bool push( T&& value )
+  {
+    if ( full() ) {
+      return false;
+    }
+    const size_t tail = tail_.load( std::memory_order_relaxed );
+    slots_[tail & mask_] = std::move( value );
+    tail_.store( tail + 1, std::memory_order_release );
+    return true;
+  }
+
+  // Consumer: remove the oldest element, if there is one
+  std::optional<T> pop()
+  {
+    const size_t head = head_.load( std::memory_order_relaxed );
+    if ( head == tail_seen_by_consumer_ ) {
+      tail_seen_by_consumer_ = tail_.load( std::memory_order_acquire );
+      if ( head == tail_seen_by_consumer_ ) {
+        return {};
+      }
+    }
+    std::optional<T> value { std::move( slots_[head & mask_] ) };
+    head_.store( head + 1, std::memory_order_release );
+    return value;
+  }
+
+  // Consumer: is there nothing to pop?
+  bool empty()
+  {
+    const size_t head = head_.load( std::memory_order_relaxed );
+    if ( head == tail_seen_by_consumer_ ) {
+      tail_seen_by_consumer_ = tail_.load( std::memory_order_acquire );
+    }
+    return head == tail_seen_by_consumer_;
+  }
+
+  size_t capacity() const { return slots_.size(); }
+};
@@ -24,13 +24,15 @@ TCPSender::TCPSender( uint64_t initial_RTO_ms, optional<Wrap32> fixed_isn )
   , needRetransmission_( false )
   , isClose_( false )
   , buffer_()
+  , buffer_begin_( 0 )
+  , buffer_end_( 0 )
   , isZeroWS_( false )
 {}
 
 uint64_t TCPSender::sequence_numbers_in_flight() const
 {
   // Your code here.
-  return min( this->buffer_.size() + isFinish_ - this->ack_record_.last_ack_received_ + 1,
+  return min( this->buffer_end_ + isFinish_ - this->ack_record_.last_ack_received_ + 1,
               max( this->ack_record_.last_ack_window_size_, (uint64_t)1 ) );
   // uint64_t seqNo = this->msg_.empty()
   //                    ? this->ack_record_.last_ack_received_
@@ -65,7 +67,7 @@ optional<TCPSenderMessage> TCPSender::maybe_send()
   if ( payload_idx > 0 )
     payload_idx--;
   uint64_t payload_size = min(
-    min( this->calc_remain_wsize(), this->buffer_.size() >= payload_idx ? this->buffer_.size() - payload_idx : 0 ),
+    min( this->calc_remain_wsize(), this->buffer_end_ >= payload_idx ? this->buffer_end_ - payload_idx : 0 ),
     TCPConfig::MAX_PAYLOAD_SIZE );
 
   if ( payload_size == 0 && seqNo != 0 && !( this->isFinish_ && this->calc_remain_wsize() != 0 ) )
@@ -73,10 +75,9 @@ optional<TCPSenderMessage> TCPSender::maybe_send()
 
   TCPSenderMessage message { .seqno = Wrap32::wrap( seqNo, this->isn_ ),
                              .SYN = seqNo == 0,
-                             .payload
-                             = { payload_size != 0 ? this->buffer_.substr( payload_idx, payload_size ) : "" },
+                             .payload = this->payload_at( payload_idx, payload_size ),
                              // .FIN = payload_idx + payload_size >= buffer_.size(),
-                             .FIN = this->isFinish_ && payload_idx + payload_size >= buffer_.size()
+                             .FIN = this->isFinish_ && payload_idx + payload_size >= buffer_end_
                                     && payload_size < this->calc_remain_wsize() };
   this->msg_.push( message );
   if ( message.FIN ) {
@@ -94,7 +95,10 @@ void TCPSender::push( Reader& outbound_stream )
   // (void)outbound_stream;
   string buf_;
   read( outbound_stream, outbound_stream.bytes_buffered(), buf_ );
-  this->buffer_ += buf_;
+  if ( !buf_.empty() ) {
+    this->buffer_end_ += buf_.size();
+    this->buffer_.emplace_back( std::move( buf_ ) );
+  }
   this->isFinish_ = outbound_stream.is_finished();
 }
 
@@ -168,9 +172,42 @@ void TCPSender::GC_buffer()
     }
     msg_.pop();
   }
+
+  // Drop the pushed data that has all been acknowledged (seqno 0 is the SYN, not a byte of the stream)
+  const uint64_t last_ack = this->ack_record_.last_ack_received_;
+  const uint64_t acked = min( last_ack > 0 ? last_ack - 1 : 0, this->buffer_end_ );
+  while ( !this->buffer_.empty() && this->buffer_begin_ + this->buffer_.front().size() <= acked ) {
+    this->buffer_begin_ += this->buffer_.front().size();
+    this->buffer_.pop_front();
+  }
   return;
 }
 
+// The `size` bytes of the stream starting at `index`: a slice of the Buffer they were pushed in, if they all were
+// pushed together (otherwise they have to be copied together)
+Buffer TCPSender::payload_at( uint64_t index, uint64_t size ) const
+{
+  if ( size == 0 ) {
+    return {};
+  }
+  uint64_t chunk_begin = this->buffer_begin_;
+  auto chunk = this->buffer_.begin();
+  while ( chunk_begin + chunk->size() <= index ) {
+    chunk_begin += chunk->size();
+    ++chunk;
+  }
+  if ( index - chunk_begin + size <= chunk->size() ) {
+    return chunk->substr( index - chunk_begin, size );
+  }
+
+  string payload;
+  payload.reserve( size );
+  for ( uint64_t offset = index - chunk_begin; payload.size() < size; ++chunk, offset = 0 ) {
+    payload.append( string_view { *chunk }.substr( offset, size - payload.size() ) );
+  }
+  return payload;
+}
+
 uint64_t TCPSender::calc_remain_wsize() const
 {
   if ( this->msg_.empty() || this->ack_record_.last_ack_window_size_ == 0 ) {
@@ -1,9 +1,12 @@
 #pragma once
 
+#include "buffer.hh"
 #include "byte_stream.hh"
 #include "tcp_receiver_message.hh"
 #include "tcp_sender_message.hh"
 
+#include <deque>
+
 class TCPTimer
 {
 private:
@@ -41,7 +44,10 @@ class TCPSender
   bool isFinish_;
   bool needRetransmission_;
   bool isClose_; // 拒绝发送新包
-  std::string buffer_;
+  std::deque<Buffer> buffer_; // pushed bytes not yet acknowledged, one Buffer per push
+  uint64_t buffer_begin_;     // stream index of the first byte in buffer_
+  uint64_t buffer_end_;       // stream index just past the last byte pushed
+  Buffer payload_at( uint64_t index, uint64_t size ) const;
   TCPSenderMessage construct_message( uint64_t seqno, uint64_t size, bool is_syn, bool is_fin ) const;
   uint64_t calc_remain_wsize() const;
   void GC_buffer();
@@ -0,0 +1,140 @@
+#include "arp_table.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+static constexpr uint64_t cache_timeout = 30'000;
+
+// The ARP cache that NetworkInterface used to keep: an unordered_map whose expired entries were reset in a
+// walk over the whole map on every tick, but never removed
+class MapArpCache
+{
+  struct ArpResponse
+  {
+    bool work = false;
+    uint64_t time = 0;
+    EthernetAddress addr = ETHERNET_BROADCAST;
+    bool sended = false;
+  };
+
+  unordered_map<uint32_t, ArpResponse> cache_ {};
+
+public:
+  void learn( const uint32_t ip, const EthernetAddress& addr, const uint64_t now )
+  {
+    cache_[ip] = { true, now, addr, false };
+  }
+
+  const EthernetAddress* find( const uint32_t ip )
+  {
+    if ( cache_.count( ip ) && cache_[ip].work ) {
+      return &cache_[ip].addr;
+    }
+    return nullptr;
+  }
+
+  void expire( const uint64_t now )
+  {
+    for ( auto& x : cache_ ) {
+      if ( x.second.work && now - x.second.time >= cache_timeout ) {
+        x.second = {};
+      }
+    }
+  }
+};
+
+// `num_ticks` milliseconds of a busy interface with `num_neighbors` neighbours, ticking every millisecond:
+// each tick sends to 200 neighbours and hears from 20. Returns the seconds taken.
+template<class Cache>
+static double speed_test( const size_t num_neighbors, const size_t num_ticks )
+{
+  default_random_engine rd { 38 };
+  vector<uint32_t> neighbors( num_neighbors );
+  for ( auto& neighbor : neighbors ) {
+    neighbor = uniform_int_distribution<uint32_t> {}( rd );
+  }
+  uniform_int_distribution<size_t> pick { 0, num_neighbors - 1 };
+
+  Cache cache;
+  for ( size_t i = 0; i < num_neighbors; ++i ) {
+    cache.learn( neighbors[i], { 2, 0, 0, 0, 0, static_cast<uint8_t>( i ) }, 0 );
+  }
+
+  size_t found = 0;
+  const auto start_time = steady_clock::now();
+  for ( uint64_t now = 1; now <= num_ticks; ++now ) {
+    for ( size_t n = 0; n < 200; ++n ) {
+      found += cache.find( neighbors[pick( rd )] ) != nullptr;
+    }
+    for ( size_t n = 0; n < 20; ++n ) {
+      cache.learn( neighbors[pick( rd )], { 2, 0, 0, 0, 0, static_cast<uint8_t>( n ) }, now );
+    }
+    cache.expire( now );
+  }
+  const auto stop_time = steady_clock::now();
+
+  if ( found == 0 ) {
+    throw runtime_error( "no neighbours found" );
+  }
+  return duration_cast<duration<double>>( stop_time - start_time ).count();
+}
+
+// ArpTable, adapted to the same interface
+class TableArpCache
+{
+  ArpTable table_ {};
+
+public:
+  void learn( const uint32_t ip, const EthernetAddress& addr, const uint64_t now )
+  {
+    table_.learn( ip, addr, now + cache_timeout );
+  }
+
+  const EthernetAddress* find( const uint32_t ip ) const
+  {
+    const ArpTable::Entry* entry = table_.find( ip );
+    return entry != nullptr and entry->resolved ? &entry->ethernet_address : nullptr;
+  }
+
+  void expire( const uint64_t now ) { table_.expire( now ); }
+};
+
+void program_body()
+{
+  constexpr size_t num_neighbors = 100'000;
+  constexpr size_t num_ticks = 200;
+
+  const double map_seconds = speed_test<MapArpCache>( num_neighbors, num_ticks );
+  const double table_seconds = speed_test<TableArpCache>( num_neighbors, num_ticks );
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  cout << "ARP cache with " << num_neighbors << " neighbours, per 1 ms tick (200 lookups, 20 updates, expiry): "
+       << "unordered_map with full scan " << fixed << setprecision( 1 ) << map_seconds * 1e6 / num_ticks
+       << " us; open-addressing table with expiry queues " << table_seconds * 1e6 / num_ticks << " us.\n";
+
+  debug_output << "                ARP cache: " << fixed << setprecision( 1 ) << map_seconds * 1e6 / num_ticks
+               << " -> " << table_seconds * 1e6 / num_ticks << " us per tick\n";
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,95 @@
+#include "arp_table.hh"
+#include "test_helpers.hh"
+
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static EthernetAddress ethernet_address( const uint32_t n )
+{
+  return { 0x02,
+           0,
+           static_cast<uint8_t>( n >> 24 ),
+           static_cast<uint8_t>( n >> 16 ),
+           static_cast<uint8_t>( n >> 8 ),
+           static_cast<uint8_t>( n ) };
+}
+
+// Random learning and erasing, with addresses from a small range so that probe sequences collide and wrap
+static void compare_with_map()
+{
+  default_random_engine rd { 38 };
+  uniform_int_distribution<uint32_t> address_dist { 0, 3000 };
+  uniform_int_distribution<int> op_dist { 0, 2 };
+  ArpTable table;
+  map<uint32_t, EthernetAddress> reference;
+
+  for ( size_t n = 0; n < 100'000; ++n ) {
+    const uint32_t address = address_dist( rd ) * 0x01000193;
+    if ( op_dist( rd ) == 0 ) {
+      expect( table.erase( address ) == ( reference.erase( address ) == 1 ), "erase disagrees" );
+    } else {
+      table.learn( address, ethernet_address( n ), UINT64_MAX );
+      reference[address] = ethernet_address( n );
+    }
+  }
+
+  expect( table.size() == reference.size(), "wrong size" );
+  for ( uint32_t a = 0; a <= 3000; ++a ) {
+    const uint32_t address = a * 0x01000193;
+    const ArpTable::Entry* entry = table.find( address );
+    const auto it = reference.find( address );
+    expect( ( entry != nullptr ) == ( it != reference.end() ), "find disagrees about presence" );
+    expect( entry == nullptr or ( entry->resolved and entry->ethernet_address == it->second ),
+            "find returned the wrong Ethernet address" );
+  }
+}
+
+static void expiry()
+{
+  ArpTable table;
+  table.learn( 1, ethernet_address( 1 ), 30'000 );
+  table.request_sent( 2, 5'000 );
+  table.learn( 3, ethernet_address( 3 ), 31'000 );
+
+  expect( table.expire( 4'999 ).empty() and table.size() == 3, "expired too early" );
+  expect( table.expire( 5'000 ) == vector<uint32_t> { 2 } and table.find( 2 ) == nullptr and table.size() == 2,
+          "pending request did not expire (or was not reported)" );
+
+  // a reply turns a pending entry into a resolved one, with the longer lifetime
+  table.request_sent( 4, 10'000 );
+  table.learn( 4, ethernet_address( 4 ), 35'000 );
+  expect( table.expire( 10'000 ).empty() and table.find( 4 ) != nullptr and table.find( 4 )->resolved,
+          "resolved entry expired (or was reported) with its request" );
+
+  // renewing an entry moves its deadline
+  table.learn( 1, ethernet_address( 11 ), 40'000 );
+  table.expire( 30'000 );
+  expect( table.find( 1 ) != nullptr and table.find( 1 )->ethernet_address == ethernet_address( 11 ),
+          "renewed entry expired at its old deadline" );
+
+  expect( table.expire( 35'000 ).empty() and table.size() == 1 and table.find( 3 ) == nullptr
+            and table.find( 4 ) == nullptr,
+          "missed expiries (or reported resolved ones)" );
+  table.expire( 40'000 );
+  expect( table.size() == 0, "table not empty after every deadline" );
+}
+
+int main()
+{
+  try {
+    compare_with_map();
+    expiry();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
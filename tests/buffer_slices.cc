@@ -0,0 +1,69 @@
+#include "buffer.hh"
+#include "parser.hh"
+#include "test_helpers.hh"
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+static void slices()
+{
+  const Buffer whole { string { "0123456789" } };
+  const Buffer middle = whole.substr( 2, 5 );
+  expect( string_view { middle } == "23456", "substr has the wrong bytes" );
+  expect( middle.data() == whole.data() + 2, "substr copied the bytes" );
+  expect( string_view { whole.substr( 7 ) } == "789", "substr to the end has the wrong bytes" );
+  expect( whole.substr( 4, 100 ).size() == 6, "substr went past the end" );
+  expect( whole.substr( 10 ).empty(), "substr at the end is not empty" );
+
+  bool threw = false;
+  try {
+    (void)whole.substr( 11 );
+  } catch ( const out_of_range& ) {
+    threw = true;
+  }
+  expect( threw, "substr past the end did not throw" );
+
+  Buffer trimmed = whole;
+  trimmed.remove_prefix( 3 );
+  trimmed.remove_suffix( 2 );
+  expect( string_view { trimmed } == "34567" and trimmed.data() == whole.data() + 3, "trimming copied or missed" );
+  expect( string_view { whole } == "0123456789", "trimming a copy changed the original" );
+  trimmed.remove_prefix( 100 );
+  expect( trimmed.empty(), "removing more than the whole buffer left bytes behind" );
+
+  expect( Buffer {}.data() == nullptr and Buffer { string {} }.empty(), "empty buffer owns storage" );
+  expect( static_cast<string>( middle ) == "23456", "conversion to string has the wrong bytes" );
+}
+
+// Parsing a header off the front of a buffer leaves the rest in place
+static void parsed_payload()
+{
+  const Buffer frame { string { "\x12\x34payload" } };
+  Parser parser { { frame } };
+  uint16_t header {};
+  parser.integer( header );
+  vector<Buffer> payload;
+  parser.all_remaining( payload );
+
+  expect( not parser.has_error() and header == 0x1234, "header misparsed" );
+  expect( payload.size() == 1 and string_view { payload.front() } == "payload", "payload misparsed" );
+  expect( payload.front().data() == frame.data() + 2, "payload was copied out of the frame" );
+}
+
+int main()
+{
+  try {
+    slices();
+    parsed_payload();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,180 @@
+#include "checksum.hh"
+#include "ipv4_header.hh"
+#include "tcp_segment.hh"
+
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// The straightforward algorithm: add up big-endian 16-bit words, one byte at a time
+static uint16_t reference_checksum( const string& data, uint32_t initial )
+{
+  uint64_t sum = initial;
+  for ( size_t i = 0; i < data.size(); ++i ) {
+    sum += i % 2 ? static_cast<uint8_t>( data[i] ) : static_cast<uint8_t>( data[i] ) << 8;
+  }
+  while ( sum > 0xffff ) {
+    sum = ( sum >> 16 ) + static_cast<uint16_t>( sum );
+  }
+  return ~sum;
+}
+
+// The reference checksum of an object's serialized bytes
+template<class T>
+static uint16_t serialized_checksum( const T& obj, uint32_t initial )
+{
+  string bytes;
+  for ( const auto& buf : serialize( obj ) ) {
+    bytes.append( buf );
+  }
+  return reference_checksum( bytes, initial );
+}
+
+int main()
+{
+  try {
+    default_random_engine rd { 1071 };
+    uniform_int_distribution<char> byte_dist;
+
+    // Chains of buffers with random (often odd) lengths, sliced at random (often misaligned) offsets,
+    // covering the scalar tails and the vector blocks as well as sums large enough to carry
+    for ( size_t trial = 0; trial < 400; ++trial ) {
+      const size_t max_piece = trial % 4 == 0 ? 5 : trial % 4 == 1 ? 70 : trial % 4 == 2 ? 1500 : 70000;
+      uniform_int_distribution<size_t> piece_dist { 0, max_piece };
+      const uint32_t initial = uniform_int_distribution<uint32_t> { 0, 0x3ffff }( rd );
+
+      string all;
+      vector<Buffer> chain;
+      const size_t pieces = uniform_int_distribution<size_t> { 0, 6 }( rd );
+      for ( size_t i = 0; i < pieces; ++i ) {
+        string storage( piece_dist( rd ) + 7, 0 );
+        for ( auto& ch : storage ) {
+          ch = trial % 5 == 0 ? '\xff' : byte_dist( rd );
+        }
+        const size_t offset = uniform_int_distribution<size_t> { 0, 7 }( rd );
+        string piece = storage.substr( offset, storage.size() - 7 );
+        all += piece;
+        chain.emplace_back( move( piece ) );
+      }
+
+      InternetChecksum check { initial };
+      check.add( chain );
+      const uint16_t expected = reference_checksum( all, initial );
+      if ( check.value() != expected ) {
+        throw runtime_error( "checksum mismatch (" + string { InternetChecksum::implementation() }
+                             + "): expected " + to_string( expected ) + ", got " + to_string( check.value() ) );
+      }
+    }
+
+    // Enough 0xff bytes to overflow a vector accumulator that is never flushed
+    const string ones( 3 << 20, '\xff' );
+    InternetChecksum large;
+    large.add( ones );
+    if ( large.value() != reference_checksum( ones, 0 ) ) {
+      throw runtime_error( "checksum mismatch on a large buffer" );
+    }
+
+    // A valid packet, including its checksum, sums to zero
+    string packet( 1001, 0 );
+    for ( auto& ch : packet ) {
+      ch = byte_dist( rd );
+    }
+    InternetChecksum check;
+    check.add( packet );
+    const uint16_t cksum = check.value();
+    packet.push_back( 0 ); // the checksum goes in an aligned position
+    packet.push_back( static_cast<char>( cksum >> 8 ) );
+    packet.push_back( static_cast<char>( cksum & 0xff ) );
+    InternetChecksum verify;
+    verify.add( packet );
+    if ( verify.value() != 0 ) {
+      throw runtime_error( "checksum of a checksummed packet is not zero" );
+    }
+
+    // Incremental updates agree with recomputing the checksum from scratch
+    uniform_int_distribution<uint32_t> word_dist;
+    for ( size_t trial = 0; trial < 1000; ++trial ) {
+      IPv4Header header;
+      header.len = word_dist( rd );
+      header.id = word_dist( rd );
+      header.ttl = trial % 255 + 1;
+      header.proto = word_dist( rd );
+      header.src = word_dist( rd );
+      header.dst = word_dist( rd );
+      header.compute_checksum();
+
+      IPv4Header expected = header;
+      --expected.ttl;
+      expected.compute_checksum();
+      header.decrement_ttl();
+      if ( header.ttl != expected.ttl or header.cksum != expected.cksum ) {
+        throw runtime_error( "incremental TTL decrement gave checksum " + to_string( header.cksum ) + ", expected "
+                             + to_string( expected.cksum ) );
+      }
+
+      const uint32_t new_dst = trial % 7 ? word_dist( rd ) : 0xffffffff - header.src;
+      header.cksum = InternetChecksum::adjust32( header.cksum, header.dst, new_dst );
+      header.dst = new_dst;
+      expected.dst = new_dst;
+      expected.compute_checksum();
+      if ( header.cksum != expected.cksum ) {
+        throw runtime_error( "incremental address rewrite gave checksum " + to_string( header.cksum )
+                             + ", expected " + to_string( expected.cksum ) );
+      }
+    }
+
+    // Checksums computed from header fields agree with checksumming the serialized bytes
+    for ( size_t trial = 0; trial < 1000; ++trial ) {
+      IPv4Header header;
+      header.tos = word_dist( rd );
+      header.len = word_dist( rd );
+      header.id = word_dist( rd );
+      header.df = trial % 2;
+      header.mf = trial % 3 == 0;
+      header.offset = word_dist( rd );
+      header.ttl = word_dist( rd );
+      header.proto = word_dist( rd );
+      header.src = word_dist( rd );
+      header.dst = word_dist( rd );
+      header.compute_checksum();
+      IPv4Header zeroed = header;
+      zeroed.cksum = 0;
+      if ( header.cksum != serialized_checksum( zeroed, 0 ) ) {
+        throw runtime_error( "IPv4 header checksum from fields differs from the serialized header's" );
+      }
+
+      TCPSegment seg;
+      seg.udinfo.src_port = word_dist( rd );
+      seg.udinfo.dst_port = word_dist( rd );
+      seg.sender_message.seqno = Wrap32 { word_dist( rd ) };
+      if ( trial % 4 ) {
+        seg.receiver_message.ackno = Wrap32 { word_dist( rd ) };
+      }
+      seg.receiver_message.window_size = word_dist( rd );
+      seg.reset = trial % 5 == 0;
+      seg.sender_message.SYN = trial % 6 == 0;
+      seg.sender_message.FIN = trial % 7 == 0;
+      string payload( trial % 100, 0 );
+      for ( auto& ch : payload ) {
+        ch = byte_dist( rd );
+      }
+      seg.sender_message.payload = move( payload );
+      seg.compute_checksum( header.pseudo_checksum() );
+      TCPSegment unchecked = seg;
+      unchecked.udinfo.cksum = 0;
+      if ( seg.udinfo.cksum != serialized_checksum( unchecked, header.pseudo_checksum() ) ) {
+        throw runtime_error( "TCP checksum from fields differs from the serialized segment's" );
+      }
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
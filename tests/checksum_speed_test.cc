@@ -0,0 +1,114 @@
+#include "checksum.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+// The byte-at-a-time loop that InternetChecksum used to run, for comparison
+class BytewiseChecksum
+{
+  uint32_t sum_ {};
+  bool parity_ {};
+
+public:
+  void add( string_view data )
+  {
+    for ( const uint8_t i : data ) {
+      uint16_t val = i;
+      if ( not parity_ ) {
+        val <<= 8;
+      }
+      sum_ += val;
+      parity_ = !parity_;
+    }
+  }
+
+  uint16_t value() const
+  {
+    uint32_t ret = sum_;
+    while ( ret > 0xffff ) {
+      ret = ( ret >> 16 ) + static_cast<uint16_t>( ret );
+    }
+    return ~ret;
+  }
+};
+
+// Checksum every packet `rounds` times, returning GB/s (and the checksums, which must agree)
+template<class Checksum>
+double speed_test( const vector<Buffer>& packets, const size_t rounds, vector<uint16_t>& results )
+{
+  size_t bytes = 0;
+  results.clear();
+  const auto start_time = steady_clock::now();
+  for ( size_t round = 0; round < rounds; ++round ) {
+    for ( const auto& packet : packets ) {
+      Checksum check;
+      check.add( packet );
+      if ( round == 0 ) {
+        results.push_back( check.value() );
+      }
+      bytes += packet.size();
+    }
+  }
+  const auto stop_time = steady_clock::now();
+
+  const auto test_duration = duration_cast<duration<double>>( stop_time - start_time );
+  return static_cast<double>( bytes ) / test_duration.count() / 1e9;
+}
+
+void program_body()
+{
+  constexpr size_t num_packets = 1000;
+  constexpr size_t rounds = 200;
+
+  // Packet-sized buffers of odd and even lengths, at odd and even addresses
+  default_random_engine rd { 1071 };
+  uniform_int_distribution<size_t> length_dist { 40, 1500 };
+  uniform_int_distribution<char> ud;
+  vector<Buffer> packets;
+  for ( size_t i = 0; i < num_packets; ++i ) {
+    string storage( length_dist( rd ) + 1, 0 );
+    for ( auto& ch : storage ) {
+      ch = ud( rd );
+    }
+    packets.emplace_back( storage.substr( i % 2 ) );
+  }
+
+  vector<uint16_t> bytewise_results;
+  vector<uint16_t> fast_results;
+  const double bytewise = speed_test<BytewiseChecksum>( packets, rounds, bytewise_results );
+  const double fast = speed_test<InternetChecksum>( packets, rounds, fast_results );
+  if ( bytewise_results != fast_results ) {
+    throw runtime_error( "InternetChecksum disagrees with the byte-at-a-time loop" );
+  }
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  cout << "InternetChecksum of 40-1500 byte packets: byte-at-a-time " << fixed << setprecision( 2 ) << bytewise
+       << " GB/s; " << InternetChecksum::implementation() << ": " << fast << " GB/s (" << setprecision( 1 )
+       << fast / bytewise << "x).\n";
+
+  debug_output << "                 Checksum: " << fixed << setprecision( 2 ) << bytewise << " -> " << fast
+               << " GB/s (" << InternetChecksum::implementation() << ")\n";
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
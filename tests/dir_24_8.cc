@@ -0,0 +1,69 @@
+#include "dir_24_8.hh"
+#include "prefix_trie.hh"
+
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+static uint32_t mask( const uint8_t length )
+{
+  return length == 0 ? 0 : 0xffffffff << ( 32 - length );
+}
+
+int main()
+{
+  try {
+    default_random_engine rd { 24 };
+    uniform_int_distribution<uint32_t> address_dist;
+    uniform_int_distribution<int> length_dist { 0, 32 };
+    uniform_int_distribution<uint16_t> next_hop_dist { 1, Dir24_8Table::MAX_NEXT_HOP };
+
+    for ( size_t trial = 0; trial < 3; ++trial ) {
+      // nested prefixes of every length, clustered into a few /16s so that long ones share /24s
+      map<pair<uint32_t, uint8_t>, uint16_t> unique;
+      for ( size_t i = 0; i < 3000; ++i ) {
+        const auto length = static_cast<uint8_t>( length_dist( rd ) );
+        uint32_t prefix = i % 2 ? address_dist( rd ) : ( 0x0a000000 | ( address_dist( rd ) & 0x0003ffff ) );
+        prefix &= mask( length );
+        unique[{ prefix, length }] = next_hop_dist( rd );
+      }
+
+      vector<Dir24_8Table::Route> routes;
+      PrefixTrie<uint16_t> trie;
+      for ( const auto& [prefix, next_hop] : unique ) {
+        routes.push_back( { prefix.first, prefix.second, next_hop } );
+        trie.insert( prefix.first, prefix.second, next_hop );
+      }
+      const Dir24_8Table table { routes };
+      if ( table.overflow_blocks() == 0 ) {
+        throw runtime_error( "test should have needed overflow blocks" );
+      }
+
+      for ( size_t i = 0; i < 200000; ++i ) {
+        uint32_t address = address_dist( rd );
+        if ( i % 2 ) {
+          const auto& route = routes[address % routes.size()];
+          address = route.prefix | ( address_dist( rd ) & ~mask( route.length ) );
+        }
+        const uint16_t* expected = trie.lookup( address );
+        const uint16_t actual = table.lookup( address );
+        if ( actual != ( expected ? *expected : Dir24_8Table::NO_ROUTE ) ) {
+          throw runtime_error( "lookup of " + to_string( address ) + " found next hop " + to_string( actual )
+                               + ", expected " + to_string( expected ? *expected : 0 ) );
+        }
+      }
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,80 @@
+#include "arp_message.hh"
+#include "decoded_frame.hh"
+#include "ethernet_frame.hh"
+#include "ipv4_datagram.hh"
+#include "test_helpers.hh"
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// A frame carrying an IPv4 datagram, parsed from its bytes as a frame off the wire would be
+static EthernetFrame ipv4_frame()
+{
+  InternetDatagram dgram;
+  dgram.header.ttl = 9;
+  dgram.header.src = 0x0a000001;
+  dgram.header.dst = 0xc0a80102;
+  dgram.header.len = IPv4Header::LENGTH + 5;
+  dgram.header.compute_checksum();
+  dgram.payload = { Buffer { "hello" } };
+
+  const EthernetHeader header { .dst = ETHERNET_BROADCAST, .src = {}, .type = EthernetHeader::TYPE_IPv4 };
+  const EthernetFrame original { .header = header, .payload = serialize( dgram ) };
+  EthernetFrame frame;
+  expect( parse( frame, { Buffer { concatenate( serialize( original ) ) } } ), "frame does not parse" );
+  return frame;
+}
+
+// The payload is decoded once, however often it is asked for
+static void decoded_once()
+{
+  const EthernetFrame frame = ipv4_frame();
+  DecodedFrame decoded { frame };
+  const InternetDatagram* dgram = decoded.ipv4();
+  expect( dgram != nullptr and dgram->header.ttl == 9 and dgram->header.dst == 0xc0a80102,
+          "IPv4 datagram misdecoded" );
+  expect( concatenate( dgram->payload ) == "hello", "IPv4 payload misdecoded" );
+  expect( decoded.ipv4() == dgram, "IPv4 datagram decoded again" );
+  expect( decoded.arp() == nullptr, "IPv4 frame decoded as ARP" );
+
+  // the decode belongs to its DecodedFrame: another one, of the same frame, decodes for itself
+  DecodedFrame again { frame };
+  expect( again.ipv4() != nullptr and again.ipv4() != dgram and again.ipv4()->header.ttl == 9,
+          "decode shared between DecodedFrames" );
+}
+
+static void bad_payloads()
+{
+  ARPMessage arp;
+  arp.opcode = ARPMessage::OPCODE_REQUEST;
+  arp.sender_ip_address = 0x0a000001;
+  arp.target_ip_address = 0x0a000002;
+  const EthernetHeader arp_header { .dst = ETHERNET_BROADCAST, .src = {}, .type = EthernetHeader::TYPE_ARP };
+  const EthernetFrame arp_frame { .header = arp_header, .payload = serialize( arp ) };
+  DecodedFrame decoded_arp { arp_frame };
+  expect( decoded_arp.ipv4() == nullptr, "ARP frame decoded as IPv4" );
+  expect( decoded_arp.arp() != nullptr and decoded_arp.arp()->target_ip_address == 0x0a000002, "ARP misdecoded" );
+
+  const EthernetHeader ipv4_header { .dst = ETHERNET_BROADCAST, .src = {}, .type = EthernetHeader::TYPE_IPv4 };
+  const EthernetFrame truncated { .header = ipv4_header,
+                                  .payload = { Buffer { string( IPv4Header::LENGTH - 1, 0 ) } } };
+  DecodedFrame decoded_truncated { truncated };
+  expect( decoded_truncated.ipv4() == nullptr, "truncated datagram decoded" );
+}
+
+int main()
+{
+  try {
+    decoded_once();
+    bad_payloads();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
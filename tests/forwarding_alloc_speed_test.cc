@@ -0,0 +1,192 @@
+#include "packet_pool.hh"
+#include "router.hh"
+#include "router_fixture.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+// Every allocation made by the program (the test is single-threaded)
+static size_t allocations = 0;
+static size_t allocated_bytes = 0;
+
+// (GCC sees operator delete free() memory from operator new, not knowing that this operator new uses malloc)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+void* operator new( size_t size )
+{
+  ++allocations;
+  allocated_bytes += size;
+  void* ptr = malloc( size ); // NOLINT(*-no-malloc, *-owning-memory)
+  if ( ptr == nullptr ) {
+    throw bad_alloc();
+  }
+  return ptr;
+}
+
+void operator delete( void* ptr ) noexcept
+{
+  free( ptr ); // NOLINT(*-no-malloc, *-owning-memory)
+}
+
+void operator delete( void* ptr, size_t /* size */ ) noexcept
+{
+  free( ptr ); // NOLINT(*-no-malloc, *-owning-memory)
+}
+
+#pragma GCC diagnostic pop
+
+static constexpr size_t num_interfaces = 4;
+static constexpr size_t payload_length = 1400;
+
+struct Result
+{
+  double packets_per_second;
+  double receive_allocations; // per packet, in recv_frame
+  double send_allocations;    // per packet, from route() to the buffers handed to the write
+  double send_bytes;          // per packet, allocated on the same path
+  double pool_reuse;          // fraction of PacketPool requests served from a free list
+};
+
+// Forward `num_datagrams` datagrams of `payload_length` bytes through a four-interface router, serializing
+// each outgoing frame as it would be written to a file descriptor, and counting the allocations on the way.
+static Result forwarding_alloc_test( const size_t num_datagrams )
+{
+  Router router;
+  vector<NetworkInterface> neighbors;
+  for ( size_t i = 0; i < num_interfaces; ++i ) {
+    router.add_interface( AsyncNetworkInterface { ethernet_address( 1, i ), interface_address( 1, i ) } );
+    neighbors.emplace_back( ethernet_address( 2, i ), interface_address( 2, i ) );
+  }
+  for ( size_t i = 0; i < num_interfaces; ++i ) {
+    router.add_route( ( 10U << 24 ) | ( ( i + 1 ) << 16 ), 16, interface_address( 2, i ), i );
+    router.add_route( ( 10U << 24 ) | ( i << 8 ), 24, {}, i );
+  }
+
+  // Resolve Ethernet addresses (by ARP) between the router and every neighbor
+  for ( size_t i = 0; i < num_interfaces; ++i ) {
+    for ( size_t j = 0; j < num_interfaces; ++j ) {
+      if ( i != j ) {
+        const uint32_t dst = ( 10U << 24 ) | ( ( j + 1 ) << 16 );
+        neighbors[i].send_datagram( make_datagram( interface_address( 2, i ).ipv4_numeric(), dst, "warm-up" ),
+                                    interface_address( 1, i ) );
+        exchange_frames( neighbors[i], router.interface( i ) );
+        router.route();
+        exchange_frames( router.interface( j ), neighbors[j] );
+      }
+    }
+  }
+
+  constexpr size_t frames_per_interface = 64;
+  default_random_engine rd { 1624 };
+  uniform_int_distribution<uint16_t> host_dist;
+  const string payload( payload_length, 'x' );
+  vector<vector<EthernetFrame>> frames( num_interfaces );
+  for ( size_t i = 0; i < num_interfaces; ++i ) {
+    for ( size_t n = 0; n < frames_per_interface; ++n ) {
+      const size_t j = ( i + 1 + n % ( num_interfaces - 1 ) ) % num_interfaces;
+      const uint32_t dst = ( 10U << 24 ) | ( ( j + 1 ) << 16 ) | host_dist( rd );
+      neighbors[i].send_datagram( make_datagram( interface_address( 2, i ).ipv4_numeric(), dst, payload ),
+                                  interface_address( 1, i ) );
+      frames[i].push_back( neighbors[i].maybe_send().value() );
+    }
+  }
+
+  size_t forwarded = 0;
+  size_t bytes_written = 0;
+  size_t receive_allocations = 0;
+  size_t send_allocations = 0;
+  size_t send_bytes = 0;
+  PacketPool::reset_stats();
+  const auto start_time = steady_clock::now();
+  for ( size_t sent = 0; sent < num_datagrams; sent += num_interfaces * frames_per_interface ) {
+    size_t before = allocations;
+    for ( size_t n = 0; n < frames_per_interface; ++n ) {
+      for ( size_t i = 0; i < num_interfaces; ++i ) {
+        router.interface( i ).recv_frame( frames[i][n] );
+      }
+    }
+    receive_allocations += allocations - before;
+
+    before = allocations;
+    const size_t bytes_before = allocated_bytes;
+    router.route();
+    for ( size_t i = 0; i < num_interfaces; ++i ) {
+      while ( auto frame = router.interface( i ).maybe_send() ) {
+        for ( const auto& buffer : serialize( frame.value() ) ) {
+          bytes_written += buffer.size();
+        }
+        ++forwarded;
+      }
+    }
+    send_allocations += allocations - before;
+    send_bytes += allocated_bytes - bytes_before;
+  }
+  const auto stop_time = steady_clock::now();
+
+  if ( forwarded < num_datagrams ) {
+    throw runtime_error( "router forwarded " + to_string( forwarded ) + " of " + to_string( num_datagrams )
+                         + " datagrams" );
+  }
+  if ( bytes_written != forwarded * ( EthernetHeader::LENGTH + IPv4Header::LENGTH + payload_length ) ) {
+    throw runtime_error( "forwarded frames have the wrong length" );
+  }
+
+  const auto test_duration = duration_cast<duration<double>>( stop_time - start_time );
+  const auto per_packet = [&]( const size_t count ) {
+    return static_cast<double>( count ) / static_cast<double>( forwarded );
+  };
+  return { static_cast<double>( forwarded ) / test_duration.count(),
+           per_packet( receive_allocations ),
+           per_packet( send_allocations ),
+           per_packet( send_bytes ),
+           static_cast<double>( PacketPool::stats().reused )
+             / static_cast<double>( PacketPool::stats().reused + PacketPool::stats().allocated ) };
+}
+
+void program_body()
+{
+  const Result result = forwarding_alloc_test( 1'000'000 );
+
+  // The payload must be shared, not copied, between route() and the write
+  if ( result.send_bytes >= payload_length ) {
+    throw runtime_error( "send path allocated " + to_string( result.send_bytes ) + " bytes per "
+                         + to_string( payload_length ) + "-byte datagram" );
+  }
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  cout << "Router forwarding (" << payload_length << "-byte payloads): " << fixed << setprecision( 0 )
+       << result.packets_per_second << " packets/s; allocations per packet: " << setprecision( 1 )
+       << result.receive_allocations << " receiving, " << result.send_allocations << " sending ("
+       << setprecision( 0 ) << result.send_bytes << " bytes); " << setprecision( 1 ) << 100 * result.pool_reuse
+       << "% of packet buffers reused.\n";
+
+  debug_output << "  Forwarding allocations: " << fixed << setprecision( 1 ) << result.receive_allocations
+               << " rx + " << result.send_allocations << " tx per packet (" << setprecision( 0 )
+               << result.send_bytes << " tx bytes)\n";
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
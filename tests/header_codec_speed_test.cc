@@ -0,0 +1,202 @@
+#include "ipv4_header.hh"
+#include "tcp_segment.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+// The hand-written codecs the layouts replaced: a field at a time through Parser::integer and Serializer::integer
+static void hand_parse( IPv4Header& h, TCPHeader& t, Parser& parser )
+{
+  uint8_t first_byte {};
+  parser.integer( first_byte );
+  h.ver = first_byte >> 4;
+  h.hlen = first_byte & 0x0f;
+  parser.integer( h.tos );
+  parser.integer( h.len );
+  parser.integer( h.id );
+  uint16_t fo_val {};
+  parser.integer( fo_val );
+  h.df = static_cast<bool>( fo_val & 0x4000 );
+  h.mf = static_cast<bool>( fo_val & 0x2000 );
+  h.offset = fo_val & 0x1fff;
+  parser.integer( h.ttl );
+  parser.integer( h.proto );
+  parser.integer( h.cksum );
+  parser.integer( h.src );
+  parser.integer( h.dst );
+
+  parser.integer( t.src_port );
+  parser.integer( t.dst_port );
+  parser.integer( t.seqno );
+  parser.integer( t.ackno );
+  uint8_t data_offset {};
+  parser.integer( data_offset );
+  t.data_offset = data_offset >> 4;
+  uint8_t flags {};
+  parser.integer( flags );
+  t.ack = flags & 0b0001'0000;
+  t.rst = flags & 0b0000'0100;
+  t.syn = flags & 0b0000'0010;
+  t.fin = flags & 0b0000'0001;
+  parser.integer( t.window_size );
+  parser.integer( t.cksum );
+  parser.integer( t.urgent_pointer );
+}
+
+static void hand_serialize( const IPv4Header& h, const TCPHeader& t, Serializer& serializer )
+{
+  serializer.integer( static_cast<uint8_t>( h.ver << 4 | ( h.hlen & 0xf ) ) );
+  serializer.integer( h.tos );
+  serializer.integer( h.len );
+  serializer.integer( h.id );
+  const uint16_t fo_val = ( h.df ? 0x4000 : 0 ) | ( h.mf ? 0x2000 : 0 ) | ( h.offset & 0x1fff );
+  serializer.integer( fo_val );
+  serializer.integer( h.ttl );
+  serializer.integer( h.proto );
+  serializer.integer( h.cksum );
+  serializer.integer( h.src );
+  serializer.integer( h.dst );
+
+  serializer.integer( t.src_port );
+  serializer.integer( t.dst_port );
+  serializer.integer( t.seqno );
+  serializer.integer( t.ackno );
+  serializer.integer( static_cast<uint8_t>( t.data_offset << 4 ) );
+  serializer.integer( static_cast<uint8_t>( t.ack << 4 | t.rst << 2 | t.syn << 1 | static_cast<int>( t.fin ) ) );
+  serializer.integer( t.window_size );
+  serializer.integer( t.cksum );
+  serializer.integer( t.urgent_pointer );
+}
+
+static void layout_parse( IPv4Header& h, TCPHeader& t, Parser& parser )
+{
+  IPv4HeaderLayout::parse( h, parser );
+  TCPHeaderLayout::parse( t, parser );
+}
+
+static void layout_serialize( const IPv4Header& h, const TCPHeader& t, Serializer& serializer )
+{
+  IPv4HeaderLayout::serialize( h, serializer );
+  TCPHeaderLayout::serialize( t, serializer );
+}
+
+// Parse the IPv4 and TCP headers of every packet `rounds` times, returning nanoseconds per packet
+template<class ParseFn>
+static double parse_test( const vector<vector<Buffer>>& packets, const size_t rounds, ParseFn&& parse_fn )
+{
+  uint64_t total = 0;
+  const auto start_time = steady_clock::now();
+  for ( size_t round = 0; round < rounds; ++round ) {
+    for ( const auto& packet : packets ) {
+      IPv4Header h;
+      TCPHeader t;
+      Parser parser { packet };
+      parse_fn( h, t, parser );
+      if ( parser.has_error() ) {
+        throw runtime_error( "failed to parse headers" );
+      }
+      total += h.src + t.seqno;
+    }
+  }
+  const auto stop_time = steady_clock::now();
+
+  if ( total == 0 ) {
+    throw runtime_error( "parsed nothing" );
+  }
+
+  const auto test_duration = duration_cast<duration<double, nano>>( stop_time - start_time );
+  return test_duration.count() / static_cast<double>( packets.size() * rounds );
+}
+
+// Serialize the IPv4 and TCP headers of every packet `rounds` times, returning nanoseconds per packet
+template<class SerializeFn>
+static double serialize_test( const vector<pair<IPv4Header, TCPHeader>>& headers,
+                              const size_t rounds,
+                              SerializeFn&& serialize_fn )
+{
+  size_t bytes = 0;
+  const auto start_time = steady_clock::now();
+  for ( size_t round = 0; round < rounds; ++round ) {
+    for ( const auto& [h, t] : headers ) {
+      Serializer serializer;
+      serialize_fn( h, t, serializer );
+      for ( const auto& buf : serializer.output() ) {
+        bytes += buf.size();
+      }
+    }
+  }
+  const auto stop_time = steady_clock::now();
+
+  if ( bytes != headers.size() * rounds * ( IPv4Header::LENGTH + TCPHeaderLayout::LENGTH ) ) {
+    throw runtime_error( "serialized the wrong number of bytes" );
+  }
+
+  const auto test_duration = duration_cast<duration<double, nano>>( stop_time - start_time );
+  return test_duration.count() / static_cast<double>( headers.size() * rounds );
+}
+
+void program_body()
+{
+  constexpr size_t num_packets = 1000;
+  constexpr size_t rounds = 1000;
+
+  default_random_engine rd { 4093 };
+  uniform_int_distribution<uint32_t> ud;
+  vector<pair<IPv4Header, TCPHeader>> headers;
+  vector<vector<Buffer>> packets;
+  for ( size_t i = 0; i < num_packets; ++i ) {
+    IPv4Header h;
+    h.len = ud( rd );
+    h.id = ud( rd );
+    h.src = ud( rd ) | 1;
+    h.dst = ud( rd );
+    TCPHeader t { .src_port = static_cast<uint16_t>( ud( rd ) ),
+                  .dst_port = static_cast<uint16_t>( ud( rd ) ),
+                  .seqno = ud( rd ),
+                  .ackno = ud( rd ),
+                  .data_offset = 5,
+                  .ack = true,
+                  .window_size = static_cast<uint16_t>( ud( rd ) ) };
+    Serializer serializer;
+    hand_serialize( h, t, serializer );
+    packets.push_back( serializer.output() );
+    headers.emplace_back( h, t );
+  }
+
+  const double hand_parse_ns = parse_test( packets, rounds, hand_parse );
+  const double layout_parse_ns = parse_test( packets, rounds, layout_parse );
+  const double hand_serialize_ns = serialize_test( headers, rounds, hand_serialize );
+  const double layout_serialize_ns = serialize_test( headers, rounds, layout_serialize );
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  cout << fixed << setprecision( 1 ) << "IPv4 and TCP headers: parse " << layout_parse_ns
+       << " ns per packet from the layouts (" << hand_parse_ns << " ns field by field); serialize "
+       << layout_serialize_ns << " ns (" << hand_serialize_ns << " ns field by field).\n";
+
+  debug_output << fixed << setprecision( 1 ) << "    IPv4/TCP header codecs: parse " << layout_parse_ns << " ns ("
+               << hand_parse_ns << " hand-written), serialize " << layout_serialize_ns << " ns ("
+               << hand_serialize_ns << " hand-written)\n";
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,202 @@
+#include "arp_message.hh"
+#include "ethernet_header.hh"
+#include "ipv4_header.hh"
+#include "tcp_segment.hh"
+#include "test_helpers.hh"
+
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// The bytes of a header, written out field by field as the hand-written serializers did
+static string reference_bytes( const IPv4Header& h )
+{
+  Serializer s;
+  s.integer( static_cast<uint8_t>( h.ver << 4 | ( h.hlen & 0xf ) ) );
+  s.integer( h.tos );
+  s.integer( h.len );
+  s.integer( h.id );
+  s.integer( static_cast<uint16_t>( ( h.df ? 0x4000 : 0 ) | ( h.mf ? 0x2000 : 0 ) | ( h.offset & 0x1fff ) ) );
+  s.integer( h.ttl );
+  s.integer( h.proto );
+  s.integer( h.cksum );
+  s.integer( h.src );
+  s.integer( h.dst );
+  return concatenate( s.output() );
+}
+
+static string reference_bytes( const TCPHeader& h )
+{
+  Serializer s;
+  s.integer( h.src_port );
+  s.integer( h.dst_port );
+  s.integer( h.seqno );
+  s.integer( h.ackno );
+  s.integer( static_cast<uint8_t>( h.data_offset << 4 ) );
+  s.integer( static_cast<uint8_t>( h.ack << 4 | h.rst << 2 | h.syn << 1 | static_cast<int>( h.fin ) ) );
+  s.integer( h.window_size );
+  s.integer( h.cksum );
+  s.integer( h.urgent_pointer );
+  return concatenate( s.output() );
+}
+
+static string reference_bytes( const ARPMessage& m )
+{
+  Serializer s;
+  s.integer( m.hardware_type );
+  s.integer( m.protocol_type );
+  s.integer( m.hardware_address_size );
+  s.integer( m.protocol_address_size );
+  s.integer( m.opcode );
+  for ( const auto b : m.sender_ethernet_address ) {
+    s.integer( b );
+  }
+  s.integer( m.sender_ip_address );
+  for ( const auto b : m.target_ethernet_address ) {
+    s.integer( b );
+  }
+  s.integer( m.target_ip_address );
+  return concatenate( s.output() );
+}
+
+template<class Layout, class Header>
+static string layout_bytes( const Header& header )
+{
+  Serializer s;
+  Layout::serialize( header, s );
+  return concatenate( s.output() );
+}
+
+template<class Layout, class Header>
+static Header layout_parse( const string& bytes )
+{
+  Header header {};
+  Parser parser { { Buffer { bytes } } };
+  Layout::parse( header, parser );
+  expect( not parser.has_error(), "layout failed to parse a whole header" );
+  return header;
+}
+
+// A header with known bytes (an IPv4 header carrying UDP)
+static void known_bytes()
+{
+  const string bytes { "\x45\x00\x00\x73\x00\x00\x40\x00\x40\x11\xb8\x61\xc0\xa8\x00\x01\xc0\xa8\x00\xc7", 20 };
+  const auto h = layout_parse<IPv4HeaderLayout, IPv4Header>( bytes );
+  expect( h.ver == 4 and h.hlen == 5 and h.tos == 0 and h.len == 0x73 and h.id == 0, "IPv4 header misparsed" );
+  expect( h.df and not h.mf and h.offset == 0 and h.ttl == 64 and h.proto == 17, "IPv4 flags misparsed" );
+  expect( h.cksum == 0xb861 and h.src == 0xc0a80001 and h.dst == 0xc0a800c7, "IPv4 addresses misparsed" );
+  expect( layout_bytes<IPv4HeaderLayout>( h ) == bytes, "IPv4 header reserialized differently" );
+
+  expect( IPv4HeaderLayout::to_string( h )
+            == "ver=4, hlen=5, tos=0, len=115, id=0, df=true, mf=false, offset=0, ttl=64, proto=17, cksum=47201, "
+               "src=3232235521, dst=3232235719",
+          "IPv4 header to_string: " + IPv4HeaderLayout::to_string( h ) );
+
+  const EthernetHeader eth { { 0x02, 0, 0, 0, 0, 0x0a }, ETHERNET_BROADCAST, EthernetHeader::TYPE_ARP };
+  expect( EthernetHeaderLayout::to_string( eth ) == "dst=02:00:00:00:00:0a, src=ff:ff:ff:ff:ff:ff, type=2054",
+          "Ethernet header to_string: " + EthernetHeaderLayout::to_string( eth ) );
+}
+
+// Packed fields are truncated to their bits, and bits outside every field are ignored when read
+static void packed_fields()
+{
+  IPv4Header h;
+  h.ver = 0xff;
+  h.hlen = 0x1e;
+  h.offset = 0xffff;
+  h.df = false;
+  const string bytes = layout_bytes<IPv4HeaderLayout>( h );
+  expect( bytes[0] == '\xfe' and bytes[6] == '\x1f' and bytes[7] == '\xff', "packed fields not truncated" );
+
+  string tcp( 20, 0 );
+  tcp[12] = '\x5f'; // data offset 5, and the reserved bits set
+  tcp[13] = '\xf2'; // CWR, ECE, URG, ACK and SYN
+  const auto header = layout_parse<TCPHeaderLayout, TCPHeader>( tcp );
+  expect( header.data_offset == 5 and header.ack and header.syn and not header.rst and not header.fin,
+          "TCP flags misparsed" );
+  expect( layout_bytes<TCPHeaderLayout>( header )[12] == '\x50', "reserved bits not written as zero" );
+}
+
+// Random headers survive a round trip, and serialize to the same bytes as the hand-written codecs
+static void round_trips()
+{
+  default_random_engine rd { 2047 };
+  uniform_int_distribution<uint32_t> ud;
+
+  for ( size_t trial = 0; trial < 1000; ++trial ) {
+    IPv4Header ip;
+    ip.hlen = ud( rd ) % 16;
+    ip.tos = ud( rd );
+    ip.len = ud( rd );
+    ip.id = ud( rd );
+    ip.df = ud( rd ) % 2;
+    ip.mf = ud( rd ) % 2;
+    ip.offset = ud( rd ) % 0x2000;
+    ip.ttl = ud( rd );
+    ip.proto = ud( rd );
+    ip.cksum = ud( rd );
+    ip.src = ud( rd );
+    ip.dst = ud( rd );
+    const string ip_bytes = layout_bytes<IPv4HeaderLayout>( ip );
+    expect( ip_bytes == reference_bytes( ip ), "IPv4 header serialized differently from the reference" );
+    const auto ip_again = layout_parse<IPv4HeaderLayout, IPv4Header>( ip_bytes );
+    expect( reference_bytes( ip_again ) == ip_bytes, "IPv4 header did not survive a round trip" );
+
+    TCPHeader tcp { .src_port = static_cast<uint16_t>( ud( rd ) ),
+                    .dst_port = static_cast<uint16_t>( ud( rd ) ),
+                    .seqno = ud( rd ),
+                    .ackno = ud( rd ),
+                    .data_offset = static_cast<uint8_t>( ud( rd ) % 16 ),
+                    .ack = ud( rd ) % 2 == 0,
+                    .rst = ud( rd ) % 2 == 0,
+                    .syn = ud( rd ) % 2 == 0,
+                    .fin = ud( rd ) % 2 == 0,
+                    .window_size = static_cast<uint16_t>( ud( rd ) ),
+                    .cksum = static_cast<uint16_t>( ud( rd ) ),
+                    .urgent_pointer = static_cast<uint16_t>( ud( rd ) ) };
+    const string tcp_bytes = layout_bytes<TCPHeaderLayout>( tcp );
+    expect( tcp_bytes == reference_bytes( tcp ), "TCP header serialized differently from the reference" );
+    const auto tcp_again = layout_parse<TCPHeaderLayout, TCPHeader>( tcp_bytes );
+    expect( reference_bytes( tcp_again ) == tcp_bytes, "TCP header did not survive a round trip" );
+
+    ARPMessage arp;
+    arp.opcode = ud( rd ) % 2 ? ARPMessage::OPCODE_REQUEST : ARPMessage::OPCODE_REPLY;
+    for ( auto& b : arp.sender_ethernet_address ) {
+      b = ud( rd );
+    }
+    for ( auto& b : arp.target_ethernet_address ) {
+      b = ud( rd );
+    }
+    arp.sender_ip_address = ud( rd );
+    arp.target_ip_address = ud( rd );
+    const string arp_bytes = concatenate( serialize( arp ) );
+    expect( arp_bytes == reference_bytes( arp ), "ARP message serialized differently from the reference" );
+    ARPMessage arp_again;
+    expect( parse( arp_again, { Buffer { arp_bytes } } ) and reference_bytes( arp_again ) == arp_bytes,
+            "ARP message did not survive a round trip" );
+  }
+
+  // too short a header is an error
+  IPv4Header short_header;
+  Parser parser { { Buffer { string( IPv4Header::LENGTH - 1, 0 ) } } };
+  IPv4HeaderLayout::parse( short_header, parser );
+  expect( parser.has_error(), "too short a header parsed" );
+}
+
+int main()
+{
+  try {
+    known_bytes();
+    packed_fields();
+    round_trips();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,334 @@
+#include "eventloop.hh"
+#include "exception.hh"
+#include "io_uring.hh"
+
+#include <array>
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+static pair<FileDescriptor, FileDescriptor> socket_pair( const int type )
+{
+  array<int, 2> fds {};
+  CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, type, 0, fds.data() ) );
+  return { FileDescriptor( fds[0] ), FileDescriptor( fds[1] ) };
+}
+
+static string message( const size_t i )
+{
+  return "datagram #" + to_string( i ) + " " + string( i * 7, 'x' );
+}
+
+// Queue a batch of writes with one submission, then receive them all with one multishot recv.
+static void batched_write_multishot_recv()
+{
+  constexpr size_t count = 48;
+  constexpr uint16_t group = 7;
+  constexpr uint64_t recv_token = 1000;
+
+  auto [a, b] = socket_pair( SOCK_DGRAM );
+  IOUring ring { 16 };
+
+  vector<string> sent;
+  for ( size_t i = 0; i < count; ++i ) {
+    sent.push_back( message( i ) );
+  }
+  for ( size_t i = 0; i < count; ++i ) {
+    ring.prepare_write( a, sent[i], i + 1 ); // submission queue is smaller than the batch
+  }
+  ring.provide_buffers( group, 8, 1024 ); // fewer buffers than datagrams: they must be recycled
+  ring.prepare_recv_multishot( b, group, recv_token );
+
+  size_t writes_done = 0;
+  vector<string> received;
+  while ( received.size() < count ) {
+    if ( not ring.wait( 1000 ) ) {
+      throw runtime_error( "timed out waiting for completions" );
+    }
+    ring.reap( [&]( const IOUring::Completion& c ) {
+      if ( c.user_data == 0 ) {
+        if ( c.result < 0 ) {
+          throw unix_error( "provide_buffers", -c.result );
+        }
+        return;
+      }
+      if ( c.user_data == recv_token ) {
+        if ( c.result == -ENOBUFS ) { // ran out of buffers before we recycled: re-arm
+          ring.prepare_recv_multishot( b, group, recv_token );
+          return;
+        }
+        if ( c.result < 0 ) {
+          throw unix_error( "recv", -c.result );
+        }
+        received.emplace_back( ring.provided_buffer( group, c ) );
+        ring.recycle_buffer( group, c.buffer_id().value() );
+        if ( not c.more() ) {
+          ring.prepare_recv_multishot( b, group, recv_token );
+        }
+        return;
+      }
+      if ( c.result != static_cast<int32_t>( sent.at( c.user_data - 1 ).size() ) ) {
+        throw runtime_error( "short write in batch" );
+      }
+      ++writes_done;
+    } );
+  }
+
+  if ( writes_done != count ) {
+    throw runtime_error( "missing write completions" );
+  }
+  if ( received != sent ) {
+    throw runtime_error( "datagrams received out of order or corrupted" );
+  }
+}
+
+// Round-trip data through registered (fixed) buffers.
+static void registered_buffers()
+{
+  auto [a, b] = socket_pair( SOCK_STREAM );
+  IOUring ring;
+  ring.register_buffers( 2, 4096 );
+
+  const string payload = "hello, registered buffers";
+  ring.fixed_buffer( 0 ).replace( 0, payload.size(), payload );
+  ring.prepare_write_fixed( a, 0, payload.size(), 1 );
+  ring.prepare_read_fixed( b, 1, 2 );
+
+  int32_t read_len = -1;
+  while ( read_len < 0 ) {
+    if ( not ring.wait( 1000 ) ) {
+      throw runtime_error( "timed out waiting for fixed-buffer I/O" );
+    }
+    ring.reap( [&]( const IOUring::Completion& c ) {
+      if ( c.result < 0 ) {
+        throw unix_error( "fixed-buffer I/O", -c.result );
+      }
+      if ( c.user_data == 2 ) {
+        read_len = c.result;
+      }
+    } );
+  }
+
+  if ( ring.fixed_buffer( 1 ).substr( 0, read_len ) != payload ) {
+    throw runtime_error( "registered buffer contents mismatch" );
+  }
+}
+
+// Ping-pong messages through an EventLoop; the result must not depend on the backend.
+static void eventloop_ping_pong( const EventLoop::Backend backend )
+{
+  constexpr size_t rounds = 500;
+
+  auto [a, b] = socket_pair( SOCK_STREAM );
+  a.set_blocking( false );
+  b.set_blocking( false );
+
+  EventLoop loop { backend };
+  size_t a_received = 0;
+  size_t b_received = 0;
+  bool a_owes_write = true;
+  bool b_owes_write = false;
+  string buf;
+
+  loop.add_rule(
+    "a writes",
+    a,
+    Direction::Out,
+    [&] {
+      a.write( "p" );
+      a_owes_write = false;
+    },
+    [&] { return a_owes_write and a_received < rounds; } );
+
+  loop.add_rule(
+    "b reads",
+    b,
+    Direction::In,
+    [&] {
+      buf.clear();
+      b.read( buf );
+      b_received += buf.size();
+      b_owes_write = true;
+    },
+    [&] { return b_received < rounds; } );
+
+  loop.add_rule(
+    "b writes",
+    b,
+    Direction::Out,
+    [&] {
+      b.write( "q" );
+      b_owes_write = false;
+    },
+    [&] { return b_owes_write; } );
+
+  loop.add_rule(
+    "a reads",
+    a,
+    Direction::In,
+    [&] {
+      buf.clear();
+      a.read( buf );
+      a_received += buf.size();
+      a_owes_write = true;
+    },
+    [&] { return a_received < rounds; } );
+
+  while ( loop.wait_next_event( 1000 ) != EventLoop::Result::Exit ) {}
+
+  if ( a_received != rounds or b_received != rounds ) {
+    throw runtime_error( "ping-pong did not complete" );
+  }
+
+  // an idle loop times out instead of spinning
+  auto [c, d] = socket_pair( SOCK_STREAM );
+  EventLoop idle { backend };
+  idle.add_rule( "never readable", c, Direction::In, [&] { c.read( buf ); } );
+  if ( idle.wait_next_event( 20 ) != EventLoop::Result::Timeout ) {
+    throw runtime_error( "idle EventLoop did not time out" );
+  }
+}
+
+// Datagrams reach a receive rule whole and in order, whether its fd is a socket or not, and EOF ends the rule.
+static void receive_rule( const EventLoop::Backend backend, const bool socket )
+{
+  constexpr size_t count = 48; // more than the ring has buffers for at once
+  constexpr size_t batch = 8;  // (a packet-mode pipe holds only 16 packets)
+
+  array<int, 2> fds {};
+  if ( socket ) {
+    // (seqpacket, because a datagram socket never sees EOF)
+    CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_SEQPACKET, 0, fds.data() ) );
+  } else {
+    CheckSystemCall( "pipe2", ::pipe2( fds.data(), O_DIRECT ) ); // packet mode: each write is read on its own
+  }
+  FileDescriptor reader { fds[0] };
+  FileDescriptor writer { fds[1] };
+  reader.set_blocking( false );
+
+  EventLoop loop { backend };
+  vector<string> sent;
+  vector<string> received;
+  bool cancelled = false;
+  loop.add_receive_rule(
+    "receive datagrams",
+    reader,
+    1024,
+    [&]( const string_view datagram ) { received.emplace_back( datagram ); },
+    [] { return true; },
+    [&] { cancelled = true; } );
+
+  while ( sent.size() < count ) {
+    for ( size_t i = 0; i < batch; ++i ) {
+      sent.push_back( message( sent.size() ) );
+      writer.write( sent.back() );
+    }
+    while ( received.size() < sent.size() ) {
+      if ( loop.wait_next_event( 1000 ) != EventLoop::Result::Success ) {
+        throw runtime_error( "receive rule did not get its datagrams" );
+      }
+    }
+  }
+  if ( received != sent ) {
+    throw runtime_error( "receive rule got datagrams out of order or corrupted" );
+  }
+
+  writer.close();
+  size_t waits = 0;
+  while ( loop.wait_next_event( 1000 ) != EventLoop::Result::Exit ) {
+    if ( ++waits > 2 ) {
+      throw runtime_error( "receive rule not ended by EOF" );
+    }
+  }
+  if ( not cancelled or received.size() != count ) {
+    throw runtime_error( "receive rule ended wrongly" );
+  }
+}
+
+// Receive rules added and cancelled over and over (more of them than there are buffer groups) each get their own
+// buffers back from the kernel, so that the groups can be reused without one rule reading into another's buffers.
+static void receive_rules_come_and_go()
+{
+  constexpr size_t rules = 70000; // more than 2^16
+  constexpr size_t check_every = 97;
+
+  auto [keeper_reader, keeper_writer] = socket_pair( SOCK_DGRAM );
+  auto [reader, writer] = socket_pair( SOCK_DGRAM );
+  reader.set_blocking( false );
+
+  EventLoop loop { EventLoop::Backend::IOUring };
+  loop.add_receive_rule( "keep the loop going", keeper_reader, 64, []( string_view ) {}, [] { return true; } );
+
+  const size_t category = loop.add_category( "receive for a while" );
+  vector<string> received;
+  for ( size_t i = 0; i < rules; ++i ) {
+    auto rule = loop.add_receive_rule(
+      category,
+      reader,
+      64,
+      [&]( const string_view datagram ) { received.emplace_back( datagram ); },
+      [] { return true; } );
+
+    if ( i % check_every == 0 ) {
+      const string first = to_string( i );
+      const string second = first + " again"; // (left to be read by the next rule, or cancelled with this one)
+      writer.write( first );
+      writer.write( second );
+      while ( received.empty() or ( received.back() != first and received.back() != second ) ) {
+        if ( loop.wait_next_event( 1000 ) != EventLoop::Result::Success ) {
+          throw runtime_error( "receive rule #" + to_string( i ) + " did not get its datagram" );
+        }
+      }
+    }
+
+    rule.cancel();
+    loop.wait_next_event( 0 );
+  }
+
+  for ( const auto& datagram : received ) {
+    const auto number = datagram.substr( 0, datagram.find( ' ' ) );
+    if ( number.empty() or number.find_first_not_of( "0123456789" ) != string::npos
+         or ( datagram != number and datagram != number + " again" ) ) {
+      throw runtime_error( "receive rule got a corrupted datagram: " + datagram );
+    }
+  }
+}
+
+int main()
+{
+  try {
+    eventloop_ping_pong( EventLoop::Backend::Poll );
+    receive_rule( EventLoop::Backend::Poll, true );
+    receive_rule( EventLoop::Backend::Poll, false );
+
+    if ( not IOUring::available() ) {
+      cerr << "io_uring is not available; skipping io_uring tests\n";
+      if ( EventLoop { EventLoop::Backend::IOUring }.backend() != EventLoop::Backend::Poll ) {
+        throw runtime_error( "EventLoop did not fall back to poll" );
+      }
+      return EXIT_SUCCESS;
+    }
+
+    batched_write_multishot_recv();
+    registered_buffers();
+    eventloop_ping_pong( EventLoop::Backend::IOUring );
+    receive_rule( EventLoop::Backend::IOUring, true );
+    receive_rule( EventLoop::Backend::IOUring, false );
+    receive_rules_come_and_go();
+    if ( EventLoop { EventLoop::Backend::IOUring }.backend() != EventLoop::Backend::IOUring ) {
+      throw runtime_error( "EventLoop did not use io_uring" );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
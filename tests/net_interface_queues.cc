@@ -0,0 +1,92 @@
+#include "arp_message.hh"
+#include "network_interface.hh"
+#include "test_helpers.hh"
+
+#include <cstddef>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+static InternetDatagram make_datagram( const size_t n )
+{
+  InternetDatagram dgram;
+  dgram.header.src = Address { "10.0.0.1" }.ipv4_numeric();
+  dgram.header.dst = Address { "13.12.11.10" }.ipv4_numeric();
+  dgram.payload.emplace_back( to_string( n ) );
+  dgram.header.len = IPv4Header::LENGTH + dgram.payload.front().size();
+  dgram.header.compute_checksum();
+  return dgram;
+}
+
+static string payload( const EthernetFrame& frame )
+{
+  InternetDatagram dgram;
+  expect( frame.header.type == EthernetHeader::TYPE_IPv4 and parse( dgram, frame.payload ), "not a datagram" );
+  return dgram.payload.front();
+}
+
+static EthernetFrame arp_reply( const EthernetAddress& sender_eth,
+                                const string& sender_ip,
+                                const EthernetAddress& target_eth )
+{
+  ARPMessage reply { .opcode = ARPMessage::OPCODE_REPLY,
+                     .sender_ethernet_address = sender_eth,
+                     .sender_ip_address = Address { sender_ip }.ipv4_numeric(),
+                     .target_ethernet_address = target_eth,
+                     .target_ip_address = Address { "10.0.0.1" }.ipv4_numeric() };
+  return { { target_eth, sender_eth, EthernetHeader::TYPE_ARP }, serialize( reply ) };
+}
+
+int main()
+{
+  try {
+    const EthernetAddress local { 0x02, 0, 0, 0, 0, 1 };
+    const EthernetAddress resolved { 0x02, 0, 0, 0, 0, 2 };
+    const EthernetAddress silent { 0x02, 0, 0, 0, 0, 3 };
+    NetworkInterface interface { local, Address { "10.0.0.1" } };
+
+    // One neighbour answers at once...
+    interface.send_datagram( make_datagram( 0 ), Address { "10.0.0.2" } );
+    expect( interface.maybe_send()->header.type == EthernetHeader::TYPE_ARP, "no ARP request" );
+    interface.recv_frame( arp_reply( resolved, "10.0.0.2", local ) );
+    expect( payload( interface.maybe_send().value() ) == "0", "waiting datagram not released" );
+
+    // ...another is slow: its frames wait, up to a limit, without holding up the first neighbour's
+    const size_t burst = NetworkInterface::MAX_WAITING_FRAMES + 100;
+    for ( size_t n = 1; n <= burst; ++n ) {
+      interface.send_datagram( make_datagram( n ), Address { "10.0.0.3" } );
+      interface.send_datagram( make_datagram( n ), Address { "10.0.0.2" } );
+    }
+    expect( interface.waiting_drops() == 100, "expected 100 drops, got " + to_string( interface.waiting_drops() ) );
+    expect( interface.maybe_send()->header.type == EthernetHeader::TYPE_ARP, "no ARP request for 10.0.0.3" );
+    for ( size_t n = 1; n <= burst; ++n ) {
+      const auto frame = interface.maybe_send();
+      expect( frame.has_value() and frame->header.dst == resolved and payload( frame.value() ) == to_string( n ),
+              "frames to the resolved neighbour delayed or out of order" );
+    }
+    expect( not interface.maybe_send().has_value(), "frames sent before the ARP reply" );
+
+    // An unanswered request is repeated after five seconds (once)
+    interface.tick( 4999 );
+    expect( not interface.maybe_send().has_value(), "ARP request repeated too soon" );
+    interface.tick( 1 );
+    expect( interface.maybe_send()->header.type == EthernetHeader::TYPE_ARP, "ARP request not repeated" );
+    expect( not interface.maybe_send().has_value(), "ARP request repeated twice" );
+
+    // The reply releases the waiting frames, in order
+    interface.recv_frame( arp_reply( silent, "10.0.0.3", local ) );
+    for ( size_t n = 1; n <= NetworkInterface::MAX_WAITING_FRAMES; ++n ) {
+      const auto frame = interface.maybe_send();
+      expect( frame.has_value() and frame->header.dst == silent and payload( frame.value() ) == to_string( n ),
+              "waiting frames not released in order" );
+    }
+    expect( not interface.maybe_send().has_value(), "more frames released than were kept" );
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
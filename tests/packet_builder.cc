@@ -0,0 +1,90 @@
+#include "packet_builder.hh"
+#include "tcp_over_ip.hh"
+#include "test_helpers.hh"
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static void building()
+{
+  PacketBuilder packet { { Buffer { string { "pay" } }, Buffer { string { "load" } } }, 8 };
+  expect( packet.bytes() == "payload", "payload not in place" );
+
+  packet.prepend( "hdr:" );
+  expect( packet.bytes() == "hdr:payload", "header not prepended" );
+
+  bool threw = false;
+  try {
+    packet.prepend( "too long" );
+  } catch ( const runtime_error& ) {
+    threw = true;
+  }
+  expect( threw and packet.bytes() == "hdr:payload", "prepend past the headroom" );
+
+  packet.prepend( "ip::" );
+  const Buffer finished = packet.finish();
+  expect( string_view { finished } == "ip::hdr:payload", "finished packet differs" );
+}
+
+// The contiguous datagram is byte-for-byte what serializing each layer separately produces
+static void tcp_in_ip()
+{
+  TCPOverIPv4Adapter adapter;
+  adapter.config_mut().source = Address { "169.254.144.9", 40000 };
+  adapter.config_mut().destination = Address { "169.254.144.1", 80 };
+  TCPOverIPv4Adapter peer;
+  peer.config_mut().source = adapter.config().destination;
+  peer.config_mut().destination = adapter.config().source;
+
+  for ( const size_t length : { 0, 1, 1000 } ) {
+    TCPSegment seg;
+    seg.sender_message.seqno = Wrap32 { 12345 };
+    seg.sender_message.SYN = length == 0;
+    seg.sender_message.payload = string( length, 'x' );
+    seg.receiver_message.ackno = Wrap32 { 678 };
+    seg.receiver_message.window_size = 1000;
+
+    IPv4Header header;
+    const Buffer packet = adapter.build_tcp_in_ip( seg, header );
+
+    InternetDatagram expected;
+    expected.header = header;
+    expected.header.compute_checksum();
+    TCPSegment expected_seg = seg;
+    expected_seg.compute_checksum( expected.header.pseudo_checksum() );
+    expected.payload = serialize( expected_seg );
+    expect( string_view { packet } == concatenate( serialize( expected ) ),
+            "contiguous datagram differs from serializing the layers" );
+
+    InternetDatagram parsed;
+    expect( parse( parsed, { packet } ), "contiguous datagram does not parse" );
+    const auto unwrapped = peer.unwrap_tcp_in_ip( parsed );
+    expect( unwrapped.has_value() and unwrapped->sender_message.payload.size() == length,
+            "contiguous datagram does not carry the segment" );
+
+    TCPSegment again = seg;
+    const InternetDatagram wrapped = adapter.wrap_tcp_in_ip( again );
+    expect( concatenate( serialize( wrapped ) ) == string_view { packet }, "wrap_tcp_in_ip differs" );
+    expect( length == 0
+              or string_view { wrapped.payload.back() }.data()
+                   == string_view { again.sender_message.payload }.data(),
+            "wrap_tcp_in_ip copied the payload" );
+  }
+}
+
+int main()
+{
+  try {
+    building();
+    tcp_in_ip();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
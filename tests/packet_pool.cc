@@ -0,0 +1,132 @@
+#include "buffer.hh"
+#include "packet_pool.hh"
+#include "test_helpers.hh"
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+static void strings()
+{
+  PacketPool::reset_stats();
+  string first = PacketPool::take( 1500 );
+  expect( first.empty() and first.capacity() >= 2048, "string not rounded up to its size class" );
+  expect( PacketPool::stats().allocated == 1, "new string not counted" );
+
+  first = "some bytes";
+  const char* memory = first.data();
+  PacketPool::recycle( move( first ) );
+  expect( PacketPool::stats().recycled == 1, "recycled string not counted" );
+
+  const string again = PacketPool::take( 2000 );
+  expect( again.empty() and again.data() == memory, "string's memory not reused" );
+  expect( PacketPool::stats().reused == 1, "reused string not counted" );
+
+  // a string too small for a request is not handed out for it
+  string small = PacketPool::take( 100 );
+  const char* small_memory = small.data();
+  PacketPool::recycle( move( small ) );
+  expect( PacketPool::take( 1000 ).data() != small_memory, "string too small for the request reused" );
+  expect( PacketPool::take( 65 ).data() == small_memory, "string not reused for a smaller request" );
+
+  // short strings have no memory worth keeping
+  PacketPool::reset_stats();
+  PacketPool::recycle( string { "tiny" } );
+  expect( PacketPool::stats().recycled == 0, "short string recycled" );
+}
+
+static void buffers()
+{
+  string bytes = PacketPool::take( 500 );
+  bytes.assign( 300, 'x' );
+  const char* memory = bytes.data();
+  {
+    const Buffer buffer { move( bytes ) };
+    const Buffer slice = buffer.substr( 10 );
+    expect( slice.data() == memory + 10, "Buffer copied its string" );
+  }
+  // the last reference is gone: the string has gone back to the pool
+  expect( PacketPool::take( 500 ).data() == memory, "Buffer's string not recycled" );
+
+  // a block for a Buffer's storage is reused too
+  PacketPool::reset_stats();
+  for ( size_t i = 0; i < 100; ++i ) {
+    const Buffer buffer { string( 100, 'y' ) };
+  }
+  expect( PacketPool::stats().allocated <= 2, "Buffer storage not reused" );
+}
+
+static void free_list_limit()
+{
+  vector<string> taken;
+  for ( size_t i = 0; i < PacketPool::MAX_FREE + 10; ++i ) {
+    taken.push_back( PacketPool::take( 64 ) );
+  }
+  PacketPool::reset_stats();
+  for ( auto& str : taken ) {
+    PacketPool::recycle( move( str ) );
+  }
+  expect( PacketPool::stats().recycled <= PacketPool::MAX_FREE and PacketPool::stats().released >= 10,
+          "free list grew past its limit" );
+}
+
+// Large strings fill this thread's lists by their bytes long before any list reaches MAX_FREE entries
+static void free_bytes_limit()
+{
+  const size_t most = PacketPool::MAX_FREE_BYTES / PacketPool::MAX_CAPACITY;
+  vector<string> taken;
+  for ( size_t i = 0; i < most + 10; ++i ) {
+    taken.push_back( PacketPool::take( PacketPool::MAX_CAPACITY ) );
+  }
+  PacketPool::reset_stats();
+  for ( auto& str : taken ) {
+    PacketPool::recycle( move( str ) );
+  }
+  expect( PacketPool::stats().recycled <= most and PacketPool::stats().released >= 10,
+          "free lists grew past their byte limit" );
+
+  // ...and taking a string back out makes room for it again
+  PacketPool::reset_stats();
+  PacketPool::recycle( PacketPool::take( PacketPool::MAX_CAPACITY ) );
+  expect( PacketPool::stats().reused == 1 and PacketPool::stats().recycled == 1,
+          "string taken from the free lists not counted out of them" );
+}
+
+// Each thread has its own pool, and a Buffer can be released on another thread than it was made on
+static void threads()
+{
+  PacketPool::reset_stats();
+  vector<Buffer> made;
+  size_t allocated_there = 0;
+  thread maker { [&] {
+    for ( size_t i = 0; i < 1000; ++i ) {
+      made.emplace_back( string( 200, 'z' ) );
+    }
+    allocated_there = PacketPool::stats().allocated;
+  } };
+  maker.join();
+  expect( allocated_there > 0 and PacketPool::stats().allocated == 0, "threads share counts" );
+
+  made.clear();
+  expect( PacketPool::stats().recycled > 0, "released Buffers not recycled on this thread" );
+}
+
+int main()
+{
+  try {
+    strings();
+    buffers();
+    free_list_limit();
+    free_bytes_limit();
+    threads();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
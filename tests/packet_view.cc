@@ -0,0 +1,117 @@
+#include "ipv4_datagram.hh"
+#include "packet_view.hh"
+#include "tcp_segment.hh"
+#include "test_helpers.hh"
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// The bytes of a TCP segment in an IPv4 datagram
+static string make_datagram()
+{
+  TCPSegment seg;
+  seg.udinfo.src_port = 40000;
+  seg.udinfo.dst_port = 80;
+  seg.sender_message.payload = string { "hello" };
+
+  InternetDatagram dgram;
+  dgram.header.ttl = 9;
+  dgram.header.id = 0x1234;
+  dgram.header.src = 0x0a000001;
+  dgram.header.dst = 0xc0a80102;
+  dgram.header.len = IPv4Header::LENGTH + 20 + 5;
+  dgram.header.compute_checksum();
+  seg.compute_checksum( dgram.header.pseudo_checksum() );
+  dgram.payload = serialize( seg );
+  return concatenate( serialize( dgram ) );
+}
+
+static void accessors()
+{
+  const string bytes = make_datagram();
+  expect( ConstIPv4View::valid( bytes ), "good datagram rejected" );
+
+  const ConstIPv4View view { bytes.data(), bytes.size() };
+  expect( view.ttl() == 9 and view.proto() == IPv4Header::PROTO_TCP and view.header_length() == 20,
+          "header fields misread" );
+  expect( view.src() == 0x0a000001 and view.dst() == 0xc0a80102, "addresses misread" );
+  expect( view.has_ports() and view.src_port() == 40000 and view.dst_port() == 80, "ports misread" );
+
+  string fragment_bytes = bytes;
+  IPv4View fragment { fragment_bytes.data(), fragment_bytes.size() };
+  IPv4HeaderLayout::field<"offset">::set( fragment_bytes.data(), 100 );
+  expect( not fragment.has_ports(), "a later fragment has ports" );
+  expect( IPv4HeaderLayout::field<"df">::get( fragment_bytes.data() ), "setting a field changed its neighbour" );
+}
+
+static void validity()
+{
+  const string bytes = make_datagram();
+
+  string wrong_version = bytes;
+  wrong_version[0] = 0x65;
+  string wrong_checksum = bytes;
+  wrong_checksum[8] = 10; // (the TTL)
+  string long_header = bytes.substr( 0, 24 );
+  long_header[0] = 0x47;
+
+  expect( not ConstIPv4View::valid( wrong_version ), "IPv6 version accepted" );
+  expect( not ConstIPv4View::valid( wrong_checksum ), "bad checksum accepted" );
+  expect( not ConstIPv4View::valid( bytes.substr( 0, 19 ) ), "truncated header accepted" );
+  expect( not ConstIPv4View::valid( long_header ), "header longer than the datagram accepted" );
+}
+
+// Decrementing the TTL in place gives the same bytes as decoding, decrementing and re-encoding
+static void decrement_ttl()
+{
+  const string bytes = make_datagram();
+  InternetDatagram expected;
+  expect( parse( expected, { Buffer { bytes } } ), "datagram does not parse" );
+  expected.header.ttl--;
+  expected.header.compute_checksum();
+
+  string modified = bytes;
+  IPv4View view { modified.data(), modified.size() };
+  view.decrement_ttl();
+  expect( modified == concatenate( serialize( expected ) ), "TTL decremented differently in place" );
+  expect( ConstIPv4View::valid( modified ), "checksum wrong after decrementing the TTL" );
+}
+
+// Writing to a Buffer's bytes copies them first only if another Buffer shares them
+static void writable_buffers()
+{
+  Buffer original { make_datagram() };
+  const char* memory = original.data();
+  expect( original.mutable_data() == memory, "unshared Buffer copied before writing" );
+
+  const Buffer shared = original;
+  char* writable = original.mutable_data();
+  expect( writable != memory and shared.data() == memory, "shared Buffer written in place" );
+  IPv4View { writable, original.size() }.decrement_ttl();
+  expect( ConstIPv4View { shared.data(), shared.size() }.ttl() == 9
+            and ConstIPv4View { original.data(), original.size() }.ttl() == 8,
+          "a write showed through to another Buffer" );
+
+  Buffer slice = original.substr( 20 );
+  original = Buffer {};
+  expect( slice.mutable_data() == slice.data(), "slice that is the only reference copied" );
+}
+
+int main()
+{
+  try {
+    accessors();
+    validity();
+    decrement_ttl();
+    writable_buffers();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,124 @@
+#include "ethernet_frame.hh"
+#include "ipv4_datagram.hh"
+#include "tcp_segment.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+// An Ethernet frame carrying a TCP segment (with `payload_length` bytes of payload) in an IPv4 datagram
+static string make_frame( default_random_engine& rd, const size_t payload_length )
+{
+  uniform_int_distribution<uint32_t> ud;
+
+  TCPSegment seg;
+  seg.udinfo.src_port = static_cast<uint16_t>( ud( rd ) );
+  seg.udinfo.dst_port = static_cast<uint16_t>( ud( rd ) );
+  seg.sender_message.seqno = Wrap32 { ud( rd ) };
+  seg.receiver_message.ackno = Wrap32 { ud( rd ) };
+  seg.receiver_message.window_size = static_cast<uint16_t>( ud( rd ) );
+  seg.sender_message.payload = string( payload_length, 'x' );
+
+  InternetDatagram dgram;
+  dgram.header.src = ud( rd );
+  dgram.header.dst = ud( rd );
+  dgram.header.proto = IPv4Header::PROTO_TCP;
+  dgram.header.len = IPv4Header::LENGTH + 20 + payload_length;
+  dgram.header.compute_checksum();
+  seg.compute_checksum( dgram.header.pseudo_checksum() );
+  dgram.payload = serialize( seg );
+
+  EthernetFrame frame;
+  frame.header.type = EthernetHeader::TYPE_IPv4;
+  frame.payload = serialize( dgram );
+
+  string bytes;
+  for ( const auto& buf : serialize( frame ) ) {
+    bytes.append( buf );
+  }
+  return bytes;
+}
+
+// Parse every frame down to its TCP segment `rounds` times, returning nanoseconds per frame
+static double speed_test( const vector<vector<Buffer>>& frames, const size_t rounds )
+{
+  size_t payload_bytes = 0;
+  const auto start_time = steady_clock::now();
+  for ( size_t round = 0; round < rounds; ++round ) {
+    for ( const auto& input : frames ) {
+      EthernetFrame frame;
+      InternetDatagram dgram;
+      TCPSegment seg;
+      if ( not parse( frame, input ) or not parse( dgram, frame.payload )
+           or not parse( seg, dgram.payload, dgram.header.pseudo_checksum() ) ) {
+        throw runtime_error( "failed to parse a frame" );
+      }
+      payload_bytes += seg.sender_message.payload.size();
+    }
+  }
+  const auto stop_time = steady_clock::now();
+
+  if ( payload_bytes == 0 ) {
+    throw runtime_error( "parsed no payload" );
+  }
+
+  const auto test_duration = duration_cast<duration<double, nano>>( stop_time - start_time );
+  return test_duration.count() / static_cast<double>( frames.size() * rounds );
+}
+
+void program_body()
+{
+  constexpr size_t num_frames = 1000;
+  constexpr size_t rounds = 500;
+  constexpr size_t headers_length = EthernetHeader::LENGTH + IPv4Header::LENGTH + 20;
+
+  default_random_engine rd { 791 };
+  uniform_int_distribution<size_t> length_dist { 0, 100 };
+  vector<vector<Buffer>> contiguous;
+  vector<vector<Buffer>> split;
+  for ( size_t i = 0; i < num_frames; ++i ) {
+    const string bytes = make_frame( rd, length_dist( rd ) );
+    contiguous.push_back( { Buffer { bytes } } );
+
+    // the same frame, with every header split between 3-byte buffers (the byte-at-a-time fallback)
+    vector<Buffer> pieces;
+    size_t offset = 0;
+    for ( ; offset < headers_length; offset += 3 ) {
+      pieces.emplace_back( bytes.substr( offset, 3 ) );
+    }
+    pieces.emplace_back( bytes.substr( offset ) );
+    split.push_back( move( pieces ) );
+  }
+
+  const double contiguous_ns = speed_test( contiguous, rounds );
+  const double split_ns = speed_test( split, rounds );
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  cout << "Parsing Ethernet/IPv4/TCP: " << fixed << setprecision( 1 ) << contiguous_ns
+       << " ns per frame from one buffer; " << split_ns << " ns with the headers split between buffers.\n";
+
+  debug_output << "    Ethernet/IPv4/TCP parse: " << fixed << setprecision( 1 ) << contiguous_ns << " ns ("
+               << split_ns << " ns split)\n";
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,131 @@
+#include "prefix_trie.hh"
+
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+using namespace std;
+
+using Prefix = pair<uint32_t, uint8_t>;
+
+static uint32_t mask( const uint8_t length )
+{
+  return length == 0 ? 0 : 0xffffffff << ( 32 - length );
+}
+
+// The longest matching prefix, found by trying every length
+static const size_t* reference_lookup( const map<Prefix, size_t>& routes, const uint32_t address )
+{
+  for ( int length = 32; length >= 0; --length ) {
+    const auto it = routes.find( { address & mask( length ), length } );
+    if ( it != routes.end() ) {
+      return &it->second;
+    }
+  }
+  return nullptr;
+}
+
+static void check_lookups( const PrefixTrie<size_t>& trie,
+                           const map<Prefix, size_t>& routes,
+                           default_random_engine& rd )
+{
+  if ( trie.size() != routes.size() ) {
+    throw runtime_error( "trie has " + to_string( trie.size() ) + " prefixes, expected "
+                         + to_string( routes.size() ) );
+  }
+
+  uniform_int_distribution<uint32_t> address_dist;
+  for ( size_t i = 0; i < 2000; ++i ) {
+    // probe random addresses and addresses inside (or just past) the prefixes
+    uint32_t address = address_dist( rd );
+    if ( i % 2 and not routes.empty() ) {
+      auto it = routes.begin();
+      advance( it, address_dist( rd ) % routes.size() );
+      address = it->first.first | ( address & ~mask( it->first.second ) );
+    }
+
+    const size_t* expected = reference_lookup( routes, address );
+    const size_t* actual = trie.lookup( address );
+    if ( ( expected == nullptr ) != ( actual == nullptr ) or ( expected and *expected != *actual ) ) {
+      throw runtime_error( "lookup of " + to_string( address ) + " found "
+                           + ( actual ? to_string( *actual ) : "nothing" ) + ", expected "
+                           + ( expected ? to_string( *expected ) : "nothing" ) );
+    }
+  }
+}
+
+int main()
+{
+  try {
+    default_random_engine rd { 32 };
+    // prefixes are drawn from a few clusters so that they nest and share branches
+    uniform_int_distribution<uint32_t> address_dist;
+    uniform_int_distribution<uint32_t> cluster_dist { 0, 3 };
+    uniform_int_distribution<int> length_dist { 0, 32 };
+
+    PrefixTrie<size_t> trie;
+    map<Prefix, size_t> routes;
+    const auto random_prefix = [&] {
+      const uint8_t length = length_dist( rd );
+      const uint32_t address = ( cluster_dist( rd ) << 28 ) | ( address_dist( rd ) >> 4 );
+      return Prefix { address & mask( length ), length };
+    };
+
+    for ( size_t round = 0; round < 20; ++round ) {
+      // insert (some prefixes again, which keeps their first value)...
+      for ( size_t i = 0; i < 300; ++i ) {
+        const Prefix prefix = random_prefix();
+        const size_t value = round * 1000 + i;
+        const bool inserted
+          = trie.insert( prefix.first | ( address_dist( rd ) & ~mask( prefix.second ) ), prefix.second, value );
+        if ( inserted != routes.emplace( prefix, value ).second ) {
+          throw runtime_error( "insert disagreed about whether the prefix was new" );
+        }
+      }
+      check_lookups( trie, routes, rd );
+
+      // ...then erase about half of them, and some prefixes that are not there
+      for ( auto it = routes.begin(); it != routes.end(); ) {
+        const size_t* found = trie.find( it->first.first, it->first.second );
+        if ( found == nullptr or *found != it->second ) {
+          throw runtime_error( "find did not find a prefix's value" );
+        }
+        if ( address_dist( rd ) % 2 ) {
+          if ( not trie.erase( it->first.first, it->first.second ) ) {
+            throw runtime_error( "erase did not find a prefix" );
+          }
+          it = routes.erase( it );
+        } else {
+          ++it;
+        }
+      }
+      for ( size_t i = 0; i < 100; ++i ) {
+        const Prefix prefix = random_prefix();
+        if ( ( trie.find( prefix.first, prefix.second ) != nullptr ) != routes.contains( prefix ) ) {
+          throw runtime_error( "find of a random prefix disagreed" );
+        }
+        if ( trie.erase( prefix.first, prefix.second ) != routes.contains( prefix ) ) {
+          throw runtime_error( "erase of an absent prefix disagreed" );
+        }
+        routes.erase( prefix );
+      }
+      check_lookups( trie, routes, rd );
+    }
+
+    // erasing everything leaves nothing to match
+    for ( const auto& [prefix, value] : routes ) {
+      trie.erase( prefix.first, prefix.second );
+    }
+    routes.clear();
+    check_lookups( trie, routes, rd );
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
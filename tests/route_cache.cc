@@ -0,0 +1,61 @@
+#include "route_cache.hh"
+#include "test_helpers.hh"
+
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    RouteCache<int> cache { 4 };
+    expect( cache.capacity() == 4 * RouteCache<int>::WAYS, "wrong capacity" );
+
+    // misses, then hits once filled
+    expect( not cache.lookup( 0x0a000001 ), "empty cache hit" );
+    cache.insert( 0x0a000001, 7 );
+    cache.insert( 0x0a000002, 0 );
+    expect( cache.lookup( 0x0a000001 ) == 7, "missing entry" );
+    expect( cache.lookup( 0x0a000002 ) == 0, "missing entry with a default value" );
+    expect( not cache.lookup( 0x0a000003 ), "hit for an address never inserted" );
+    expect( cache.hits() == 2 and cache.misses() == 2, "wrong hit/miss counts" );
+
+    // invalidation forgets everything at once
+    cache.invalidate();
+    expect( not cache.lookup( 0x0a000001 ), "hit after invalidation" );
+    cache.insert( 0x0a000001, 8 );
+    expect( cache.lookup( 0x0a000001 ) == 8, "stale value after invalidation" );
+
+    // once the cache is full, each new address evicts exactly one older entry
+    RouteCache<int> small { 2 };
+    const uint32_t count = small.capacity() + 1;
+    for ( uint32_t address = 1; address <= count; ++address ) {
+      small.insert( address, static_cast<int>( address ) );
+    }
+    size_t cached = 0;
+    for ( uint32_t address = count; address >= 1; --address ) {
+      const auto value = small.lookup( address );
+      expect( not value or value == static_cast<int>( address ), "wrong value after eviction" );
+      cached += value.has_value();
+    }
+    expect( cached == small.capacity(), "expected exactly one eviction, found " + to_string( count - cached ) );
+    expect( small.lookup( count ) == static_cast<int>( count ), "the newest entry was evicted" );
+
+    bool threw = false;
+    try {
+      RouteCache<int> bad { 3 };
+    } catch ( const invalid_argument& ) {
+      threw = true;
+    }
+    expect( threw, "non-power-of-two size accepted" );
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,115 @@
+#include "prefix_trie.hh"
+#include "route_cache.hh"
+#include "router.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+// `count` destinations drawn from `num_hosts` hosts, where the k-th most popular host is picked with
+// probability proportional to 1/k^exponent (a Zipf distribution, as seen in real traffic mixes)
+static vector<uint32_t> zipf_destinations( const size_t count,
+                                           const size_t num_hosts,
+                                           const double exponent,
+                                           default_random_engine& rd )
+{
+  uniform_int_distribution<uint32_t> address_dist;
+  vector<uint32_t> hosts( num_hosts );
+  vector<double> cumulative( num_hosts );
+  double total = 0;
+  for ( size_t k = 0; k < num_hosts; ++k ) {
+    hosts[k] = address_dist( rd );
+    total += 1.0 / pow( static_cast<double>( k + 1 ), exponent );
+    cumulative[k] = total;
+  }
+
+  uniform_real_distribution<double> uniform { 0, total };
+  vector<uint32_t> destinations( count );
+  for ( auto& destination : destinations ) {
+    const auto it = lower_bound( cumulative.begin(), cumulative.end(), uniform( rd ) );
+    destination = hosts[min<size_t>( it - cumulative.begin(), num_hosts - 1 )];
+  }
+  return destinations;
+}
+
+void program_body()
+{
+  constexpr size_t num_prefixes = 500'000;
+  constexpr size_t num_hosts = 100'000;
+  constexpr size_t num_lookups = 4'000'000;
+
+  default_random_engine rd { 34 };
+  uniform_int_distribution<uint32_t> address_dist;
+  uniform_int_distribution<int> length_dist { 8, 24 };
+  PrefixTrie<RouterRule> trie;
+  for ( size_t i = 0; i < num_prefixes; ++i ) {
+    const auto length = static_cast<uint8_t>( length_dist( rd ) );
+    const uint32_t prefix = address_dist( rd ) & ( 0xffffffff << ( 32 - length ) );
+    trie.insert( prefix, length, RouterRule { prefix, length, nullopt, i % 8 } );
+  }
+
+  const vector<uint32_t> destinations = zipf_destinations( num_lookups, num_hosts, 1.0, rd );
+
+  size_t found = 0;
+  const auto trie_start = steady_clock::now();
+  for ( const uint32_t destination : destinations ) {
+    const RouterRule* rule = trie.lookup( destination );
+    found += rule != nullptr ? rule->interface_num() + 1 : 0;
+  }
+  const auto trie_stop = steady_clock::now();
+
+  size_t found_cached = 0;
+  RouteCache<const RouterRule*> cache;
+  const auto cache_start = steady_clock::now();
+  for ( const uint32_t destination : destinations ) {
+    const RouterRule* rule = nullptr;
+    if ( const auto cached = cache.lookup( destination ) ) {
+      rule = cached.value();
+    } else {
+      rule = trie.lookup( destination );
+      cache.insert( destination, rule );
+    }
+    found_cached += rule != nullptr ? rule->interface_num() + 1 : 0;
+  }
+  const auto cache_stop = steady_clock::now();
+
+  if ( found == 0 or found != found_cached ) {
+    throw runtime_error( "cached lookups disagree with the trie" );
+  }
+
+  const double trie_rate = num_lookups / duration_cast<duration<double>>( trie_stop - trie_start ).count();
+  const double cache_rate = num_lookups / duration_cast<duration<double>>( cache_stop - cache_start ).count();
+  const double hit_rate = 100.0 * static_cast<double>( cache.hits() ) / num_lookups;
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  cout << "Route lookup among " << num_prefixes << " prefixes, Zipf destinations over " << num_hosts
+       << " hosts: trie " << fixed << setprecision( 0 ) << trie_rate << " lookups/s; with a " << cache.capacity()
+       << "-entry route cache " << cache_rate << " lookups/s (" << setprecision( 1 ) << hit_rate
+       << "% hits).\n";
+
+  debug_output << "              Route cache: " << fixed << setprecision( 0 ) << trie_rate << " -> " << cache_rate
+               << " lookups/s (" << setprecision( 1 ) << hit_rate << "% hits)\n";
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,135 @@
+#include "dir_24_8.hh"
+#include "prefix_trie.hh"
+#include "router.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+// A table shaped roughly like a BGP table: mostly /24s, the rest spread over /8 to /23
+static vector<RouterRule> random_table( const size_t num_prefixes, default_random_engine& rd )
+{
+  uniform_int_distribution<uint32_t> address_dist;
+  uniform_int_distribution<int> length_dist { 8, 23 };
+  uniform_int_distribution<size_t> interface_dist { 0, 7 };
+  vector<RouterRule> rules;
+  for ( size_t i = 0; i < num_prefixes; ++i ) {
+    const auto length = static_cast<uint8_t>( i % 5 < 3 ? 24 : length_dist( rd ) );
+    const uint32_t prefix = address_dist( rd ) & ( 0xffffffff << ( 32 - length ) );
+    rules.emplace_back( prefix, length, nullopt, interface_dist( rd ) );
+  }
+  return rules;
+}
+
+// The search that Router::route used to do: try every rule and keep the longest match
+static const RouterRule* linear_lookup( const vector<RouterRule>& rules, const uint32_t address )
+{
+  const RouterRule* best = nullptr;
+  for ( const auto& rule : rules ) {
+    if ( rule.is_match( address ) and ( best == nullptr or rule.prefix_length() > best->prefix_length() ) ) {
+      best = &rule;
+    }
+  }
+  return best;
+}
+
+void program_body()
+{
+  constexpr size_t num_prefixes = 500'000;
+  constexpr size_t num_linear_lookups = 200;
+  constexpr size_t num_fast_lookups = 5'000'000;
+
+  default_random_engine rd { 500 };
+  const vector<RouterRule> rules = random_table( num_prefixes, rd );
+  uniform_int_distribution<uint32_t> address_dist;
+  vector<uint32_t> addresses( 1 << 16 );
+  for ( auto& address : addresses ) {
+    address = address_dist( rd );
+  }
+
+  const auto build_start = steady_clock::now();
+  PrefixTrie<RouterRule> trie;
+  for ( const auto& rule : rules ) {
+    trie.insert( rule.route_prefix(), rule.prefix_length(), rule );
+  }
+  const auto build_stop = steady_clock::now();
+
+  // (the table takes distinct prefixes: of two random rules for one prefix, the trie kept the first)
+  vector<Dir24_8Table::Route> flat_routes;
+  trie.for_each( [&]( const uint32_t prefix, const uint8_t length, const RouterRule& rule ) {
+    flat_routes.push_back( { prefix, length, static_cast<uint16_t>( rule.interface_num() + 1 ) } );
+  } );
+  const auto flat_build_start = steady_clock::now();
+  const Dir24_8Table flat { flat_routes };
+  const auto flat_build_stop = steady_clock::now();
+
+  // Both lookups must find rules with the same prefix (duplicates in the table may differ in interface)
+  const auto linear_start = steady_clock::now();
+  for ( size_t i = 0; i < num_linear_lookups; ++i ) {
+    const RouterRule* expected = linear_lookup( rules, addresses[i] );
+    const RouterRule* actual = trie.lookup( addresses[i] );
+    if ( ( expected == nullptr ) != ( actual == nullptr )
+         or ( expected and expected->prefix_length() != actual->prefix_length() ) ) {
+      throw runtime_error( "trie and linear scan disagree" );
+    }
+    if ( flat.lookup( addresses[i] ) != ( actual ? actual->interface_num() + 1 : Dir24_8Table::NO_ROUTE ) ) {
+      throw runtime_error( "DIR-24-8 table and trie disagree" );
+    }
+  }
+  const auto linear_stop = steady_clock::now();
+
+  size_t found = 0;
+  const auto trie_start = steady_clock::now();
+  for ( size_t i = 0; i < num_fast_lookups; ++i ) {
+    const RouterRule* rule = trie.lookup( addresses[i % addresses.size()] );
+    found += rule != nullptr ? rule->interface_num() + 1 : 0;
+  }
+  const auto trie_stop = steady_clock::now();
+
+  const auto flat_start = steady_clock::now();
+  for ( size_t i = 0; i < num_fast_lookups; ++i ) {
+    found += flat.lookup( addresses[i % addresses.size()] );
+  }
+  const auto flat_stop = steady_clock::now();
+
+  if ( found == 0 ) {
+    throw runtime_error( "no lookups matched" );
+  }
+
+  const double build_seconds = duration_cast<duration<double>>( build_stop - build_start ).count();
+  const double linear_rate
+    = num_linear_lookups / duration_cast<duration<double>>( linear_stop - linear_start ).count();
+  const double trie_rate = num_fast_lookups / duration_cast<duration<double>>( trie_stop - trie_start ).count();
+  const double flat_build_seconds = duration_cast<duration<double>>( flat_build_stop - flat_build_start ).count();
+  const double flat_rate = num_fast_lookups / duration_cast<duration<double>>( flat_stop - flat_start ).count();
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  cout << "Route lookup among " << num_prefixes << " prefixes: linear scan " << fixed << setprecision( 0 )
+       << linear_rate << " lookups/s; trie " << trie_rate << " lookups/s (" << setprecision( 2 ) << build_seconds
+       << " s to build); DIR-24-8 " << setprecision( 0 ) << flat_rate << " lookups/s (" << setprecision( 2 )
+       << flat_build_seconds << " s to build).\n";
+
+  debug_output << "             Route lookup: " << fixed << setprecision( 0 ) << linear_rate << " -> " << trie_rate
+               << " (trie) / " << flat_rate << " (DIR-24-8) lookups/s\n";
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
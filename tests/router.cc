@@ -173,7 +173,7 @@ private:
   }
 
 public:
-  Network()
+  explicit Network( const bool flat_table )
     : default_id( _router.add_interface( { random_router_ethernet_address(), Address { "171.67.76.46" } } ) )
     , eth0_id( _router.add_interface( { random_router_ethernet_address(), Address { "10.0.0.1" } } ) )
     , eth1_id( _router.add_interface( { random_router_ethernet_address(), Address { "172.16.0.1" } } ) )
@@ -198,6 +198,11 @@ public:
     _router.add_route( ip( "143.195.128.0" ), 18, host( "hs_router" ).address(), hs4_id );
     _router.add_route( ip( "143.195.192.0" ), 19, host( "hs_router" ).address(), hs4_id );
     _router.add_route( ip( "128.30.76.255" ), 16, Address { "128.30.0.1" }, mit5_id );
+
+    _router.use_flat_table( flat_table );
+    if ( flat_table ) {
+      _router.wait_for_flat_table();
+    }
   }
 
   void simulate_physical_connections()
@@ -240,14 +245,15 @@ public:
   }
 };
 
-void network_simulator()
+void network_simulator( const bool flat_table )
 {
   const string green = "\033[32;1m";
   const string normal = "\033[m";
 
-  cerr << green << "Constructing network." << normal << "\n";
+  cerr << green << "Constructing network" << ( flat_table ? " (with a DIR-24-8 route table)." : "." ) << normal
+       << "\n";
 
-  Network network;
+  Network network { flat_table };
 
   cout << green << "\n\nTesting traffic between two ordinary hosts (applesauce to cherrypie)..." << normal
        << "\n\n";
@@ -329,7 +335,8 @@ void network_simulator()
 int main()
 {
   try {
-    network_simulator();
+    network_simulator( false );
+    network_simulator( true );
   } catch ( const exception& e ) {
     cerr << "\n\n\n";
     cerr << "\033[31;1mError: " << e.what() << "\033[m\n";
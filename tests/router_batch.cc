@@ -0,0 +1,95 @@
+#include "router.hh"
+#include "router_fixture.hh"
+#include "test_helpers.hh"
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+int main()
+{
+  try {
+    // Two neighbors send to hosts behind a third
+    Router router;
+    vector<NetworkInterface> neighbors;
+    for ( size_t i = 0; i < 3; ++i ) {
+      router.add_interface( AsyncNetworkInterface { ethernet_address( 1, i ), interface_address( 1, i ) } );
+      neighbors.emplace_back( ethernet_address( 2, i ), interface_address( 2, i ) );
+    }
+    router.add_route( 0x0b000000, 8, interface_address( 2, 2 ), 2 );
+    router.set_max_batch( 8 );
+
+    // Resolve the Ethernet addresses first, so that forwarded datagrams are sent right away
+    for ( size_t i = 0; i < 2; ++i ) {
+      neighbors[i].send_datagram( make_datagram( interface_address( 2, i ).ipv4_numeric(), 0x0b000001, "warm-up" ),
+                                  interface_address( 1, i ) );
+      deliver( neighbors[i], router.interface( i ) );
+      deliver( router.interface( i ), neighbors[i] );
+      deliver( neighbors[i], router.interface( i ) );
+    }
+    router.route();
+    deliver( router.interface( 2 ), neighbors[2] );
+    deliver( neighbors[2], router.interface( 2 ) );
+    deliver( router.interface( 2 ), neighbors[2] );
+    expect( not router.interface( 2 ).maybe_send(), "warm-up left frames unsent" );
+
+    // A burst of 100 datagrams on one interface and 10 on the other (plus one that has run out of hops)...
+    for ( size_t n = 0; n < 100; ++n ) {
+      string payload = "a";
+      payload += to_string( n );
+      neighbors[0].send_datagram( make_datagram( interface_address( 2, 0 ).ipv4_numeric(), 0x0b000001, payload ),
+                                  interface_address( 1, 0 ) );
+    }
+    for ( size_t n = 0; n < 10; ++n ) {
+      string payload = "b";
+      payload += to_string( n );
+      neighbors[1].send_datagram( make_datagram( interface_address( 2, 1 ).ipv4_numeric(), 0x0b000001, payload ),
+                                  interface_address( 1, 1 ) );
+    }
+    neighbors[1].send_datagram( make_datagram( interface_address( 2, 1 ).ipv4_numeric(), 0x0b000001, "expired", 1 ),
+                                interface_address( 1, 1 ) );
+    deliver( neighbors[0], router.interface( 0 ) );
+    deliver( neighbors[1], router.interface( 1 ) );
+    expect( router.interface( 0 ).datagrams_waiting() == 100,
+            "burst not queued at the router: " + to_string( router.interface( 0 ).datagrams_waiting() ) );
+
+    // ...is all forwarded by one call to route()
+    router.route();
+    expect( router.interface( 0 ).datagrams_waiting() == 0 and router.interface( 1 ).datagrams_waiting() == 0,
+            "route() left datagrams queued" );
+
+    vector<string> forwarded;
+    while ( auto frame = router.interface( 2 ).maybe_send() ) {
+      InternetDatagram dgram;
+      expect( parse( dgram, frame->payload ), "router sent an unparseable datagram" );
+      expect( dgram.header.ttl == 63, "TTL not decremented" );
+      forwarded.emplace_back( dgram.payload.front() );
+    }
+    expect( forwarded.size() == 110, "router forwarded " + to_string( forwarded.size() ) + " datagrams" );
+
+    // The interfaces took turns, a batch of 8 at a time, so the quiet interface's datagrams were not stuck
+    // behind the whole burst; and each interface's datagrams kept their order
+    size_t next_a = 0;
+    size_t next_b = 0;
+    for ( size_t n = 0; n < forwarded.size(); ++n ) {
+      size_t& next = forwarded[n][0] == 'a' ? next_a : next_b;
+      expect( forwarded[n].substr( 1 ) == to_string( next++ ), "datagram " + forwarded[n] + " out of order" );
+      if ( n % 8 == 7 and n < 16 ) {
+        expect( n == 7 ? ( next_a == 8 ) != ( next_b == 8 ) : next_a == 8 and next_b == 8,
+                "interfaces did not alternate in batches of 8" );
+      }
+    }
+    expect( find( forwarded.begin(), forwarded.end(), "b9" ) - forwarded.begin() <= 8 + 8 + 8 + 1,
+            "the quiet interface waited for more than a batch" );
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
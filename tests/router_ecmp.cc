@@ -0,0 +1,253 @@
+#include "router.hh"
+#include "router_fixture.hh"
+#include "test_helpers.hh"
+
+#include <cstddef>
+#include <iostream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static constexpr size_t num_paths = 4;
+
+struct Flow
+{
+  uint32_t src {};
+  uint32_t dst {};
+  uint16_t src_port {};
+  uint16_t dst_port {};
+};
+
+// A frame for the router's interface 0, holding a TCP datagram of `flow` whose payload is `tag`
+static EthernetFrame make_frame( const Flow& flow, const string& tag )
+{
+  string payload;
+  for ( const uint16_t port : { flow.src_port, flow.dst_port } ) {
+    payload.push_back( static_cast<char>( port >> 8 ) );
+    payload.push_back( static_cast<char>( port ) );
+  }
+  payload.append( 16, 0 ); // (the rest of the TCP header)
+  payload.append( tag );
+
+  InternetDatagram dgram;
+  dgram.header.src = flow.src;
+  dgram.header.dst = flow.dst;
+  dgram.header.len = IPv4Header::LENGTH + payload.size();
+  dgram.header.proto = IPv4Header::PROTO_TCP;
+  dgram.header.ttl = 64;
+  dgram.header.compute_checksum();
+  dgram.payload.emplace_back( payload );
+
+  return { { ethernet_address( 1, 0 ), ethernet_address( 2, 0 ), EthernetHeader::TYPE_IPv4 }, serialize( dgram ) };
+}
+
+// Route `rounds` datagrams of each flow, returning the tags that arrived behind each path
+static vector<vector<string>> send_flows( Router& router,
+                                          vector<NetworkInterface>& neighbors,
+                                          const vector<Flow>& flows,
+                                          const size_t rounds )
+{
+  vector<vector<string>> received( num_paths );
+  for ( size_t round = 0; round < rounds; ++round ) {
+    for ( size_t n = 0; n < flows.size(); ++n ) {
+      router.interface( 0 ).recv_frame( make_frame( flows[n], to_string( n ) + ":" + to_string( round ) ) );
+    }
+    router.route();
+
+    // Resolve Ethernet addresses as needed, and collect the datagrams from each path
+    for ( size_t p = 0; p < num_paths; ++p ) {
+      auto& interface = router.interface( p + 1 );
+      bool moved = true;
+      while ( moved ) {
+        moved = false;
+        while ( auto frame = interface.maybe_send() ) {
+          if ( auto dgram = neighbors[p].recv_frame( frame.value() ) ) {
+            const string payload = dgram->payload.front();
+            received[p].push_back( payload.substr( 20 ) );
+          }
+          moved = true;
+        }
+        while ( auto frame = neighbors[p].maybe_send() ) {
+          interface.recv_frame( frame.value() );
+          moved = true;
+        }
+      }
+    }
+  }
+  return received;
+}
+
+// Check that every datagram arrived, each flow took one path in order, and path p carried close to
+// share[p] of the flows
+static void check_distribution( const vector<vector<string>>& received,
+                                const size_t num_flows,
+                                const size_t rounds,
+                                const vector<double>& share )
+{
+  map<size_t, size_t> path_of_flow;
+  map<size_t, size_t> next_round;
+  for ( size_t p = 0; p < num_paths; ++p ) {
+    for ( const string& tag : received[p] ) {
+      const size_t flow = stoul( tag.substr( 0, tag.find( ':' ) ) );
+      const auto [it, first] = path_of_flow.try_emplace( flow, p );
+      expect( it->second == p, "flow " + to_string( flow ) + " took more than one path" );
+      expect( tag.substr( tag.find( ':' ) + 1 ) == to_string( next_round[flow]++ ), "flow reordered" );
+    }
+  }
+  expect( path_of_flow.size() == num_flows, "flows missing" );
+
+  for ( size_t p = 0; p < num_paths; ++p ) {
+    const double flows_on_path = static_cast<double>( received[p].size() ) / static_cast<double>( rounds );
+    const double expected = share[p] * static_cast<double>( num_flows );
+    expect( flows_on_path > expected * 0.9 and flows_on_path < expected * 1.1,
+            "path " + to_string( p ) + " carried " + to_string( flows_on_path ) + " flows, expected about "
+              + to_string( expected ) );
+  }
+}
+
+static void test_ecmp( const bool flat_table )
+{
+  // Interface 0 faces the hosts; interfaces 1 to 4 are parallel links toward 11.0.0.0/8
+  Router router;
+  vector<NetworkInterface> neighbors;
+  router.add_interface( AsyncNetworkInterface { ethernet_address( 1, 0 ), interface_address( 1, 0 ) } );
+  for ( size_t p = 0; p < num_paths; ++p ) {
+    router.add_interface( AsyncNetworkInterface { ethernet_address( 1, p + 1 ), interface_address( 1, p + 1 ) } );
+    neighbors.emplace_back( ethernet_address( 2, p + 1 ), interface_address( 2, p + 1 ) );
+  }
+  router.use_flat_table( flat_table );
+
+  // Let the router learn each neighbor's Ethernet address (from its ARP request), so that no datagram
+  // has to wait for one
+  for ( size_t p = 0; p < num_paths; ++p ) {
+    neighbors[p].send_datagram( InternetDatagram {}, interface_address( 1, p + 1 ) );
+    router.interface( p + 1 ).recv_frame( neighbors[p].maybe_send().value() );
+    neighbors[p].recv_frame( router.interface( p + 1 ).maybe_send().value() );
+    neighbors[p].maybe_send(); // (the datagram itself is not needed)
+  }
+
+  vector<RouterRule::NextHop> paths;
+  for ( size_t p = 0; p < num_paths; ++p ) {
+    paths.push_back( { interface_address( 2, p + 1 ), p + 1, 1 } );
+  }
+  router.add_route( 11U << 24, 8, paths );
+
+  // Flows from many hosts and ports to a few servers
+  constexpr size_t num_flows = 4000;
+  constexpr size_t rounds = 3;
+  default_random_engine rd { 37 };
+  uniform_int_distribution<uint32_t> host_dist { 0, 255 };
+  uniform_int_distribution<uint16_t> port_dist { 1024, 65535 };
+  vector<Flow> flows;
+  for ( size_t n = 0; n < num_flows; ++n ) {
+    const uint32_t client = ( 10U << 24 ) | host_dist( rd );
+    const uint32_t server = ( 11U << 24 ) | host_dist( rd ) % 4;
+    flows.push_back( { client, server, port_dist( rd ), 443 } );
+  }
+
+  check_distribution(
+    send_flows( router, neighbors, flows, rounds ), num_flows, rounds, { 0.25, 0.25, 0.25, 0.25 } );
+
+  // A second route for the same prefix is ignored: the first one added wins
+  paths[3].weight = 3;
+  router.add_route( 11U << 24, 8, paths );
+  if ( flat_table ) {
+    router.wait_for_flat_table();
+  }
+  check_distribution(
+    send_flows( router, neighbors, flows, rounds ), num_flows, rounds, { 0.25, 0.25, 0.25, 0.25 } );
+
+  // Weights share the flows out unevenly
+  expect( router.remove_route( 11U << 24, 8 ), "route not removed" );
+  router.add_route( 11U << 24, 8, paths );
+  if ( flat_table ) {
+    router.wait_for_flat_table();
+  }
+  check_distribution(
+    send_flows( router, neighbors, flows, rounds ), num_flows, rounds, { 1.0 / 6, 1.0 / 6, 1.0 / 6, 0.5 } );
+}
+
+// Expect `add` (adding a route) to throw a runtime_error
+template<class Add>
+static void expect_rejected( Add&& add, const string& what )
+{
+  bool threw = false;
+  try {
+    add();
+  } catch ( const runtime_error& ) {
+    threw = true;
+  }
+  expect( threw, what );
+}
+
+// A route that the flat table would have no room for is turned away when it is added
+static void test_flat_table_limits()
+{
+  Router router;
+  router.add_interface( AsyncNetworkInterface { ethernet_address( 1, 0 ), interface_address( 1, 0 ) } );
+  router.use_flat_table( true );
+  cerr.setstate( ios::failbit ); // (tens of thousands of routes to add, each logged)
+
+  // Every weight makes a distinct set of next hops
+  const auto add_weighted = [&]( const uint32_t n ) {
+    router.add_route( ( 11U << 24 ) | ( n << 8 ), 24, { { {}, 0, n + 1 } } );
+  };
+  for ( uint32_t n = 0; n < Dir24_8Table::MAX_NEXT_HOP; ++n ) {
+    add_weighted( n );
+  }
+  expect_rejected( [&] { add_weighted( Dir24_8Table::MAX_NEXT_HOP ); }, "one set of next hops too many accepted" );
+  router.add_route( 12U << 24, 24, { { {}, 0, 1 } } ); // (a set already in use is fine)
+  expect( router.remove_route( ( 11U << 24 ) | ( 1U << 8 ), 24 ), "route not removed" ); // (the last with its set)
+  add_weighted( Dir24_8Table::MAX_NEXT_HOP );
+
+  // Every /24 with a longer prefix in it needs an overflow block
+  const auto add_long = [&]( const uint32_t n ) { router.add_route( ( 13U << 24 ) | ( n << 8 ), 25, {}, 0 ); };
+  for ( uint32_t n = 0; n < Dir24_8Table::MAX_OVERFLOW_BLOCKS; ++n ) {
+    add_long( n );
+  }
+  expect_rejected( [&] { add_long( Dir24_8Table::MAX_OVERFLOW_BLOCKS ); }, "one overflow block too many accepted" );
+  router.add_route( ( 13U << 24 ) | 0x80, 25, {}, 0 ); // (a /24 that already has a block is fine)
+  cerr.clear();
+
+  // ...so the table for what was accepted builds
+  router.wait_for_flat_table();
+}
+
+int main()
+{
+  try {
+    test_ecmp( false );
+    test_ecmp( true );
+    test_flat_table_limits();
+
+    bool threw = false;
+    try {
+      RouterRule { 0, 0, vector<RouterRule::NextHop> {} };
+    } catch ( const invalid_argument& ) {
+      threw = true;
+    }
+    expect( threw, "route without next hops accepted" );
+
+    // Weights may add up to 2^32 (and the highest flow hash then goes to the last next hop), but no more
+    const RouterRule heaviest { 0, 0, { { {}, 1, 0xffffffff }, { {}, 2, 1 } } };
+    expect( heaviest.next_hop_for( 0xfffffffe ).interface_num == 1, "flow sent to the wrong next hop" );
+    expect( heaviest.next_hop_for( 0xffffffff ).interface_num == 2, "flow sent to the wrong next hop" );
+    threw = false;
+    try {
+      RouterRule { 0, 0, { { {}, 1, 0xffffffff }, { {}, 2, 2 } } };
+    } catch ( const invalid_argument& ) {
+      threw = true;
+    }
+    expect( threw, "route with weights adding up to more than 2^32 accepted" );
+  } catch ( const exception& e ) {
+    cerr.clear(); // (in case the test failed while the route logging was silenced)
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "address.hh"
+#include "ethernet_header.hh"
+#include "ipv4_datagram.hh"
+#include "network_interface.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Addresses and traffic for the tests that put a Router between neighbors: the router's interface `i` is host 1
+// on 10.0.i.0/24, and the neighbor on the other end of it is host 2
+
+inline EthernetAddress ethernet_address( const uint8_t host, const size_t interface )
+{
+  return { 0x02, 0, 0, 0, static_cast<uint8_t>( interface ), host };
+}
+
+inline Address interface_address( const uint8_t host, const size_t interface )
+{
+  return Address { "10.0." + std::to_string( interface ) + "." + std::to_string( host ) };
+}
+
+inline InternetDatagram make_datagram( const uint32_t src,
+                                       const uint32_t dst,
+                                       const std::string& payload,
+                                       const uint8_t ttl = 64 )
+{
+  InternetDatagram dgram;
+  dgram.header.src = src;
+  dgram.header.dst = dst;
+  dgram.header.len = IPv4Header::LENGTH + payload.size();
+  dgram.header.ttl = ttl;
+  dgram.header.compute_checksum();
+  dgram.payload.emplace_back( payload );
+  return dgram;
+}
+
+// Carry every frame that `from` has to send over to `to` (an AsyncNetworkInterface keeps the datagrams)
+template<class Receiver>
+void deliver( NetworkInterface& from, Receiver& to )
+{
+  while ( auto frame = from.maybe_send() ) {
+    to.recv_frame( frame.value() );
+  }
+}
+
+// Carry frames back and forth between two interfaces until neither has anything to send
+template<class Receiver>
+void exchange_frames( NetworkInterface& x, Receiver& y )
+{
+  bool moved = true;
+  while ( moved ) {
+    moved = false;
+    while ( auto frame = x.maybe_send() ) {
+      y.recv_frame( frame.value() );
+      moved = true;
+    }
+    while ( auto frame = y.maybe_send() ) {
+      x.recv_frame( frame.value() );
+      moved = true;
+    }
+  }
+}
@@ -0,0 +1,170 @@
+#include "router.hh"
+#include "router_fixture.hh"
+#include "test_helpers.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <ctime>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+static constexpr size_t num_interfaces = 4;
+
+// The neighbors on the other end of each of the router's interfaces, run from one thread
+class Neighbors
+{
+  Router& router_;
+  vector<NetworkInterface> interfaces_ {};
+  vector<optional<EthernetFrame>> undelivered_ = vector<optional<EthernetFrame>>( num_interfaces );
+
+public:
+  vector<vector<string>> received = vector<vector<string>>( num_interfaces ); // payloads, by neighbor
+
+  explicit Neighbors( Router& router ) : router_( router )
+  {
+    for ( size_t i = 0; i < num_interfaces; ++i ) {
+      interfaces_.emplace_back( ethernet_address( 2, i ), interface_address( 2, i ) );
+    }
+  }
+
+  void send( const size_t from, const uint32_t dst, const string& payload )
+  {
+    interfaces_[from].send_datagram( make_datagram( interface_address( 2, from ).ipv4_numeric(), dst, payload ),
+                                      interface_address( 1, from ) );
+  }
+
+  // Exchange frames with the router's workers until `count` datagrams in all have been received
+  void exchange_until( const size_t count )
+  {
+    const auto deadline = steady_clock::now() + seconds( 5 );
+    while ( total_received() < count ) {
+      expect( steady_clock::now() < deadline,
+              "only " + to_string( total_received() ) + " of " + to_string( count ) + " datagrams arrived" );
+      exchange();
+      this_thread::yield();
+    }
+  }
+
+  void exchange()
+  {
+    for ( size_t i = 0; i < num_interfaces; ++i ) {
+      while ( true ) {
+        if ( not undelivered_[i].has_value() ) {
+          undelivered_[i] = interfaces_[i].maybe_send();
+        }
+        if ( not undelivered_[i].has_value() or not router_.deliver_frame( i, move( undelivered_[i].value() ) ) ) {
+          break; // (the worker is behind: try again next time)
+        }
+        undelivered_[i].reset();
+      }
+      while ( auto frame = router_.collect_frame( i ) ) {
+        if ( auto dgram = interfaces_[i].recv_frame( frame.value() ) ) {
+          expect( dgram->header.ttl == 63, "TTL not decremented" );
+          received[i].emplace_back( dgram->payload.front() );
+        }
+      }
+    }
+  }
+
+  size_t total_received() const
+  {
+    size_t total = 0;
+    for ( const auto& payloads : received ) {
+      total += payloads.size();
+    }
+    return total;
+  }
+};
+
+int main()
+{
+  try {
+    Router router;
+    for ( size_t i = 0; i < num_interfaces; ++i ) {
+      router.add_interface( AsyncNetworkInterface { ethernet_address( 1, i ), interface_address( 1, i ) } );
+      router.add_route( ( 11U << 24 ) | ( i << 16 ), 16, interface_address( 2, i ), i );
+    }
+    router.start_workers( 2 );
+    Neighbors neighbors { router };
+
+    // Every neighbor sends to hosts behind every other one, in rounds small enough that no ring overflows
+    constexpr size_t rounds = 50;
+    size_t expected = 0;
+    for ( size_t round = 0; round < rounds; ++round ) {
+      for ( size_t from = 0; from < num_interfaces; ++from ) {
+        for ( size_t to = 0; to < num_interfaces; ++to ) {
+          if ( from != to ) {
+            const uint32_t dst = ( 11U << 24 ) | ( to << 16 ) | round;
+            neighbors.send( from, dst, to_string( from ) + ":" + to_string( round ) );
+            ++expected;
+          }
+        }
+      }
+      neighbors.exchange_until( expected );
+    }
+
+    // Each flow arrived complete and in order, whichever workers it crossed
+    for ( size_t to = 0; to < num_interfaces; ++to ) {
+      map<size_t, size_t> next_round;
+      for ( const string& payload : neighbors.received[to] ) {
+        const size_t from = stoul( payload.substr( 0, payload.find( ':' ) ) );
+        expect( payload.substr( payload.find( ':' ) + 1 ) == to_string( next_round[from]++ ),
+                "datagram " + payload + " reordered" );
+      }
+      expect( neighbors.received[to].size() == rounds * ( num_interfaces - 1 ), "datagrams missing" );
+    }
+    expect( router.handoff_drops() == 0, "datagrams dropped between workers" );
+
+    // A route added while the workers run takes effect (once the table that includes it is swapped in)
+    router.add_route( 12U << 24, 8, interface_address( 2, 3 ), 3 );
+    router.wait_for_flat_table();
+    neighbors.send( 0, ( 12U << 24 ) | 1, "new route" );
+    neighbors.exchange_until( expected + 1 );
+    expect( neighbors.received[3].back() == "new route", "datagram for the new route went astray" );
+
+    // A burst of route changes does not rebuild the table once per change (a rebuild takes tens of ms)
+    const auto burst_start = steady_clock::now();
+    for ( uint32_t n = 0; n < 200; ++n ) {
+      const size_t to = n % num_interfaces;
+      router.add_route( ( 13U << 24 ) | ( n << 8 ), 24, interface_address( 2, to ), to );
+    }
+    for ( uint32_t n = 0; n < 199; ++n ) {
+      expect( router.remove_route( ( 13U << 24 ) | ( n << 8 ), 24 ), "route not removed" );
+    }
+    expect( steady_clock::now() - burst_start < seconds( 2 ), "route changes held up by table rebuilds" );
+    router.wait_for_flat_table();
+    neighbors.send( 0, ( 13U << 24 ) | ( 199U << 8 ) | 1, "after the burst" );
+    neighbors.exchange_until( expected + 2 );
+    expect( neighbors.received[199 % num_interfaces].back() == "after the burst",
+            "datagram for the last route of the burst went astray" );
+
+    // Idle workers sleep instead of spinning (two spinning workers would use about a CPU each)
+    const auto wall_start = steady_clock::now();
+    const clock_t cpu_start = clock();
+    this_thread::sleep_for( milliseconds( 300 ) );
+    const double cpu_ms = 1000.0 * static_cast<double>( clock() - cpu_start ) / CLOCKS_PER_SEC;
+    const double wall_ms = duration<double, milli>( steady_clock::now() - wall_start ).count();
+    expect( cpu_ms < wall_ms / 4,
+            "idle workers used " + to_string( cpu_ms ) + " ms of CPU in " + to_string( wall_ms ) + " ms" );
+
+    // ...and a datagram wakes them, also with the batch size changed while they run
+    router.set_max_batch( 1 );
+    neighbors.send( 1, ( 11U << 24 ) | ( 2U << 16 ), "after sleeping" );
+    neighbors.exchange_until( expected + 3 );
+    expect( neighbors.received[2].back() == "after sleeping", "datagram sent to sleeping workers went astray" );
+
+    router.stop_workers();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
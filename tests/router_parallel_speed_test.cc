@@ -0,0 +1,132 @@
+#include "router.hh"
+#include "router_fixture.hh"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+static constexpr size_t num_interfaces = 8;
+
+// Forward traffic through an eight-interface router on `num_workers` worker threads for `duration`,
+// with one thread per interface standing in for the network card; returns packets per second
+static double forwarding_speed_test( const size_t num_workers, const milliseconds duration )
+{
+  Router router;
+  vector<NetworkInterface> neighbors;
+  for ( size_t i = 0; i < num_interfaces; ++i ) {
+    router.add_interface( AsyncNetworkInterface { ethernet_address( 1, i ), interface_address( 1, i ) } );
+    neighbors.emplace_back( ethernet_address( 2, i ), interface_address( 2, i ) );
+  }
+  for ( size_t i = 0; i < num_interfaces; ++i ) {
+    router.add_route( ( 10U << 24 ) | ( ( i + 1 ) << 16 ), 16, interface_address( 2, i ), i );
+  }
+
+  // Resolve Ethernet addresses (by ARP) between the router and every neighbor before the workers start
+  for ( size_t i = 0; i < num_interfaces; ++i ) {
+    const uint32_t dst = ( 10U << 24 ) | ( ( ( i + 1 ) % num_interfaces + 1 ) << 16 );
+    neighbors[i].send_datagram( make_datagram( interface_address( 2, i ).ipv4_numeric(), dst, "warm-up" ),
+                                interface_address( 1, i ) );
+    exchange_frames( neighbors[i], router.interface( i ) );
+    router.route();
+  }
+  for ( size_t i = 0; i < num_interfaces; ++i ) {
+    exchange_frames( neighbors[i], router.interface( i ) );
+  }
+
+  // Frames from each neighbor, carrying datagrams for hosts behind the other neighbors
+  constexpr size_t frames_per_interface = 64;
+  default_random_engine rd { 1624 };
+  uniform_int_distribution<size_t> length_dist { 40, 1400 };
+  uniform_int_distribution<uint16_t> host_dist;
+  vector<vector<EthernetFrame>> frames( num_interfaces );
+  for ( size_t i = 0; i < num_interfaces; ++i ) {
+    for ( size_t n = 0; n < frames_per_interface; ++n ) {
+      const size_t j = ( i + 1 + n % ( num_interfaces - 1 ) ) % num_interfaces;
+      const uint32_t dst = ( 10U << 24 ) | ( ( j + 1 ) << 16 ) | host_dist( rd );
+      const string payload( length_dist( rd ), 'x' );
+      neighbors[i].send_datagram( make_datagram( interface_address( 2, i ).ipv4_numeric(), dst, payload ),
+                                  interface_address( 1, i ) );
+      frames[i].push_back( neighbors[i].maybe_send().value() );
+    }
+  }
+
+  router.start_workers( num_workers );
+
+  atomic<bool> stop {};
+  vector<size_t> forwarded( num_interfaces );
+  vector<thread> ports;
+  const auto start_time = steady_clock::now();
+  for ( size_t i = 0; i < num_interfaces; ++i ) {
+    ports.emplace_back( [&, i] {
+      size_t n = 0;
+      size_t count = 0;
+      while ( not stop.load( memory_order_relaxed ) ) {
+        EthernetFrame frame = frames[i][n % frames_per_interface];
+        if ( router.deliver_frame( i, move( frame ) ) ) {
+          ++n;
+        }
+        while ( router.collect_frame( i ).has_value() ) {
+          ++count;
+        }
+      }
+      forwarded[i] = count;
+    } );
+  }
+  this_thread::sleep_for( duration );
+  stop = true;
+  for ( auto& port : ports ) {
+    port.join();
+  }
+  const auto stop_time = steady_clock::now();
+  router.stop_workers();
+
+  size_t total = 0;
+  for ( const size_t count : forwarded ) {
+    total += count;
+  }
+  if ( total == 0 ) {
+    throw runtime_error( "router forwarded nothing with " + to_string( num_workers ) + " workers" );
+  }
+
+  const auto test_duration = duration_cast<std::chrono::duration<double>>( stop_time - start_time );
+  return static_cast<double>( total ) / test_duration.count();
+}
+
+void program_body()
+{
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  cout << "Parallel router forwarding (" << num_interfaces << " interfaces, " << thread::hardware_concurrency()
+       << " CPUs):";
+  debug_output << "Parallel router forwarding:";
+  for ( const size_t workers : { 1, 2, 4, 8 } ) {
+    const double pps = forwarding_speed_test( workers, milliseconds( 400 ) );
+    cout << " " << workers << ( workers == 1 ? " worker " : " workers " ) << fixed << setprecision( 0 ) << pps
+         << " packets/s" << ( workers == 8 ? ".\n" : ";" );
+    debug_output << " " << workers << ": " << fixed << setprecision( 0 ) << pps;
+  }
+  debug_output << " packets/s\n";
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
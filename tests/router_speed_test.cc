@@ -0,0 +1,157 @@
+#include "router.hh"
+#include "router_fixture.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+static constexpr size_t num_interfaces = 4;
+
+// Time `num_headers` TTL updates, returning nanoseconds per update
+static double ttl_update_speed_test( const size_t num_headers, const bool incremental )
+{
+  IPv4Header header;
+  header.len = 1500;
+  header.src = 0x0a000002;
+  header.dst = 0x0a010203;
+  header.compute_checksum();
+
+  uint32_t sink = 0;
+  const auto start_time = steady_clock::now();
+  for ( size_t i = 0; i < num_headers; ++i ) {
+    header.ttl = 255;
+    if ( incremental ) {
+      header.decrement_ttl();
+    } else {
+      --header.ttl;
+      header.compute_checksum();
+    }
+    sink += header.cksum;
+  }
+  const auto stop_time = steady_clock::now();
+
+  if ( sink == 0 ) {
+    throw runtime_error( "TTL updates produced no checksums" );
+  }
+
+  const auto test_duration = duration_cast<duration<double, nano>>( stop_time - start_time );
+  return test_duration.count() / static_cast<double>( num_headers );
+}
+
+// Forward `num_datagrams` datagrams through a four-interface router, returning packets per second.
+// With burst == false, route() runs after every frame from each interface; otherwise it runs once after
+// a burst of 64 frames on every interface.
+static double forwarding_speed_test( const size_t num_datagrams, const bool burst )
+{
+  Router router;
+  vector<NetworkInterface> neighbors;
+  for ( size_t i = 0; i < num_interfaces; ++i ) {
+    router.add_interface( AsyncNetworkInterface { ethernet_address( 1, i ), interface_address( 1, i ) } );
+    neighbors.emplace_back( ethernet_address( 2, i ), interface_address( 2, i ) );
+  }
+  for ( size_t i = 0; i < num_interfaces; ++i ) {
+    router.add_route( ( 10U << 24 ) | ( ( i + 1 ) << 16 ), 16, interface_address( 2, i ), i );
+    router.add_route( ( 10U << 24 ) | ( i << 8 ), 24, {}, i );
+  }
+
+  // Resolve Ethernet addresses (by ARP) between the router and every neighbor, by forwarding one datagram
+  // from each neighbor to each other one
+  for ( size_t i = 0; i < num_interfaces; ++i ) {
+    for ( size_t j = 0; j < num_interfaces; ++j ) {
+      if ( i != j ) {
+        const uint32_t dst = ( 10U << 24 ) | ( ( j + 1 ) << 16 );
+        neighbors[i].send_datagram( make_datagram( interface_address( 2, i ).ipv4_numeric(), dst, "warm-up" ),
+                                    interface_address( 1, i ) );
+        exchange_frames( neighbors[i], router.interface( i ) );
+        router.route();
+        exchange_frames( router.interface( j ), neighbors[j] );
+      }
+    }
+  }
+
+  // Frames from each neighbor, carrying datagrams for hosts behind the other neighbors
+  constexpr size_t frames_per_interface = 64;
+  default_random_engine rd { 1624 };
+  uniform_int_distribution<size_t> length_dist { 40, 1400 };
+  uniform_int_distribution<uint16_t> host_dist;
+  vector<vector<EthernetFrame>> frames( num_interfaces );
+  for ( size_t i = 0; i < num_interfaces; ++i ) {
+    for ( size_t n = 0; n < frames_per_interface; ++n ) {
+      const size_t j = ( i + 1 + n % ( num_interfaces - 1 ) ) % num_interfaces;
+      const uint32_t dst = ( 10U << 24 ) | ( ( j + 1 ) << 16 ) | host_dist( rd );
+      const string payload( length_dist( rd ), 'x' );
+      neighbors[i].send_datagram( make_datagram( interface_address( 2, i ).ipv4_numeric(), dst, payload ),
+                                  interface_address( 1, i ) );
+      frames[i].push_back( neighbors[i].maybe_send().value() );
+    }
+  }
+
+  size_t forwarded = 0;
+  const auto start_time = steady_clock::now();
+  for ( size_t sent = 0; sent < num_datagrams; ) {
+    for ( size_t n = 0; n < frames_per_interface; ++n ) {
+      for ( size_t i = 0; i < num_interfaces; ++i ) {
+        router.interface( i ).recv_frame( frames[i][n] );
+      }
+      sent += num_interfaces;
+      if ( burst and n + 1 < frames_per_interface ) {
+        continue;
+      }
+      router.route();
+      for ( size_t i = 0; i < num_interfaces; ++i ) {
+        while ( router.interface( i ).maybe_send().has_value() ) {
+          ++forwarded;
+        }
+      }
+    }
+  }
+  const auto stop_time = steady_clock::now();
+
+  if ( forwarded < num_datagrams ) {
+    throw runtime_error( "router forwarded " + to_string( forwarded ) + " of " + to_string( num_datagrams )
+                         + " datagrams" );
+  }
+
+  const auto test_duration = duration_cast<duration<double>>( stop_time - start_time );
+  return static_cast<double>( forwarded ) / test_duration.count();
+}
+
+void program_body()
+{
+  const double full = ttl_update_speed_test( 10'000'000, false );
+  const double incremental = ttl_update_speed_test( 10'000'000, true );
+  const double pps = forwarding_speed_test( 1'000'000, false );
+  const double burst_pps = forwarding_speed_test( 1'000'000, true );
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  cout << "TTL decrement with checksum recomputation: " << fixed << setprecision( 1 ) << full
+       << " ns; with RFC 1624 incremental update: " << incremental << " ns.\n";
+  cout << "Router forwarding (4 interfaces): " << setprecision( 0 ) << pps
+       << " packets/s routing each frame; " << burst_pps << " packets/s routing bursts.\n";
+
+  debug_output << "        Router forwarding: " << fixed << setprecision( 0 ) << pps << " / " << burst_pps
+               << " (burst) packets/s (TTL update "
+               << setprecision( 1 ) << full << " -> " << incremental << " ns)\n";
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,106 @@
+#include "checksum.hh"
+#include "tcp_over_ip.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+// Wrapping as it used to be done: serialize the segment to checksum it, and then again for the payload
+static InternetDatagram serialize_twice( TCPOverIPv4Adapter& adapter, TCPSegment& seg )
+{
+  seg.udinfo.src_port = adapter.config().source.port();
+  seg.udinfo.dst_port = adapter.config().destination.port();
+
+  InternetDatagram dgram;
+  dgram.header.src = adapter.config().source.ipv4_numeric();
+  dgram.header.dst = adapter.config().destination.ipv4_numeric();
+  dgram.header.len = dgram.header.hlen * 4 + 20 + seg.sender_message.payload.size();
+
+  seg.udinfo.cksum = 0;
+  InternetChecksum check { dgram.header.pseudo_checksum() };
+  check.add( serialize( seg ) );
+  seg.udinfo.cksum = check.value();
+
+  dgram.header.cksum = 0;
+  InternetChecksum header_check;
+  header_check.add( serialize( dgram.header ) );
+  dgram.header.cksum = header_check.value();
+
+  dgram.payload = serialize( seg );
+  return dgram;
+}
+
+// Wrap `segments` into datagrams `rounds` times, returning segments per second
+template<class Wrap>
+static double speed_test( vector<TCPSegment>& segments, const size_t rounds, Wrap&& wrap )
+{
+  size_t bytes = 0;
+  const auto start_time = steady_clock::now();
+  for ( size_t round = 0; round < rounds; ++round ) {
+    for ( auto& seg : segments ) {
+      const InternetDatagram dgram = wrap( seg );
+      bytes += dgram.header.len;
+    }
+  }
+  const auto stop_time = steady_clock::now();
+
+  if ( bytes == 0 ) {
+    throw runtime_error( "wrapped no bytes" );
+  }
+
+  const auto test_duration = duration_cast<duration<double>>( stop_time - start_time );
+  return static_cast<double>( segments.size() * rounds ) / test_duration.count();
+}
+
+void program_body()
+{
+  constexpr size_t num_segments = 1000;
+  constexpr size_t rounds = 200;
+
+  TCPOverIPv4Adapter adapter;
+  adapter.config_mut().source = Address { "169.254.144.9", 40000 };
+  adapter.config_mut().destination = Address { "169.254.144.1", 80 };
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  for ( const size_t payload_length : { 0, 536, 1460 } ) {
+    vector<TCPSegment> segments( num_segments );
+    for ( size_t i = 0; i < num_segments; ++i ) {
+      segments[i].sender_message.seqno = Wrap32 { static_cast<uint32_t>( i * payload_length ) };
+      segments[i].sender_message.payload = string( payload_length, static_cast<char>( 'a' + i % 26 ) );
+      segments[i].receiver_message.ackno = Wrap32 { 1 };
+      segments[i].receiver_message.window_size = 65535;
+    }
+
+    const double wrap_rate
+      = speed_test( segments, rounds, [&]( TCPSegment& seg ) { return adapter.wrap_tcp_in_ip( seg ); } );
+    const double twice_rate
+      = speed_test( segments, rounds, [&]( TCPSegment& seg ) { return serialize_twice( adapter, seg ); } );
+
+    cout << "wrap_tcp_in_ip with " << payload_length << "-byte payloads: " << fixed << setprecision( 2 )
+         << wrap_rate / 1e6 << " M segments/s (" << twice_rate / 1e6 << " M when serializing twice).\n";
+
+    debug_output << "    wrap_tcp_in_ip (" << payload_length << " B): " << fixed << setprecision( 2 )
+                 << wrap_rate / 1e6 << " M seg/s (" << twice_rate / 1e6 << " serializing twice)\n";
+  }
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,102 @@
+#include "tcp_over_ip.hh"
+#include "test_helpers.hh"
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static TCPOverIPv4Adapter make_adapter( const Address& source, const Address& destination )
+{
+  TCPOverIPv4Adapter adapter;
+  adapter.config_mut().source = source;
+  adapter.config_mut().destination = destination;
+  return adapter;
+}
+
+// A datagram from `sender`, with its TCP checksum optionally broken
+static InternetDatagram datagram_from( TCPOverIPv4Adapter& sender, const bool syn, const bool corrupt = false )
+{
+  TCPSegment seg;
+  seg.sender_message.SYN = syn;
+  seg.sender_message.payload = string { "payload" };
+  InternetDatagram dgram = sender.wrap_tcp_in_ip( seg );
+  if ( corrupt ) {
+    string bytes = concatenate( dgram.payload );
+    bytes.back() ^= 1;
+    dgram.payload = { Buffer { bytes } };
+  }
+  return dgram;
+}
+
+static const Address local { "169.254.144.9", 40000 };
+static const Address peer { "169.254.144.1", 80 };
+
+// Segments for other connections are dropped on their ports, even when their checksum is wrong
+static void established()
+{
+  TCPOverIPv4Adapter adapter = make_adapter( local, peer );
+  TCPOverIPv4Adapter from_peer = make_adapter( peer, local );
+  TCPOverIPv4Adapter from_other_port = make_adapter( Address { "169.254.144.1", 81 }, local );
+  TCPOverIPv4Adapter to_other_port = make_adapter( peer, Address { "169.254.144.9", 40001 } );
+
+  expect( adapter.unwrap_tcp_in_ip( datagram_from( from_peer, false ) ).has_value(), "segment from peer dropped" );
+  expect( not adapter.unwrap_tcp_in_ip( datagram_from( from_peer, false, true ) ).has_value(),
+          "segment with a bad checksum accepted" );
+  expect( adapter.filter_stats().wrong_dst_port == 0 and adapter.filter_stats().wrong_src_port == 0,
+          "segments for this connection counted as filtered" );
+
+  expect( not adapter.unwrap_tcp_in_ip( datagram_from( from_other_port, false, true ) ).has_value()
+            and not adapter.unwrap_tcp_in_ip( datagram_from( from_other_port, false ) ).has_value(),
+          "segment from another port accepted" );
+  expect( adapter.filter_stats().wrong_src_port == 2, "segments from another port not filtered on the port" );
+
+  expect( not adapter.unwrap_tcp_in_ip( datagram_from( to_other_port, false, true ) ).has_value(),
+          "segment to another port accepted" );
+  expect( adapter.filter_stats().wrong_dst_port == 1, "segment to another port not filtered on the port" );
+
+  // the ports can be split between payload buffers
+  InternetDatagram split = datagram_from( from_peer, false );
+  const string bytes = concatenate( split.payload );
+  split.payload
+    = { Buffer { bytes.substr( 0, 1 ) }, Buffer { bytes.substr( 1, 2 ) }, Buffer { bytes.substr( 3 ) } };
+  expect( adapter.unwrap_tcp_in_ip( split ).has_value(), "segment with split ports dropped" );
+
+  InternetDatagram truncated = split;
+  truncated.payload.resize( 2 );
+  expect( not adapter.unwrap_tcp_in_ip( truncated ).has_value(), "segment too short for its ports accepted" );
+  expect( adapter.filter_stats().wrong_dst_port == 1 and adapter.filter_stats().wrong_src_port == 2,
+          "short segment counted as filtered" );
+}
+
+// A listening adapter takes a SYN from any port, but only to its own
+static void listening()
+{
+  TCPOverIPv4Adapter adapter = make_adapter( Address { "0", 40000 }, Address { "0", 0 } );
+  adapter.set_listening( true );
+  TCPOverIPv4Adapter to_other_port = make_adapter( peer, Address { "169.254.144.9", 40001 } );
+  TCPOverIPv4Adapter from_peer = make_adapter( peer, local );
+
+  expect( not adapter.unwrap_tcp_in_ip( datagram_from( to_other_port, true ) ).has_value()
+            and adapter.filter_stats().wrong_dst_port == 1,
+          "listening adapter took a SYN for another port" );
+  expect( adapter.unwrap_tcp_in_ip( datagram_from( from_peer, true ) ).has_value() and not adapter.listening(),
+          "listening adapter refused a SYN" );
+  expect( adapter.config().destination.port() == 80 and adapter.filter_stats().wrong_src_port == 0,
+          "connection not recorded from the SYN" );
+}
+
+int main()
+{
+  try {
+    established();
+    listening();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
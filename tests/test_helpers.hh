@@ -0,0 +1,28 @@
+#pragma once
+
+#include "buffer.hh"
+
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Helpers for the tests that check a component directly, rather than step by step through a TestHarness
+
+// Fail the test (by throwing) with `what` unless `condition` holds
+inline void expect( const bool condition, const std::string& what )
+{
+  if ( not condition ) {
+    throw std::runtime_error( what );
+  }
+}
+
+// The bytes of `buffers`, one after another
+inline std::string concatenate( const std::vector<Buffer>& buffers )
+{
+  std::string ret;
+  for ( const auto& buf : buffers ) {
+    ret.append( std::string_view { buf } );
+  }
+  return ret;
+}
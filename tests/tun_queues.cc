@@ -0,0 +1,292 @@
+#include "exception.hh"
+#include "socket.hh"
+#include "tcp_minnow_socket.hh"
+#include "test_helpers.hh"
+#include "tun.hh"
+
+#include <arpa/inet.h>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <linux/if.h>
+#include <linux/if_tun.h>
+#include <memory>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdexcept>
+#include <string>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+// A persistent TUN device made for the test (named by the kernel), deleted again when it goes out of scope
+class ScratchTun
+{
+  string name_ {};
+  int16_t flags_;
+
+  int attach( const string& name ) const
+  {
+    const int fd = CheckSystemCall( "open", open( "/dev/net/tun", O_RDWR | O_CLOEXEC ) );
+    ifreq req {};
+    req.ifr_flags = flags_;
+    strncpy( static_cast<char*>( req.ifr_name ), name.c_str(), IFNAMSIZ - 1 );
+    if ( ioctl( fd, TUNSETIFF, &req ) < 0 ) {
+      const int saved_errno = errno;
+      close( fd );
+      errno = saved_errno;
+      return -1;
+    }
+    return fd;
+  }
+
+public:
+  explicit ScratchTun( const bool multi_queue )
+    : flags_( static_cast<int16_t>( IFF_TUN | IFF_NO_PI | ( multi_queue ? IFF_MULTI_QUEUE : 0 ) ) )
+  {
+    const int fd = attach( "mnwtest%d" );
+    if ( fd < 0 ) {
+      throw unix_error( "TUNSETIFF" );
+    }
+    ifreq req {};
+    CheckSystemCall( "TUNGETIFF", ioctl( fd, TUNGETIFF, &req ) );
+    name_ = static_cast<const char*>( req.ifr_name );
+    CheckSystemCall( "TUNSETPERSIST", ioctl( fd, TUNSETPERSIST, 1 ) );
+    close( fd );
+  }
+
+  ~ScratchTun()
+  {
+    const int fd = attach( name_ );
+    if ( fd >= 0 ) {
+      ioctl( fd, TUNSETPERSIST, 0 );
+      close( fd );
+    }
+  }
+
+  ScratchTun( const ScratchTun& other ) = delete;
+  ScratchTun& operator=( const ScratchTun& other ) = delete;
+
+  const string& name() const { return name_; }
+
+  //! Give the kernel's side of the device `address`/24, and bring the device up
+  //! \returns false if this process may not configure network devices
+  bool bring_up( const string& address ) const
+  {
+    const UDPSocket control;
+    ifreq req {};
+    strncpy( static_cast<char*>( req.ifr_name ), name_.c_str(), IFNAMSIZ - 1 );
+
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    CheckSystemCall( "inet_pton", inet_pton( AF_INET, address.c_str(), &addr.sin_addr ) );
+    memcpy( &req.ifr_addr, &addr, sizeof( addr ) );
+    if ( ioctl( control.fd_num(), SIOCSIFADDR, &req ) < 0 ) {
+      if ( errno == EPERM or errno == EACCES ) {
+        return false;
+      }
+      throw unix_error( "SIOCSIFADDR" );
+    }
+    CheckSystemCall( "inet_pton", inet_pton( AF_INET, "255.255.255.0", &addr.sin_addr ) );
+    memcpy( &req.ifr_netmask, &addr, sizeof( addr ) );
+    CheckSystemCall( "SIOCSIFNETMASK", ioctl( control.fd_num(), SIOCSIFNETMASK, &req ) );
+
+    CheckSystemCall( "SIOCGIFFLAGS", ioctl( control.fd_num(), SIOCGIFFLAGS, &req ) );
+    req.ifr_flags = static_cast<int16_t>( req.ifr_flags | IFF_UP );
+    CheckSystemCall( "SIOCSIFFLAGS", ioctl( control.fd_num(), SIOCSIFFLAGS, &req ) );
+    return true;
+  }
+};
+
+static bool multi_queue( const TunFD& queue )
+{
+  ifreq req {};
+  CheckSystemCall( "TUNGETIFF", ioctl( queue.fd_num(), TUNGETIFF, &req ) );
+  return static_cast<bool>( req.ifr_flags & IFF_MULTI_QUEUE );
+}
+
+// On a multi-queue device, every open_queue() attaches a queue of its own
+static void multi_queue_device()
+{
+  const ScratchTun device { true };
+  const TunFD first = TunFD::open_queue( device.name() );
+  const TunFD second = TunFD::open_queue( device.name() );
+  expect( multi_queue( first ) and multi_queue( second ), "queues not attached in multi-queue mode" );
+
+  // (a single-queue open is what the kernel turns down, with EINVAL, on such a device)
+  bool rejected = false;
+  try {
+    const TunFD single { device.name() };
+  } catch ( const unix_error& e ) {
+    rejected = e.error_code() == EINVAL;
+  }
+  expect( rejected, "multi-queue device attached as a single-queue one" );
+}
+
+// On a single-queue device, the kernel refuses the multi-queue attach with EINVAL, and open_queue() falls back
+static void single_queue_device()
+{
+  const ScratchTun device { false };
+
+  bool rejected = false;
+  try {
+    const TunFD attempt { device.name(), true };
+  } catch ( const unix_error& e ) {
+    rejected = e.error_code() == EINVAL;
+  }
+  expect( rejected, "single-queue device did not refuse a multi-queue attach with EINVAL" );
+
+  const TunFD queue = TunFD::open_queue( device.name() );
+  expect( not multi_queue( queue ), "fallback queue attached in multi-queue mode" );
+}
+
+// A datagram carrying a TCP segment with `payload` from `from` to `to` (as the kernel would put it on a queue)
+static string datagram( const Address& from, const Address& to, const string& payload, const bool syn = false )
+{
+  TCPOverIPv4Adapter peer;
+  peer.config_mut().source = from;
+  peer.config_mut().destination = to;
+  TCPSegment seg;
+  seg.sender_message.SYN = syn;
+  seg.sender_message.payload = payload;
+  IPv4Header header;
+  return string { string_view { peer.build_tcp_in_ip( seg, header ) } };
+}
+
+// The next packet passed on to `inbox`, if there is one
+static string passed_on( FileDescriptor& inbox )
+{
+  string packet( 2048, 0 );
+  const unsigned reads = inbox.read_count();
+  inbox.read( packet );
+  return inbox.read_count() == reads ? string {} : packet;
+}
+
+// Sockets sharing a device (standing in for it with socketpairs) pass each other's packets on by 4-tuple, and a
+// listening socket takes every connection to its port until it accepts one
+static void steering()
+{
+  const auto steering = TunSteering::for_device( "mnwtest-steering" );
+  auto queue = [] {
+    array<int, 2> fds {};
+    CheckSystemCall( "socketpair", socketpair( AF_UNIX, SOCK_DGRAM, 0, fds.data() ) );
+    close( fds[1] );
+    return TunFD { FileDescriptor { fds[0] }, false };
+  };
+  TCPOverIPv4OverTunFdAdapter client { queue(), steering };
+  TCPOverIPv4OverTunFdAdapter server { queue(), steering };
+
+  const Address local { "169.254.201.9", "40000" };
+  const Address peer { "169.254.201.1", "80" };
+  client.config_mut().source = local;
+  client.config_mut().destination = peer;
+  client.claim_flow();
+  server.config_mut().source = { "0", "8080" };
+  server.set_listening( true );
+  server.claim_flow();
+
+  // the client's packet, read by the server, goes to the client; and the server's, read by the client, back
+  const string for_client = datagram( peer, local, "for the client" );
+  expect( not server.receive( for_client ), "server took the client's segment" );
+  expect( passed_on( *server.inbox() ).empty(), "client's segment passed on to the server" );
+  const string packet = passed_on( *client.inbox() );
+  expect( packet == for_client, "client's segment not passed on to it" );
+  const auto seg = client.receive( packet );
+  expect( seg and string_view { seg->sender_message.payload } == "for the client", "client lost its segment" );
+
+  const Address caller { "169.254.201.1", "50000" };
+  const Address listening { "169.254.201.9", "8080" };
+  expect( not client.receive( datagram( caller, listening, "", true ) ), "client took the server's SYN" );
+  expect( server.receive( passed_on( *server.inbox() ) ).has_value(), "server did not accept the passed-on SYN" );
+
+  // once it has accepted, the server no longer takes other connections to its port
+  expect( not client.receive( datagram( { "169.254.201.1", "50001" }, listening, "" ) ), "client took a segment" );
+  expect( passed_on( *server.inbox() ).empty(), "server kept taking every connection to its port" );
+  expect( not client.receive( datagram( caller, listening, "again" ) ), "client took the server's segment" );
+  expect( not passed_on( *server.inbox() ).empty(), "server's segment not passed on to it" );
+}
+
+// Connections that sit idle for longer than the kernel remembers which queue their packets go to (it forgets a
+// flow 3 to 6 s after the flow last sent anything, and then picks any queue) still get their data
+static void idle_connections_receive()
+{
+  constexpr size_t count = 4;
+  const ScratchTun device { true };
+  if ( not device.bring_up( "169.254.201.1" ) ) {
+    cerr << "no permission to configure network devices; skipping the idle connection test\n";
+    return;
+  }
+
+  TCPSocket listener;
+  listener.bind( Address { "169.254.201.1", 0 } );
+  listener.listen();
+
+  TCPConfig tcp_config;
+  tcp_config.rt_timeout = 100;
+  vector<unique_ptr<TCPOverIPv4MinnowSocket>> clients;
+  vector<TCPSocket> servers;
+  for ( size_t i = 0; i < count; ++i ) {
+    clients.push_back( make_unique<TCPOverIPv4MinnowSocket>( TCPOverIPv4OverTunFdAdapter(
+      TunFD::open_queue( device.name() ), TunSteering::for_device( device.name() ) ) ) );
+    FdAdapterConfig adapter_config;
+    adapter_config.source = { "169.254.201.9", to_string( 40000 + i ) };
+    adapter_config.destination = listener.local_address();
+    clients.back()->connect( tcp_config, adapter_config );
+    servers.push_back( listener.accept() );
+  }
+
+  this_thread::sleep_for( chrono::milliseconds( 6500 ) );
+
+  for ( size_t i = 0; i < count; ++i ) {
+    servers.at( i ).write( "data for connection " + to_string( i ) );
+  }
+  for ( size_t i = 0; i < count; ++i ) {
+    const string expected = "data for connection " + to_string( i );
+    string received;
+    pollfd readable { clients.at( i )->fd_num(), POLLIN, 0 };
+    while ( received.size() < expected.size() and CheckSystemCall( "poll", poll( &readable, 1, 3000 ) ) > 0 ) {
+      string chunk;
+      clients.at( i )->read( chunk );
+      received += chunk;
+    }
+    expect( received == expected, "idle connection " + to_string( i ) + " got \"" + received + "\"" );
+  }
+
+  servers.clear(); // (the kernel closes first, so the sockets need not linger)
+  for ( const auto& client : clients ) {
+    client->wait_until_closed();
+  }
+}
+
+int main()
+{
+  try {
+    steering();
+
+    try {
+      const ScratchTun probe { false };
+    } catch ( const unix_error& e ) {
+      if ( e.error_code() == ENOENT or e.error_code() == EPERM or e.error_code() == EACCES ) {
+        cerr << "no access to TUN devices; skipping TUN queue tests\n";
+        return EXIT_SUCCESS;
+      }
+      throw;
+    }
+
+    multi_queue_device();
+    single_queue_device();
+    idle_connections_receive();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
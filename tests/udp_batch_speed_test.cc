@@ -0,0 +1,113 @@
+#include "socket.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+// Move `num_datagrams` datagrams over UDP loopback, `batch_size` at a time, returning packets per second.
+// With batched == false, every datagram costs one sendto/recv; otherwise each batch costs one
+// sendmmsg/recvmmsg.
+double speed_test( const size_t num_datagrams, // NOLINT(bugprone-easily-swappable-parameters)
+                   const size_t batch_size,    // NOLINT(bugprone-easily-swappable-parameters)
+                   const bool batched )
+{
+  // Generate the datagrams to be sent
+  default_random_engine rd { 1624 };
+  uniform_int_distribution<size_t> length_dist { 64, 1400 };
+  uniform_int_distribution<char> ud;
+  vector<vector<Buffer>> datagrams;
+  for ( size_t i = 0; i < batch_size; ++i ) {
+    string payload( length_dist( rd ), 0 );
+    for ( auto& ch : payload ) {
+      ch = ud( rd );
+    }
+    datagrams.push_back( { Buffer { move( payload ) } } );
+  }
+
+  UDPSocket receiver;
+  receiver.bind( Address { "127.0.0.1", 0 } );
+  UDPSocket sender;
+  sender.connect( receiver.local_address() );
+
+  vector<string> received( batch_size );
+  DatagramBatch batch { batch_size, 2048 };
+  Address source { "0" };
+  size_t bytes_checked = 0;
+
+  const auto start_time = steady_clock::now();
+  for ( size_t sent = 0; sent < num_datagrams; sent += batch_size ) {
+    if ( batched ) {
+      for ( size_t done = 0; done < batch_size; ) {
+        done += sender.send_batch( { datagrams.begin() + done, datagrams.end() } );
+      }
+      for ( size_t done = 0; done < batch_size; ) {
+        receiver.recv_batch( batch );
+        for ( size_t i = 0; i < batch.size(); ++i ) {
+          received[done + i] = batch[i];
+        }
+        done += batch.size();
+      }
+    } else {
+      for ( const auto& dgram : datagrams ) {
+        sender.send( dgram.front() );
+      }
+      for ( auto& payload : received ) {
+        receiver.recv( source, payload );
+      }
+    }
+
+    for ( size_t i = 0; i < batch_size; ++i ) {
+      if ( received[i] != string_view { datagrams[i].front() } ) {
+        throw runtime_error( "Mismatch between datagrams sent and received" );
+      }
+      bytes_checked += received[i].size();
+    }
+  }
+  const auto stop_time = steady_clock::now();
+
+  if ( bytes_checked == 0 ) {
+    throw runtime_error( "No datagrams received" );
+  }
+
+  const auto test_duration = duration_cast<duration<double>>( stop_time - start_time );
+  return static_cast<double>( num_datagrams ) / test_duration.count();
+}
+
+void program_body()
+{
+  constexpr size_t num_datagrams = 64000;
+  constexpr size_t batch_size = 32;
+
+  const double single = speed_test( num_datagrams, batch_size, false );
+  const double batched = speed_test( num_datagrams, batch_size, true );
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  cout << "UDP loopback, one datagram per system call: " << fixed << setprecision( 0 ) << single
+       << " packets/s; " << batch_size << " per recvmmsg/sendmmsg: " << batched << " packets/s ("
+       << setprecision( 2 ) << batched / single << "x).\n";
+
+  debug_output << "             UDP batching: " << fixed << setprecision( 0 ) << single << " -> " << batched
+               << " packets/s\n";
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
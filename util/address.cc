@@ -121,6 +121,25 @@ pair<string, uint16_t> Address::ip_port() const
   return { ip.data(), stoi( port.data() ) };
 }
 
+//! \details Read straight from an IPv4 or IPv6 address, without a round trip through getnameinfo's strings
+//! (the send path asks for the ports of every segment).
+uint16_t Address::port() const
+{
+  if ( _address.storage.ss_family == AF_INET and _size == sizeof( sockaddr_in ) ) {
+    sockaddr_in ipv4_addr {};
+    memcpy( &ipv4_addr, &_address.storage, _size );
+    return be16toh( ipv4_addr.sin_port );
+  }
+
+  if ( _address.storage.ss_family == AF_INET6 and _size == sizeof( sockaddr_in6 ) ) {
+    sockaddr_in6 ipv6_addr {};
+    memcpy( &ipv6_addr, &_address.storage, _size );
+    return be16toh( ipv6_addr.sin6_port );
+  }
+
+  return ip_port().second;
+}
+
 string Address::to_string() const
 {
   const auto ip_and_port = ip_port();
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "ethernet_header.hh"
+#include "header_layout.hh"
 #include "ipv4_header.hh"
 #include "parser.hh"
 
@@ -33,3 +34,16 @@ struct ARPMessage
   void parse( Parser& parser );
   void serialize( Serializer& serializer ) const;
 };
+
+// Layout of the ARP message on the wire
+using ARPMessageLayout = HeaderLayout<ARPMessage,
+                                      Field<"hardware_type", &ARPMessage::hardware_type, 0, 2>,
+                                      Field<"protocol_type", &ARPMessage::protocol_type, 2, 2>,
+                                      Field<"hardware_address_size", &ARPMessage::hardware_address_size, 4, 1>,
+                                      Field<"protocol_address_size", &ARPMessage::protocol_address_size, 5, 1>,
+                                      Field<"opcode", &ARPMessage::opcode, 6, 2>,
+                                      Field<"sender_ethernet_address", &ARPMessage::sender_ethernet_address, 8, 6>,
+                                      Field<"sender_ip_address", &ARPMessage::sender_ip_address, 14, 4>,
+                                      Field<"target_ethernet_address", &ARPMessage::target_ethernet_address, 18, 6>,
+                                      Field<"target_ip_address", &ARPMessage::target_ip_address, 24, 4>>;
+static_assert( ARPMessageLayout::LENGTH == ARPMessage::LENGTH );
@@ -1,23 +1,75 @@
 #pragma once
 
+#include "packet_pool.hh"
+
+#include <algorithm>
+#include <cstddef>
 #include <memory>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 
+//! \brief A range of bytes in shared, immutable storage.
+//! \details Copying a Buffer, or taking a slice of it with substr() or remove_prefix()/remove_suffix(), only
+//! bumps a reference count: the bytes themselves are never copied. An empty Buffer owns no storage. The storage
+//! comes from the PacketPool, and goes back to it when the last Buffer referring to it is gone.
 class Buffer
 {
-  std::shared_ptr<std::string> buffer_;
+  std::shared_ptr<const std::string> storage_ {};
+  size_t offset_ {};
+  size_t length_ {};
 
 public:
   // NOLINTBEGIN(*-explicit-*)
 
-  Buffer( std::string str = {} ) : buffer_( make_shared<std::string>( std::move( str ) ) ) {}
-  operator std::string_view() const { return *buffer_; }
-  operator std::string&() { return *buffer_; }
+  Buffer( std::string str = {} )
+    : storage_( str.empty() ? nullptr : PacketPool::share( std::move( str ) ) )
+    , length_( storage_ ? storage_->size() : 0 )
+  {}
+  operator std::string_view() const { return { data(), length_ }; }
+  operator std::string() const { return std::string { std::string_view { *this } }; }
 
   // NOLINTEND(*-explicit-*)
 
-  std::string&& release() { return std::move( *buffer_ ); }
-  size_t size() const { return buffer_->size(); }
-  size_t length() const { return buffer_->length(); }
-  bool empty() const { return buffer_->empty(); }
+  const char* data() const { return storage_ ? storage_->data() + offset_ : nullptr; }
+  size_t size() const { return length_; }
+  size_t length() const { return length_; }
+  bool empty() const { return length_ == 0; }
+
+  //! A Buffer of (at most) `len` bytes starting at `pos`, sharing this one's storage
+  Buffer substr( const size_t pos, const size_t len = std::string::npos ) const
+  {
+    if ( pos > length_ ) {
+      throw std::out_of_range( "Buffer::substr: position past the end" );
+    }
+    Buffer slice { *this };
+    slice.offset_ += pos;
+    slice.length_ = std::min( len, length_ - pos );
+    return slice;
+  }
+
+  //! Drop the first `n` bytes (at most all of them) from this Buffer's view
+  void remove_prefix( const size_t n )
+  {
+    const size_t count = std::min( n, length_ );
+    offset_ += count;
+    length_ -= count;
+  }
+
+  //! Drop the last `n` bytes (at most all of them) from this Buffer's view
+  void remove_suffix( const size_t n ) { length_ -= std::min( n, length_ ); }
+
+  //! \brief Writable access to this Buffer's bytes (e.g. to rewrite a header field in place).
+  //! \details If any other Buffer shares the storage, the bytes are first copied into storage of this Buffer's
+  //! own, so that the others never see the change.
+  char* mutable_data()
+  {
+    if ( storage_ and storage_.use_count() > 1 ) {
+      std::string copy = PacketPool::take( length_ );
+      copy.assign( data(), length_ );
+      *this = Buffer { std::move( copy ) };
+    }
+    // (the storage is never created const, only shared as const)
+    return storage_ ? const_cast<char*>( storage_->data() ) + offset_ : nullptr; // NOLINT(*-const-cast)
+  }
 };
@@ -0,0 +1,152 @@
+#include "checksum.hh"
+
+#include <array>
+#include <bit>
+#include <cstring>
+
+#if defined( __x86_64__ )
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// The ones'-complement sum does not depend on byte order (RFC 1071, section 2), so data is summed as native
+// (little-endian) words, and the folded result is byte-swapped into network order at the end.
+
+// Sum `data` as 16-bit words in native byte order, where an odd final byte is the first byte of a word.
+// The result has not been folded.
+using SumFunction = uint64_t ( * )( const char* data, size_t len );
+
+// Fold a sum to 16 bits (without inverting it)
+static uint16_t fold( uint64_t sum )
+{
+  while ( sum > 0xffff ) {
+    sum = ( sum >> 16 ) + static_cast<uint16_t>( sum );
+  }
+  return static_cast<uint16_t>( sum );
+}
+
+// Add two 64-bit values, wrapping the carry around (ones'-complement addition)
+static uint64_t add_with_carry( uint64_t a, uint64_t b )
+{
+  a += b;
+  return a + ( a < b );
+}
+
+static uint64_t sum_scalar( const char* data, size_t len )
+{
+  uint64_t sum = 0;
+  uint64_t word {};
+  for ( ; len >= sizeof( word ); data += sizeof( word ), len -= sizeof( word ) ) {
+    memcpy( &word, data, sizeof( word ) ); // the data need not be aligned
+    sum = add_with_carry( sum, word );
+  }
+  word = 0;
+  memcpy( &word, data, len );
+  return add_with_carry( sum, word );
+}
+
+#if defined( __x86_64__ )
+
+// Each 32-bit lane of an accumulator gains at most 2 * 0xffff per block, so it can take this many blocks
+static constexpr size_t BLOCKS_BEFORE_OVERFLOW = 0x8000;
+
+static uint64_t sum_sse2( const char* data, size_t len )
+{
+  constexpr size_t block = sizeof( __m128i );
+  const __m128i zero = _mm_setzero_si128();
+  uint64_t sum = 0;
+
+  while ( len >= block ) {
+    __m128i acc = zero;
+    for ( size_t i = 0; i < BLOCKS_BEFORE_OVERFLOW and len >= block; ++i, data += block, len -= block ) {
+      const __m128i v = _mm_loadu_si128( reinterpret_cast<const __m128i*>( data ) ); // NOLINT(*-reinterpret-cast)
+      acc = _mm_add_epi32( acc, _mm_add_epi32( _mm_unpacklo_epi16( v, zero ), _mm_unpackhi_epi16( v, zero ) ) );
+    }
+    alignas( block ) array<uint32_t, block / sizeof( uint32_t )> lanes {};
+    _mm_store_si128( reinterpret_cast<__m128i*>( lanes.data() ), acc ); // NOLINT(*-reinterpret-cast)
+    for ( const uint32_t lane : lanes ) {
+      sum += lane;
+    }
+  }
+
+  return add_with_carry( sum, sum_scalar( data, len ) );
+}
+
+__attribute__( ( target( "avx2" ) ) ) static uint64_t sum_avx2( const char* data, size_t len )
+{
+  constexpr size_t block = sizeof( __m256i );
+  const __m256i zero = _mm256_setzero_si256();
+  uint64_t sum = 0;
+
+  while ( len >= block ) {
+    __m256i acc = zero;
+    for ( size_t i = 0; i < BLOCKS_BEFORE_OVERFLOW and len >= block; ++i, data += block, len -= block ) {
+      // NOLINTNEXTLINE(*-reinterpret-cast)
+      const __m256i v = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( data ) );
+      const __m256i lo = _mm256_unpacklo_epi16( v, zero );
+      const __m256i hi = _mm256_unpackhi_epi16( v, zero );
+      acc = _mm256_add_epi32( acc, _mm256_add_epi32( lo, hi ) );
+    }
+    alignas( block ) array<uint32_t, block / sizeof( uint32_t )> lanes {};
+    _mm256_store_si256( reinterpret_cast<__m256i*>( lanes.data() ), acc ); // NOLINT(*-reinterpret-cast)
+    for ( const uint32_t lane : lanes ) {
+      sum += lane;
+    }
+  }
+
+  return add_with_carry( sum, sum_sse2( data, len ) );
+}
+
+#endif
+
+struct Implementation
+{
+  SumFunction sum;
+  string_view name;
+};
+
+static Implementation select_implementation()
+{
+#if defined( __x86_64__ )
+  if ( __builtin_cpu_supports( "avx2" ) ) {
+    return { sum_avx2, "avx2" };
+  }
+  return { sum_sse2, "sse2" };
+#else
+  return { sum_scalar, "scalar" };
+#endif
+}
+
+// The implementation is chosen on first use (not during static initialization, which may come too late)
+static const Implementation& selected()
+{
+  static const Implementation impl = select_implementation();
+  return impl;
+}
+
+void InternetChecksum::add( string_view data )
+{
+  if ( data.empty() ) {
+    return;
+  }
+
+  // finish the word whose first byte came at the end of the previous call
+  if ( parity_ ) {
+    sum_ += static_cast<uint8_t>( data.front() );
+    data.remove_prefix( 1 );
+    parity_ = false;
+  }
+
+  uint16_t partial = fold( selected().sum( data.data(), data.size() ) );
+  if constexpr ( endian::native == endian::little ) {
+    partial = static_cast<uint16_t>( ( partial >> 8 ) | ( partial << 8 ) );
+  }
+  sum_ += partial;
+  parity_ = data.size() % 2;
+}
+
+string_view InternetChecksum::implementation()
+{
+  return selected().name;
+}
@@ -4,32 +4,25 @@
 
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 
 //! The internet checksum algorithm
+//! \details Data is summed a word (or a vector register) at a time, using the fastest implementation that the CPU
+//! supports. Successive calls to add() behave as if their arguments had been concatenated, whatever their lengths.
 class InternetChecksum
 {
 private:
-  uint32_t sum_;
-  bool parity_ {};
+  uint64_t sum_;
+  bool parity_ {}; // has an odd number of bytes been added so far?
 
 public:
   explicit InternetChecksum( const uint32_t sum = 0 ) : sum_( sum ) {}
-  void add( std::string_view data )
-  {
-    for ( const uint8_t i : data ) {
-      uint16_t val = i;
-      if ( not parity_ ) {
-        val <<= 8;
-      }
-      sum_ += val;
-      parity_ = !parity_;
-    }
-  }
+  void add( std::string_view data );
 
   uint16_t value() const
   {
-    uint32_t ret = sum_;
+    uint64_t ret = sum_;
 
     while ( ret > 0xffff ) {
       ret = ( ret >> 16 ) + static_cast<uint16_t>( ret );
@@ -44,4 +37,27 @@ public:
       add( x );
     }
   }
+
+  //! Update `cksum` for a 16-bit word of the checksummed data changing from `old_word` to `new_word`, in O(1)
+  //! instead of summing all the data again ([RFC 1624](\ref rfc::rfc1624), eqn. 3)
+  static uint16_t adjust( const uint16_t cksum, const uint16_t old_word, const uint16_t new_word )
+  {
+    uint32_t sum = static_cast<uint16_t>( ~cksum );
+    sum += static_cast<uint16_t>( ~old_word );
+    sum += new_word;
+    while ( sum > 0xffff ) {
+      sum = ( sum >> 16 ) + static_cast<uint16_t>( sum );
+    }
+    return ~sum;
+  }
+
+  //! Update `cksum` for a 32-bit field (e.g. an address) starting at an even offset changing value
+  static uint16_t adjust32( const uint16_t cksum, const uint32_t old_field, const uint32_t new_field )
+  {
+    const uint16_t high = adjust( cksum, old_field >> 16, new_field >> 16 );
+    return adjust( high, static_cast<uint16_t>( old_field ), static_cast<uint16_t>( new_field ) );
+  }
+
+  //! Name of the implementation selected for this CPU ("avx2", "sse2" or "scalar")
+  static std::string_view implementation();
 };
@@ -0,0 +1,39 @@
+#include "decoded_frame.hh"
+
+using namespace std;
+
+//! Parse `payload` as a `Message`; null if it does not parse
+template<class Message>
+static unique_ptr<const Message> parse_payload( const vector<Buffer>& payload )
+{
+  auto message = make_unique<Message>();
+  if ( not parse( *message, payload ) ) {
+    return nullptr;
+  }
+  return message;
+}
+
+void DecodedFrame::decode()
+{
+  if ( decoded_ ) {
+    return;
+  }
+  decoded_ = true;
+  if ( frame_.header.type == EthernetHeader::TYPE_IPv4 ) {
+    ipv4_ = parse_payload<InternetDatagram>( frame_.payload );
+  } else if ( frame_.header.type == EthernetHeader::TYPE_ARP ) {
+    arp_ = parse_payload<ARPMessage>( frame_.payload );
+  }
+}
+
+const InternetDatagram* DecodedFrame::ipv4()
+{
+  decode();
+  return ipv4_.get();
+}
+
+const ARPMessage* DecodedFrame::arp()
+{
+  decode();
+  return arp_.get();
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "arp_message.hh"
+#include "ethernet_frame.hh"
+#include "ipv4_datagram.hh"
+
+#include <memory>
+
+//! \brief An EthernetFrame together with its payload, decoded only when ipv4() or arp() asks for it.
+//! \details The result (or the failure) is kept, so a frame that is dropped on its header alone never pays for a
+//! decode, and one that is looked at twice pays only once. The decode belongs to this object alone: it is not
+//! copied, nor shared between threads. The frame must outlive it, and must not change while it is in use.
+class DecodedFrame
+{
+  const EthernetFrame& frame_;
+  bool decoded_ {};
+  std::unique_ptr<const InternetDatagram> ipv4_ {};
+  std::unique_ptr<const ARPMessage> arp_ {};
+
+  //! Decode the payload as the message that the header says it is, unless that has been done already
+  void decode();
+
+public:
+  explicit DecodedFrame( const EthernetFrame& frame ) : frame_( frame ) {}
+  DecodedFrame( const DecodedFrame& other ) = delete;
+  DecodedFrame& operator=( const DecodedFrame& other ) = delete;
+
+  const EthernetFrame& frame() const { return frame_; }
+
+  //! The payload as an IPv4 datagram, or nullptr if the frame does not carry one that parses
+  const InternetDatagram* ipv4();
+
+  //! The payload as an ARP message, or nullptr if the frame does not carry one that parses
+  const ARPMessage* arp();
+};
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "header_layout.hh"
 #include "parser.hh"
 
 #include <array>
@@ -32,3 +33,10 @@ struct EthernetHeader
   void parse( Parser& parser );
   void serialize( Serializer& serializer ) const;
 };
+
+// Layout of the Ethernet header on the wire
+using EthernetHeaderLayout = HeaderLayout<EthernetHeader,
+                                          Field<"dst", &EthernetHeader::dst, 0, 6>,
+                                          Field<"src", &EthernetHeader::src, 6, 6>,
+                                          Field<"type", &EthernetHeader::type, 12, 2>>;
+static_assert( EthernetHeaderLayout::LENGTH == EthernetHeader::LENGTH );
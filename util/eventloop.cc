@@ -2,12 +2,27 @@
 #include "exception.hh"
 #include "socket.hh"
 
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
 #include <cstring>
 #include <iomanip>
 #include <iostream>
+#include <sys/stat.h>
+#include <unordered_map>
 
 using namespace std;
 
+static constexpr uint16_t RECEIVE_BUFFERS = 16; // buffers that the io_uring may fill for each receive rule
+
+EventLoop::EventLoop( const Backend backend )
+{
+  _rule_categories.reserve( 64 );
+  if ( backend == Backend::IOUring and IOUring::available() ) {
+    _ring = make_unique<IOUring>();
+  }
+}
+
 unsigned int EventLoop::FDRule::service_count() const
 {
   return direction == Direction::In ? fd.read_count() : fd.write_count();
@@ -70,6 +85,237 @@ EventLoop::RuleHandle EventLoop::add_rule( const size_t category_id,
   return RuleHandle { _non_fd_rules.back() };
 }
 
+EventLoop::RuleHandle EventLoop::add_receive_rule( const size_t category_id,
+                                                   FileDescriptor& fd,
+                                                   const size_t max_size,
+                                                   const ReceiveCallbackT& callback,
+                                                   const InterestT& interest,
+                                                   const CallbackT& cancel )
+{
+  if ( category_id >= _rule_categories.size() ) {
+    throw out_of_range( "bad category_id" );
+  }
+
+  auto rule = make_shared<FDRule>(
+    BasicRule { category_id, interest, {} }, fd.duplicate(), Direction::In, cancel, [] { return false; } );
+  rule->receive = callback;
+  rule->max_size = max_size;
+
+  if ( _ring ) {
+    // the ring reads into buffers of its own, and the rule completes on their CQEs (see poll_with_ring)
+    struct stat fd_stat {};
+    CheckSystemCall( "fstat", fstat( fd.fd_num(), &fd_stat ) );
+    rule->multishot = S_ISSOCK( fd_stat.st_mode );
+    rule->buffer_group = new_buffer_group();
+    _ring->provide_buffers( rule->buffer_group, RECEIVE_BUFFERS, max_size );
+  } else {
+    // poll(2) says when fd is readable, and the callback reads it
+    rule->callback = [&this_rule = *rule, buffer = string {}]() mutable {
+      buffer.resize( this_rule.max_size );
+      const auto count_before = this_rule.fd.read_count();
+      this_rule.fd.read( buffer );
+      if ( this_rule.fd.read_count() != count_before and not buffer.empty() ) {
+        this_rule.receive( buffer );
+      }
+    };
+  }
+
+  _fd_rules.push_back( move( rule ) );
+  return RuleHandle { _fd_rules.back() };
+}
+
+list<shared_ptr<EventLoop::FDRule>>::iterator EventLoop::erase_fd_rule( list<shared_ptr<FDRule>>::iterator it )
+{
+  auto& this_rule = **it;
+  if ( _ring ) {
+    if ( this_rule.receive ) {
+      // give back the buffers of the reads not handed over, so that the group's removal takes them too
+      for ( const auto& completion : this_rule.received ) {
+        if ( const auto id = completion.buffer_id() ) {
+          _ring->recycle_buffer( this_rule.buffer_group, id.value() );
+        }
+      }
+      if ( this_rule.armed_token ) {
+        _ending_reads.emplace( this_rule.armed_token, this_rule.buffer_group ); // (removed once the read ends)
+      } else {
+        remove_buffer_group( this_rule.buffer_group );
+      }
+    }
+    if ( this_rule.armed_token ) {
+      _ring->prepare_cancel( this_rule.armed_token );
+    }
+    _ring->submit();
+  }
+  return _fd_rules.erase( it );
+}
+
+uint16_t EventLoop::new_buffer_group()
+{
+  if ( not _free_buffer_groups.empty() ) {
+    const uint16_t group = _free_buffer_groups.back();
+    _free_buffer_groups.pop_back();
+    return group;
+  }
+  if ( _buffer_groups_made > UINT16_MAX ) {
+    throw runtime_error( "EventLoop: out of io_uring buffer groups" );
+  }
+  return static_cast<uint16_t>( _buffer_groups_made++ );
+}
+
+void EventLoop::remove_buffer_group( const uint16_t buffer_group )
+{
+  const uint64_t token = ++_next_token;
+  _removing_groups.emplace( token, buffer_group );
+  _ring->prepare_remove_buffers( buffer_group, token );
+}
+
+bool EventLoop::reap_erased( const IOUring::Completion& completion )
+{
+  if ( const auto read = _ending_reads.find( completion.user_data ); read != _ending_reads.end() ) {
+    const uint16_t group = read->second;
+    if ( const auto id = completion.buffer_id() ) {
+      _ring->recycle_buffer( group, id.value() ); // (nobody wants the datagram now)
+    }
+    if ( not completion.more() ) {
+      _ending_reads.erase( read );
+      remove_buffer_group( group );
+    }
+    return true;
+  }
+  if ( const auto removal = _removing_groups.find( completion.user_data ); removal != _removing_groups.end() ) {
+    _ring->release_buffers( removal->second );
+    _free_buffer_groups.push_back( removal->second );
+    _removing_groups.erase( removal );
+    return true;
+  }
+  return false;
+}
+
+// NOLINTBEGIN(*-signed-bitwise)
+int EventLoop::poll_with_ring( vector<pollfd>& pollfds, const int timeout_ms )
+{
+  // a receive rule keeps a read armed instead, while it wants datagrams and has none waiting to be handed over
+  const auto arm_reads = [&] {
+    size_t idx = 0;
+    for ( const auto& rule : _fd_rules ) {
+      const auto& this_pollfd = pollfds.at( idx++ );
+      if ( rule->receive and not rule->armed_token and this_pollfd.events and rule->received.empty() ) {
+        rule->armed_token = ++_next_token;
+        if ( rule->multishot ) {
+          _ring->prepare_recv_multishot( rule->fd, rule->buffer_group, rule->armed_token );
+        } else {
+          _ring->prepare_read_select( rule->fd, rule->buffer_group, rule->armed_token );
+        }
+      }
+    }
+  };
+  arm_reads();
+
+  // (re-)arm a poll request for each rule whose previous request has fired or asks for different events
+  size_t idx = 0;
+  for ( const auto& rule : _fd_rules ) {
+    auto& this_pollfd = pollfds.at( idx++ );
+    if ( rule->receive ) {
+      continue;
+    }
+    if ( rule->armed_token and rule->armed_events == this_pollfd.events ) {
+      continue;
+    }
+    if ( rule->armed_token ) {
+      _ring->prepare_cancel( rule->armed_token );
+    }
+    rule->armed_token = ++_next_token;
+    rule->armed_events = this_pollfd.events;
+    _ring->prepare_poll( this_pollfd.fd, this_pollfd.events, rule->armed_token );
+  }
+
+  _ring->submit(); // requests for fds that are already ready complete right away
+
+  const auto deadline = chrono::steady_clock::now() + chrono::milliseconds( timeout_ms );
+  unordered_map<uint64_t, int16_t> fired;
+  while ( true ) {
+    // completions of cancelled requests and of the cancellations themselves don't match any rule
+    _ring->reap( [&]( const IOUring::Completion& completion ) {
+      if ( completion.user_data == 0 or reap_erased( completion ) or completion.result == -ECANCELED ) {
+        return;
+      }
+      const auto reader = ranges::find_if( _fd_rules, [&]( const auto& rule ) {
+        return rule->receive and rule->armed_token == completion.user_data;
+      } );
+      if ( reader != _fd_rules.end() ) {
+        auto& rule = **reader;
+        if ( not completion.more() ) {
+          rule.armed_token = 0; // re-armed on the next call (once its datagrams are handed over)
+        }
+        if ( completion.result != -ENOBUFS and completion.result != -EAGAIN ) {
+          rule.received.push_back( completion );
+        }
+        return;
+      }
+      if ( completion.result < 0 ) {
+        fired[completion.user_data] = completion.result == -EBADF ? POLLNVAL : POLLERR;
+      } else {
+        fired[completion.user_data] = static_cast<int16_t>( completion.result );
+      }
+    } );
+
+    int ready = 0;
+    idx = 0;
+    for ( const auto& rule : _fd_rules ) {
+      auto& this_pollfd = pollfds.at( idx++ );
+      if ( rule->receive ) {
+        if ( this_pollfd.events and not rule->received.empty() ) {
+          this_pollfd.revents = POLLIN;
+          ++ready;
+        }
+        continue;
+      }
+      const auto completion = fired.find( rule->armed_token );
+      if ( rule->armed_token and completion != fired.end() ) {
+        this_pollfd.revents = completion->second;
+        rule->armed_token = 0; // poll requests are one-shot
+        ++ready;
+      }
+    }
+    if ( ready ) {
+      return ready;
+    }
+
+    int remaining_ms = timeout_ms;
+    if ( timeout_ms >= 0 ) {
+      remaining_ms = static_cast<int>(
+        chrono::ceil<chrono::milliseconds>( deadline - chrono::steady_clock::now() ).count() );
+      if ( remaining_ms <= 0 ) {
+        return 0;
+      }
+    }
+    arm_reads(); // a read that ended without data (e.g. out of buffers) must not leave its rule unarmed
+    if ( not _ring->wait( remaining_ms ) ) {
+      return 0;
+    }
+  }
+}
+// NOLINTEND(*-signed-bitwise)
+
+bool EventLoop::deliver_received( FDRule& rule )
+{
+  while ( not rule.received.empty() and rule.interest() ) {
+    const IOUring::Completion completion = rule.received.front();
+    rule.received.pop_front();
+    if ( completion.result == 0 ) {
+      return false; // EOF
+    }
+    if ( completion.result < 0 ) {
+      cerr << "error reading for rule \"" << _rule_categories.at( rule.category_id ).name
+           << "\": " << strerror( -completion.result ) << "\n";
+      return false;
+    }
+    rule.receive( _ring->provided_buffer( rule.buffer_group, completion ) );
+    _ring->recycle_buffer( rule.buffer_group, completion.buffer_id().value() );
+  }
+  return true;
+}
+
 void EventLoop::RuleHandle::cancel()
 {
   const shared_ptr<BasicRule> rule_shared_ptr = rule_weak_ptr_.lock();
@@ -126,20 +372,20 @@ EventLoop::Result EventLoop::wait_next_event( const int timeout_ms )
       //      this_rule.cancel();
       //      if rule is cancelled externally, no need to call the cancellation callback
       //      this makes it easier to cancel rules and delete captured objects right away
-      it = _fd_rules.erase( it );
+      it = erase_fd_rule( it );
       continue;
     }
 
     if ( this_rule.direction == Direction::In && this_rule.fd.eof() ) {
       // no more reading on this rule, it's reached eof
       this_rule.cancel();
-      it = _fd_rules.erase( it );
+      it = erase_fd_rule( it );
       continue;
     }
 
     if ( this_rule.fd.closed() ) {
       this_rule.cancel();
-      it = _fd_rules.erase( it );
+      it = erase_fd_rule( it );
       continue;
     }
 
@@ -158,7 +404,9 @@ EventLoop::Result EventLoop::wait_next_event( const int timeout_ms )
   }
 
   // call poll -- wait until one of the fds satisfies one of the rules (writeable/readable)
-  if ( 0 == CheckSystemCall( "poll", ::poll( pollfds.data(), pollfds.size(), timeout_ms ) ) ) {
+  const int ready = _ring ? poll_with_ring( pollfds, timeout_ms )
+                          : CheckSystemCall( "poll", ::poll( pollfds.data(), pollfds.size(), timeout_ms ) );
+  if ( 0 == ready ) {
     return Result::Timeout;
   }
 
@@ -194,7 +442,7 @@ EventLoop::Result EventLoop::wait_next_event( const int timeout_ms )
       }
 
       this_rule.cancel();
-      it = _fd_rules.erase( it );
+      it = erase_fd_rule( it );
       continue;
     }
 
@@ -206,10 +454,19 @@ EventLoop::Result EventLoop::wait_next_event( const int timeout_ms )
       //   - if it was POLLOUT, it will not be writable again
       // additionally, consider FD defunct if rule will only query for Direction::Out
       this_rule.cancel();
-      it = _fd_rules.erase( it );
+      it = erase_fd_rule( it );
       continue;
     }
 
+    if ( poll_ready and _ring and this_rule.receive ) {
+      // the io_uring has already read the datagrams
+      if ( not deliver_received( this_rule ) ) {
+        this_rule.cancel();
+        erase_fd_rule( it );
+      }
+      return Result::Success;
+    }
+
     if ( poll_ready ) {
       // we only want to call callback if revents includes the event we asked for
       const auto count_before = this_rule.service_count();
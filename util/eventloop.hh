@@ -1,13 +1,17 @@
 #pragma once
 
+#include <deque>
 #include <functional>
 #include <list>
 #include <memory>
 #include <ostream>
 #include <poll.h>
 #include <string_view>
+#include <unordered_map>
+#include <vector>
 
 #include "file_descriptor.hh"
+#include "io_uring.hh"
 
 //! Waits for events on file descriptors and executes corresponding callbacks.
 class EventLoop
@@ -20,6 +24,17 @@ public:
     Out = POLLOUT //!< Callback will be triggered when Rule::fd is writable.
   };
 
+  //! How the EventLoop waits for file descriptors to become ready.
+  enum class Backend
+  {
+    Poll,   //!< One [poll(2)](\ref man2::poll) per call to wait_next_event.
+    IOUring //!< Poll requests stay armed in an io_uring between calls and complete as CQEs; receive rules
+            //!< read through the io_uring too.
+  };
+
+  //! Callback of a receive rule: takes the bytes of one datagram read from the rule's fd.
+  using ReceiveCallbackT = std::function<void( std::string_view )>;
+
 private:
   using CallbackT = std::function<void( void )>;
   using InterestT = std::function<bool( void )>;
@@ -46,6 +61,15 @@ private:
     CallbackT cancel;    //!< A callback that is called when the rule is cancelled (e.g. on hangup)
     InterestT recover;   //!< A callback that is called when the fd is ERR. Returns true to keep rule.
 
+    uint64_t armed_token {}; //!< user_data of the poll (or read) request armed in the io_uring (0 if none)
+    int16_t armed_events {}; //!< Events that the armed poll request is waiting for
+
+    ReceiveCallbackT receive {}; //!< For a receive rule: takes each datagram read from fd
+    size_t max_size {};          //!< For a receive rule: the longest datagram that it reads
+    uint16_t buffer_group {};    //!< For a receive rule on the io_uring: the group of its provided buffers
+    bool multishot {};           //!< For a receive rule on the io_uring: is fd a socket, read by a multishot recv?
+    std::deque<IOUring::Completion> received {}; //!< For a receive rule on the io_uring: reads not handed over yet
+
     FDRule( BasicRule&& base,
             FileDescriptor&& s_fd,
             Direction s_direction,
@@ -61,8 +85,45 @@ private:
   std::list<std::shared_ptr<FDRule>> _fd_rules {};
   std::list<std::shared_ptr<BasicRule>> _non_fd_rules {};
 
+  std::unique_ptr<IOUring> _ring {}; //!< Set when the io_uring backend is in use
+  uint64_t _next_token {};           //!< Last user_data handed out for an io_uring request
+
+  //! \name
+  //! Groups of provided buffers, one for each receive rule on the io_uring. An erased rule's group is taken back
+  //! from the kernel once the rule's read has ended, and its number is reused once that is done.
+
+  //!@{
+  uint32_t _buffer_groups_made {};                            //!< Groups numbered so far (up to 2^16)
+  std::vector<uint16_t> _free_buffer_groups {};               //!< Groups taken back, free for reuse
+  std::unordered_map<uint64_t, uint16_t> _ending_reads {};    //!< Reads of erased rules (token to group)
+  std::unordered_map<uint64_t, uint16_t> _removing_groups {}; //!< Removals under way (token to group)
+  //!@}
+
+  //! A free group of provided buffers
+  uint16_t new_buffer_group();
+
+  //! Take a group's buffers back from the kernel, then make it free
+  void remove_buffer_group( uint16_t buffer_group );
+
+  //! Handle a completion of an erased rule's read, or of a group's removal; false if it is neither
+  bool reap_erased( const IOUring::Completion& completion );
+
+  //! Erase an FDRule, cancelling its armed poll request or read (if any).
+  std::list<std::shared_ptr<FDRule>>::iterator erase_fd_rule( std::list<std::shared_ptr<FDRule>>::iterator it );
+
+  //! Fill in each pollfd's revents using the io_uring; returns the number of ready fds (0 on timeout).
+  int poll_with_ring( std::vector<pollfd>& pollfds, int timeout_ms );
+
+  //! Hand the datagrams that the io_uring has read for a receive rule to its callback; false if the fd is done.
+  bool deliver_received( FDRule& rule );
+
 public:
-  EventLoop() { _rule_categories.reserve( 64 ); }
+  //! \param[in] backend is the requested way of waiting; Backend::IOUring falls back to Backend::Poll
+  //! if io_uring is unavailable at runtime.
+  explicit EventLoop( Backend backend = Backend::Poll );
+
+  //! The backend actually in use.
+  Backend backend() const { return _ring ? Backend::IOUring : Backend::Poll; }
 
   //! Returned by each call to EventLoop::wait_next_event.
   enum class Result
@@ -101,7 +162,19 @@ public:
     const CallbackT& callback,
     const InterestT& interest = [] { return true; } );
 
-  //! Calls [poll(2)](\ref man2::poll) and then executes callback for each ready fd.
+  //! \brief Add a rule that reads datagrams of up to `max_size` bytes from `fd` and hands each to `callback`.
+  //! \details With Backend::IOUring, the reads themselves are queued in the io_uring (a multishot recv if `fd` is
+  //! a socket, otherwise one read at a time) into buffers that the kernel picks, and the rule completes on their
+  //! CQEs, with no poll and no read syscall per datagram. With Backend::Poll, `fd` is read once it is readable.
+  RuleHandle add_receive_rule(
+    size_t category_id,
+    FileDescriptor& fd,
+    size_t max_size,
+    const ReceiveCallbackT& callback,
+    const InterestT& interest = [] { return true; },
+    const CallbackT& cancel = [] {} );
+
+  //! Calls [poll(2)](\ref man2::poll) (or waits on the io_uring) and then executes callback for each ready fd.
   Result wait_next_event( int timeout_ms );
 
   // convenience function to add category and rule at the same time
@@ -110,6 +183,12 @@ public:
   {
     return add_rule( add_category( name ), std::forward<Targs>( Fargs )... );
   }
+
+  template<typename... Targs>
+  auto add_receive_rule( const std::string& name, Targs&&... Fargs )
+  {
+    return add_receive_rule( add_category( name ), std::forward<Targs>( Fargs )... );
+  }
 };
 
 using Direction = EventLoop::Direction;
@@ -39,4 +39,8 @@ public:
 
   //! Called periodically when time elapses
   void tick( const size_t unused [[maybe_unused]] ) {}
+
+  //! Called once the configuration (and listening flag) describe the connection, so that an adapter sharing its
+  //! device with other sockets can claim it
+  void claim_flow() {}
 };
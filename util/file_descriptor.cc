@@ -1,6 +1,7 @@
 #include "file_descriptor.hh"
 
 #include "exception.hh"
+#include "packet_pool.hh"
 
 #include <algorithm>
 #include <fcntl.h>
@@ -36,6 +37,10 @@ T FileDescriptor::CheckSystemCall( std::string_view s_attempt, T return_value )
   return internal_fd_->CheckSystemCall( s_attempt, return_value );
 }
 
+// (the adapters and sockets check their own system calls; in an optimized build, the uses here are all inlined)
+template int FileDescriptor::CheckSystemCall( std::string_view, int ) const;
+template ssize_t FileDescriptor::CheckSystemCall( std::string_view, ssize_t ) const;
+
 // fd is the file descriptor number returned by [open(2)](\ref man2::open) or similar
 FileDescriptor::FDWrapper::FDWrapper( int fd ) : fd_( fd )
 {
@@ -83,7 +88,9 @@ FileDescriptor FileDescriptor::duplicate() const
 void FileDescriptor::read( string& buffer )
 {
   if ( buffer.empty() ) {
-    buffer.clear();
+    if ( buffer.capacity() < kReadBufferSize ) {
+      buffer = PacketPool::take( kReadBufferSize );
+    }
     buffer.resize( kReadBufferSize );
   }
 
@@ -114,8 +121,12 @@ void FileDescriptor::read( vector<string>& buffers )
     return;
   }
 
-  buffers.back().clear();
-  buffers.back().resize( kReadBufferSize );
+  if ( buffers.back().empty() ) {
+    if ( buffers.back().capacity() < kReadBufferSize ) {
+      buffers.back() = PacketPool::take( kReadBufferSize );
+    }
+    buffers.back().resize( kReadBufferSize );
+  }
 
   vector<iovec> iovecs;
   iovecs.reserve( buffers.size() );
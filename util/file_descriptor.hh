@@ -62,8 +62,9 @@ public:
   // Free the std::shared_ptr; the FDWrapper destructor calls close() when the refcount goes to zero.
   ~FileDescriptor() = default;
 
-  // Read into `buffer`
+  // Read into `buffer` (if it is empty, into kReadBufferSize bytes of room)
   void read( std::string& buffer );
+  // Read into `buffers` in turn (if the last one is empty, it gets kReadBufferSize bytes of room)
   void read( std::vector<std::string>& buffers );
 
   // Attempt to write a buffer
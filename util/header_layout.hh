@@ -0,0 +1,211 @@
+#pragma once
+
+#include "parser.hh"
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+//! A field's name, given as a string literal template argument
+template<size_t N>
+struct FieldName
+{
+  std::array<char, N> chars {};
+
+  // NOLINTNEXTLINE(*-explicit-*, *-avoid-c-arrays)
+  constexpr FieldName( const char ( &str )[N] ) { std::copy_n( str, N, chars.begin() ); }
+
+  constexpr std::string_view view() const { return { chars.data(), N - 1 }; }
+};
+
+//! \brief One field of a fixed-layout header.
+//! \details The member `Member` (an unsigned integer, a bool, or an array of bytes) is stored in the big-endian
+//! `Width`-byte word at byte `Offset` of the header. An integer or bool can occupy just `Bits` of the word's bits,
+//! starting `Shift` bits up from its least significant bit (as in a packed bitfield), in which case it is
+//! truncated to fit. An array of bytes is stored as is, and its `Width` is its size.
+template<FieldName Name, auto Member, size_t Offset, size_t Width, size_t Shift = 0, size_t Bits = Width * 8>
+struct Field
+{
+private:
+  template<class M>
+  struct MemberPointer;
+
+  template<class H, class T>
+  struct MemberPointer<T H::*>
+  {
+    using Header = H;
+    using Type = T;
+  };
+
+  using Type = typename MemberPointer<decltype( Member )>::Type;
+
+  static constexpr bool IS_BYTES = std::is_same_v<Type, std::array<uint8_t, Width>>;
+
+  static_assert( IS_BYTES or ( std::unsigned_integral<Type> and ( Width == 1 or Width == 2 or Width == 4 ) ),
+                 "a field is an unsigned integer or bool in a 1-, 2- or 4-byte word, or an array of bytes" );
+  static_assert( Bits > 0 and Shift + Bits <= Width * 8, "a field's bits must lie within its word" );
+
+  // (the word the field is stored in)
+  using Word = std::conditional_t<Width == 1, uint8_t, std::conditional_t<Width == 2, uint16_t, uint32_t>>;
+  static constexpr uint32_t MASK = Bits >= 32 ? 0xffff'ffffU : ( 1U << Bits ) - 1;
+
+public:
+  using Header = typename MemberPointer<decltype( Member )>::Header;
+
+  static constexpr std::string_view NAME = Name.view();
+  static constexpr size_t OFFSET = Offset;
+  static constexpr size_t WIDTH = Width;
+  static constexpr size_t SHIFT = Shift;
+  static constexpr size_t BITS = IS_BYTES ? Width * 8 : Bits;
+
+  static void load( Header& header, const char* raw ) { header.*Member = get( raw ); }
+
+  //! The field's value in the header at `raw`, read on its own
+  static Type get( const char* raw )
+  {
+    if constexpr ( IS_BYTES ) {
+      Type bytes {};
+      std::copy_n( raw + Offset, Width, bytes.begin() );
+      return bytes;
+    } else {
+      return static_cast<Type>( ( load_big_endian<Word>( raw + Offset ) >> Shift ) & MASK );
+    }
+  }
+
+  //! Overwrite the field in the header at `raw`, leaving the other bits of its word alone
+  static void set( char* raw, const Type& value )
+  {
+    if constexpr ( IS_BYTES ) {
+      std::copy_n( value.begin(), Width, raw + Offset );
+    } else {
+      const uint32_t others = load_big_endian<Word>( raw + Offset ) & ~( MASK << Shift );
+      const uint32_t bits = ( static_cast<uint32_t>( value ) & MASK ) << Shift;
+      store_big_endian( raw + Offset, static_cast<Word>( others | bits ) );
+    }
+  }
+
+  //! Store the field, combining it with whatever other fields of its word have already been stored
+  static void store( const Header& header, char* raw )
+  {
+    if constexpr ( IS_BYTES ) {
+      std::copy_n( ( header.*Member ).begin(), Width, raw + Offset );
+    } else {
+      const uint32_t bits = ( static_cast<uint32_t>( header.*Member ) & MASK ) << Shift;
+      store_big_endian( raw + Offset, static_cast<Word>( load_big_endian<Word>( raw + Offset ) | bits ) );
+    }
+  }
+
+  static void print( const Header& header, std::ostream& out )
+  {
+    out << NAME << "=";
+    if constexpr ( IS_BYTES ) {
+      const auto& bytes = header.*Member;
+      for ( size_t i = 0; i < bytes.size(); i++ ) {
+        out << ( i ? ":" : "" ) << std::hex << ( bytes[i] < 16 ? "0" : "" ) << +bytes[i] << std::dec;
+      }
+    } else if constexpr ( std::is_same_v<Type, bool> ) {
+      out << std::boolalpha << header.*Member;
+    } else {
+      out << +( header.*Member );
+    }
+  }
+};
+
+//! \brief The layout of a fixed-length header, described once as a list of its Fields.
+//! \details From the description, this generates the code to load the header from (and store it to) its
+//! LENGTH bytes on the wire, a word at a time, along with to_string(). Fields must not overlap (this is checked at
+//! compile time); bits that no field covers (reserved or padding bits) are written as zero and ignored when read.
+template<class Header, class... Fields>
+struct HeaderLayout
+{
+  static_assert( ( std::is_same_v<Header, typename Fields::Header> and ... ),
+                 "every field must be a member of the header" );
+
+  static constexpr size_t LENGTH = std::max( { Fields::OFFSET + Fields::WIDTH... } );
+
+  static constexpr uint64_t serialized_length() { return LENGTH; }
+
+private:
+  static constexpr bool fields_overlap()
+  {
+    std::array<bool, LENGTH * 8> used {};
+    bool overlap = false;
+    auto mark = [&]( const size_t offset, const size_t width, const size_t shift, const size_t bits ) {
+      // (bit 0 is the most significant bit of the header's first byte)
+      const size_t first = ( offset + width ) * 8 - shift - bits;
+      for ( size_t bit = first; bit < first + bits; bit++ ) {
+        overlap = overlap or used.at( bit );
+        used.at( bit ) = true;
+      }
+    };
+    ( mark( Fields::OFFSET, Fields::WIDTH, Fields::SHIFT, Fields::BITS ), ... );
+    return overlap;
+  }
+
+  static_assert( not fields_overlap(), "fields of a header must not overlap" );
+
+  template<FieldName Name, class... Fs>
+  struct Find
+  {
+    static_assert( sizeof...( Fs ) > 0, "no field of the header has this name" );
+  };
+
+  template<FieldName Name, class F, class... Fs>
+  struct Find<Name, F, Fs...> : std::conditional_t<F::NAME == Name.view(), std::type_identity<F>, Find<Name, Fs...>>
+  {};
+
+public:
+  //! The field called `Name` (for reading or writing just that field, e.g. in a header that stays on the wire)
+  template<FieldName Name>
+  using field = typename Find<Name, Fields...>::type;
+
+  //! Read the header from its LENGTH bytes at `raw`
+  static void load( Header& header, const char* raw ) { ( Fields::load( header, raw ), ... ); }
+
+  //! Write the header to the LENGTH bytes at `raw`
+  static void store( const Header& header, char* raw )
+  {
+    std::fill_n( raw, LENGTH, 0 );
+    ( Fields::store( header, raw ), ... );
+  }
+
+  //! Parse the header, consuming its LENGTH bytes (or setting the parser's error flag if there are too few)
+  static void parse( Header& header, Parser& parser )
+  {
+    std::array<char, LENGTH> scratch {};
+    const std::string_view raw = parser.peek_fixed( scratch );
+    if ( parser.has_error() ) {
+      return;
+    }
+    load( header, raw.data() );
+    parser.remove_prefix( LENGTH );
+  }
+
+  static void serialize( const Header& header, Serializer& serializer )
+  {
+    std::array<char, LENGTH> raw {};
+    store( header, raw.data() );
+    serializer.string( { raw.data(), raw.size() } );
+  }
+
+  //! Every field, as "name=value" (integers in decimal, byte arrays in colon-separated hex)
+  static std::string to_string( const Header& header )
+  {
+    std::stringstream ss {};
+    bool first = true;
+    auto print = [&]<class F>( F /* field */ ) {
+      ss << ( first ? "" : ", " );
+      first = false;
+      F::print( header, ss );
+    };
+    ( print( Fields {} ), ... );
+    return ss.str();
+  }
+};
@@ -0,0 +1,381 @@
+#include "io_uring.hh"
+
+#include "exception.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <linux/io_uring.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+using namespace std;
+
+static int sys_io_uring_setup( const unsigned entries, io_uring_params* params )
+{
+  return static_cast<int>( syscall( __NR_io_uring_setup, entries, params ) ); // NOLINT(*-vararg)
+}
+
+static int sys_io_uring_enter( const int fd,
+                               const unsigned to_submit,
+                               const unsigned min_complete,
+                               const unsigned flags,
+                               const void* arg,
+                               const size_t argsz )
+{
+  // NOLINTNEXTLINE(*-vararg)
+  return static_cast<int>( syscall( __NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz ) );
+}
+
+static int sys_io_uring_register( const int fd, const unsigned opcode, const void* arg, const unsigned nr_args )
+{
+  return static_cast<int>( syscall( __NR_io_uring_register, fd, opcode, arg, nr_args ) ); // NOLINT(*-vararg)
+}
+
+// IOUring relies on a single mmap for both rings and on timed waits in io_uring_enter (Linux 5.11)
+static constexpr uint32_t REQUIRED_FEATURES = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_EXT_ARG | IORING_FEAT_NODROP;
+
+static int setup_ring( const unsigned entries, io_uring_params& params )
+{
+  params.flags |= IORING_SETUP_CLAMP;
+  const int fd = CheckSystemCall( "io_uring_setup", sys_io_uring_setup( entries, &params ) );
+  if ( ( params.features & REQUIRED_FEATURES ) != REQUIRED_FEATURES ) {
+    ::close( fd );
+    throw runtime_error( "io_uring: kernel lacks required features" );
+  }
+  return fd;
+}
+
+static size_t rings_length( const io_uring_params& params )
+{
+  return max( params.sq_off.array + params.sq_entries * sizeof( uint32_t ),
+              params.cq_off.cqes + params.cq_entries * sizeof( io_uring_cqe ) );
+}
+
+bool IOUring::available()
+{
+  static const bool result = [] {
+    try {
+      const IOUring probe { 1 };
+      return true;
+    } catch ( const exception& ) {
+      return false;
+    }
+  }();
+  return result;
+}
+
+bool IOUring::Completion::more() const
+{
+  return flags & IORING_CQE_F_MORE;
+}
+
+optional<uint16_t> IOUring::Completion::buffer_id() const
+{
+  if ( not( flags & IORING_CQE_F_BUFFER ) ) {
+    return {};
+  }
+  return static_cast<uint16_t>( flags >> IORING_CQE_BUFFER_SHIFT );
+}
+
+IOUring::Mapping::Mapping( const FileDescriptor& fd, const size_t length, const uint64_t offset )
+  : addr_( mmap( nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd.fd_num(), offset ) )
+  , length_( length )
+{
+  if ( addr_ == MAP_FAILED ) { // NOLINT(*-cstyle-cast, *-int-to-ptr)
+    throw unix_error { "mmap" };
+  }
+}
+
+IOUring::Mapping::~Mapping()
+{
+  munmap( addr_, length_ );
+}
+
+//! \param[in] entries is the requested size of the submission queue (the kernel rounds it up to a power of 2)
+IOUring::IOUring( const unsigned entries )
+  : params_( make_unique<io_uring_params>() )
+  , ring_fd_( setup_ring( entries, *params_ ) )
+  , rings_( ring_fd_, rings_length( *params_ ), IORING_OFF_SQ_RING )
+  , sqes_( ring_fd_, params_->sq_entries * sizeof( io_uring_sqe ), IORING_OFF_SQES )
+{
+  const auto& sq_off = params_->sq_off;
+  sq_head_ = rings_.at<uint32_t>( sq_off.head );
+  sq_tail_ = rings_.at<uint32_t>( sq_off.tail );
+  sq_mask_ = *rings_.at<uint32_t>( sq_off.ring_mask );
+  sq_entries_ = *rings_.at<uint32_t>( sq_off.ring_entries );
+  sq_array_ = rings_.at<uint32_t>( sq_off.array );
+
+  const auto& cq_off = params_->cq_off;
+  cq_head_ = rings_.at<uint32_t>( cq_off.head );
+  cq_tail_ = rings_.at<uint32_t>( cq_off.tail );
+  cq_mask_ = *rings_.at<uint32_t>( cq_off.ring_mask );
+  cqes_ = rings_.at<io_uring_cqe>( cq_off.cqes );
+}
+
+// Defined here, where io_uring_params is a complete type
+IOUring::~IOUring() = default;
+
+io_uring_sqe& IOUring::next_sqe()
+{
+  uint32_t tail = *sq_tail_;
+  if ( tail - __atomic_load_n( sq_head_, __ATOMIC_ACQUIRE ) >= sq_entries_ ) {
+    submit();
+    tail = *sq_tail_;
+    if ( tail - __atomic_load_n( sq_head_, __ATOMIC_ACQUIRE ) >= sq_entries_ ) {
+      throw runtime_error( "io_uring: submission queue full" );
+    }
+  }
+
+  const uint32_t index = tail & sq_mask_;
+  io_uring_sqe& sqe = sqes_.at<io_uring_sqe>( 0 )[index]; // NOLINT(*-pointer-arithmetic)
+  sqe = {};
+  sq_array_[index] = index; // NOLINT(*-pointer-arithmetic)
+  __atomic_store_n( sq_tail_, tail + 1, __ATOMIC_RELEASE );
+  ++to_submit_;
+  return sqe;
+}
+
+void IOUring::prepare_poll( const int fd, const int16_t events, const uint64_t user_data )
+{
+  io_uring_sqe& sqe = next_sqe();
+  sqe.opcode = IORING_OP_POLL_ADD;
+  sqe.fd = fd;
+  sqe.poll32_events = static_cast<uint16_t>( events );
+  sqe.user_data = user_data;
+}
+
+void IOUring::prepare_cancel( const uint64_t target_user_data )
+{
+  io_uring_sqe& sqe = next_sqe();
+  sqe.opcode = IORING_OP_ASYNC_CANCEL;
+  sqe.fd = -1;
+  sqe.addr = target_user_data;
+  sqe.user_data = 0;
+}
+
+void IOUring::prepare_read( const FileDescriptor& fd, const span<char> buffer, const uint64_t user_data )
+{
+  io_uring_sqe& sqe = next_sqe();
+  sqe.opcode = IORING_OP_READ;
+  sqe.fd = fd.fd_num();
+  sqe.addr = reinterpret_cast<uint64_t>( buffer.data() ); // NOLINT(*-reinterpret-cast)
+  sqe.len = buffer.size();
+  sqe.off = -1; // use (and advance) the file position, as read(2) would
+  sqe.user_data = user_data;
+}
+
+void IOUring::prepare_write( const FileDescriptor& fd, const string_view buffer, const uint64_t user_data )
+{
+  io_uring_sqe& sqe = next_sqe();
+  sqe.opcode = IORING_OP_WRITE;
+  sqe.fd = fd.fd_num();
+  sqe.addr = reinterpret_cast<uint64_t>( buffer.data() ); // NOLINT(*-reinterpret-cast)
+  sqe.len = buffer.size();
+  sqe.off = -1;
+  sqe.user_data = user_data;
+}
+
+void IOUring::prepare_read_fixed( const FileDescriptor& fd, const uint16_t buffer_index, const uint64_t user_data )
+{
+  string& buffer = fixed_buffers_.at( buffer_index );
+  io_uring_sqe& sqe = next_sqe();
+  sqe.opcode = IORING_OP_READ_FIXED;
+  sqe.fd = fd.fd_num();
+  sqe.addr = reinterpret_cast<uint64_t>( buffer.data() ); // NOLINT(*-reinterpret-cast)
+  sqe.len = buffer.size();
+  sqe.off = -1;
+  sqe.buf_index = buffer_index;
+  sqe.user_data = user_data;
+}
+
+void IOUring::prepare_write_fixed( const FileDescriptor& fd,
+                                   const uint16_t buffer_index,
+                                   const size_t len,
+                                   const uint64_t user_data )
+{
+  string& buffer = fixed_buffers_.at( buffer_index );
+  if ( len > buffer.size() ) {
+    throw out_of_range( "io_uring: write_fixed longer than registered buffer" );
+  }
+  io_uring_sqe& sqe = next_sqe();
+  sqe.opcode = IORING_OP_WRITE_FIXED;
+  sqe.fd = fd.fd_num();
+  sqe.addr = reinterpret_cast<uint64_t>( buffer.data() ); // NOLINT(*-reinterpret-cast)
+  sqe.len = len;
+  sqe.off = -1;
+  sqe.buf_index = buffer_index;
+  sqe.user_data = user_data;
+}
+
+//! \details The kernel keeps the receive armed, posting one completion (with IORING_CQE_F_MORE set) per
+//! datagram or chunk of stream data, each in a buffer chosen from `buffer_group`.
+void IOUring::prepare_recv_multishot( const FileDescriptor& fd,
+                                      const uint16_t buffer_group,
+                                      const uint64_t user_data )
+{
+  io_uring_sqe& sqe = next_sqe();
+  sqe.opcode = IORING_OP_RECV;
+  sqe.ioprio = IORING_RECV_MULTISHOT;
+  sqe.flags = IOSQE_BUFFER_SELECT;
+  sqe.fd = fd.fd_num();
+  sqe.buf_group = buffer_group;
+  sqe.user_data = user_data;
+}
+
+//! \details A one-shot read into a buffer chosen from `buffer_group`, for fds that a multishot recv cannot read
+//! because they are not sockets (e.g. TUN/TAP devices).
+void IOUring::prepare_read_select( const FileDescriptor& fd, const uint16_t buffer_group, const uint64_t user_data )
+{
+  const auto& group = provided_buffers_.at( buffer_group );
+  io_uring_sqe& sqe = next_sqe();
+  sqe.opcode = IORING_OP_READ;
+  sqe.flags = IOSQE_BUFFER_SELECT;
+  sqe.fd = fd.fd_num();
+  sqe.len = group.buffer_size;
+  sqe.off = -1;
+  sqe.buf_group = buffer_group;
+  sqe.user_data = user_data;
+}
+
+//! \details Takes back whichever of the group's buffers the kernel still holds (those not handed out in a
+//! completion, or since recycled). Their memory stays allocated until release_buffers().
+void IOUring::prepare_remove_buffers( const uint16_t buffer_group, const uint64_t user_data )
+{
+  const auto& group = provided_buffers_.at( buffer_group );
+  io_uring_sqe& sqe = next_sqe();
+  sqe.opcode = IORING_OP_REMOVE_BUFFERS;
+  sqe.fd = static_cast<int32_t>( group.storage.size() / group.buffer_size );
+  sqe.buf_group = buffer_group;
+  sqe.user_data = user_data;
+}
+
+void IOUring::register_buffers( const size_t count, const size_t size )
+{
+  if ( not fixed_buffers_.empty() ) {
+    throw runtime_error( "io_uring: buffers already registered" );
+  }
+
+  fixed_buffers_.resize( count );
+  vector<iovec> iovecs;
+  iovecs.reserve( count );
+  for ( auto& buffer : fixed_buffers_ ) {
+    buffer.resize( size );
+    iovecs.push_back( { buffer.data(), buffer.size() } );
+  }
+
+  CheckSystemCall(
+    "io_uring_register",
+    sys_io_uring_register( ring_fd_.fd_num(), IORING_REGISTER_BUFFERS, iovecs.data(), iovecs.size() ) );
+}
+
+void IOUring::provide_buffers( const uint16_t buffer_group, const uint16_t count, const size_t size )
+{
+  auto& group = provided_buffers_[buffer_group];
+  if ( not group.storage.empty() ) {
+    throw runtime_error( "io_uring: buffer group already provided" );
+  }
+  group.storage.resize( count * size );
+  group.buffer_size = size;
+
+  io_uring_sqe& sqe = next_sqe();
+  sqe.opcode = IORING_OP_PROVIDE_BUFFERS;
+  sqe.fd = count;
+  sqe.addr = reinterpret_cast<uint64_t>( group.storage.data() ); // NOLINT(*-reinterpret-cast)
+  sqe.len = size;
+  sqe.buf_group = buffer_group;
+  sqe.off = 0; // first buffer id
+  sqe.user_data = 0;
+}
+
+string_view IOUring::provided_buffer( const uint16_t buffer_group, const Completion& completion ) const
+{
+  const auto id = completion.buffer_id();
+  if ( not id.has_value() or completion.result < 0 ) {
+    throw runtime_error( "io_uring: completion did not select a buffer" );
+  }
+  const auto& group = provided_buffers_.at( buffer_group );
+  return string_view { group.storage }.substr( id.value() * group.buffer_size, completion.result );
+}
+
+void IOUring::recycle_buffer( const uint16_t buffer_group, const uint16_t buffer_id )
+{
+  auto& group = provided_buffers_.at( buffer_group );
+
+  io_uring_sqe& sqe = next_sqe();
+  sqe.opcode = IORING_OP_PROVIDE_BUFFERS;
+  sqe.fd = 1;
+  sqe.addr = reinterpret_cast<uint64_t>( group.storage.data() + buffer_id * group.buffer_size ); // NOLINT(*-cast)
+  sqe.len = group.buffer_size;
+  sqe.buf_group = buffer_group;
+  sqe.off = buffer_id;
+  sqe.user_data = 0;
+}
+
+void IOUring::release_buffers( const uint16_t buffer_group )
+{
+  provided_buffers_.erase( buffer_group );
+}
+
+bool IOUring::enter( const unsigned min_complete, const int timeout_ms )
+{
+  __kernel_timespec ts {};
+  io_uring_getevents_arg arg {};
+  unsigned flags = IORING_ENTER_EXT_ARG;
+  if ( min_complete ) {
+    flags |= IORING_ENTER_GETEVENTS;
+  }
+  if ( timeout_ms >= 0 ) {
+    ts.tv_sec = timeout_ms / 1000;
+    ts.tv_nsec = static_cast<int64_t>( timeout_ms % 1000 ) * 1000 * 1000;
+    arg.ts = reinterpret_cast<uint64_t>( &ts ); // NOLINT(*-reinterpret-cast)
+  }
+
+  const int ret = sys_io_uring_enter( ring_fd_.fd_num(), to_submit_, min_complete, flags, &arg, sizeof( arg ) );
+  if ( ret < 0 ) {
+    if ( errno == ETIME ) {
+      return false;
+    }
+    if ( errno != EINTR and errno != EAGAIN and errno != EBUSY ) {
+      throw unix_error { "io_uring_enter" };
+    }
+  } else {
+    to_submit_ -= min( to_submit_, static_cast<unsigned>( ret ) );
+  }
+  return true;
+}
+
+unsigned IOUring::submit()
+{
+  const unsigned queued = to_submit_;
+  if ( queued ) {
+    enter( 0, -1 );
+  }
+  return queued - to_submit_;
+}
+
+bool IOUring::wait( const int timeout_ms )
+{
+  if ( __atomic_load_n( cq_tail_, __ATOMIC_ACQUIRE ) != *cq_head_ ) {
+    submit();
+    return true;
+  }
+  return enter( 1, timeout_ms );
+}
+
+size_t IOUring::reap( const function<void( const Completion& )>& handler )
+{
+  size_t count = 0;
+  uint32_t head = *cq_head_;
+  while ( head != __atomic_load_n( cq_tail_, __ATOMIC_ACQUIRE ) ) {
+    const io_uring_cqe& cqe = cqes_[head & cq_mask_]; // NOLINT(*-pointer-arithmetic)
+    const Completion completion { cqe.user_data, cqe.res, cqe.flags };
+    ++head;
+    __atomic_store_n( cq_head_, head, __ATOMIC_RELEASE );
+    handler( completion );
+    ++count;
+  }
+  return count;
+}
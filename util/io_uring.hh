@@ -0,0 +1,156 @@
+#pragma once
+
+#include "file_descriptor.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct io_uring_params;
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+//! A minimal wrapper around a Linux [io_uring](\ref man7::io_uring) instance
+//! \details Operations are queued with the prepare_*() methods and handed to the kernel as one batch
+//! by submit() or wait(). Their completions are delivered to a callback by reap().
+class IOUring
+{
+public:
+  //! A completion queue entry
+  struct Completion
+  {
+    uint64_t user_data; //!< Value given to the prepare_*() call that queued the operation
+    int32_t result;     //!< Return value of the operation (negative errno on failure)
+    uint32_t flags;     //!< IORING_CQE_F_* flags
+
+    //! Will the operation that produced this completion produce more (for multishot operations)?
+    bool more() const;
+
+    //! Index of the provided buffer that the kernel filled, if any
+    std::optional<uint16_t> buffer_id() const;
+  };
+
+private:
+  //! A region of memory shared with the kernel, unmapped on destruction
+  class Mapping
+  {
+    void* addr_ {};
+    size_t length_ {};
+
+  public:
+    Mapping( const FileDescriptor& fd, size_t length, uint64_t offset );
+    ~Mapping();
+
+    template<typename T>
+    T* at( uint32_t offset ) const
+    {
+      return reinterpret_cast<T*>( static_cast<char*>( addr_ ) + offset ); // NOLINT(*-reinterpret-cast)
+    }
+
+    Mapping( const Mapping& other ) = delete;
+    Mapping& operator=( const Mapping& other ) = delete;
+    Mapping( Mapping&& other ) = delete;
+    Mapping& operator=( Mapping&& other ) = delete;
+  };
+
+  //! Buffers handed to the kernel with IORING_OP_PROVIDE_BUFFERS, for operations that select a buffer
+  struct ProvidedBuffers
+  {
+    std::string storage {};
+    size_t buffer_size {};
+  };
+
+  std::unique_ptr<io_uring_params> params_;
+  FileDescriptor ring_fd_;
+  Mapping rings_;
+  Mapping sqes_;
+
+  // submission queue (shared with the kernel)
+  uint32_t* sq_head_ {};
+  uint32_t* sq_tail_ {};
+  uint32_t sq_mask_ {};
+  uint32_t sq_entries_ {};
+  uint32_t* sq_array_ {};
+  unsigned to_submit_ {};
+
+  // completion queue (shared with the kernel)
+  uint32_t* cq_head_ {};
+  uint32_t* cq_tail_ {};
+  uint32_t cq_mask_ {};
+  io_uring_cqe* cqes_ {};
+
+  std::vector<std::string> fixed_buffers_ {};
+  std::map<uint16_t, ProvidedBuffers> provided_buffers_ {};
+
+  //! Next free submission queue entry (submitting queued entries first if the queue is full)
+  io_uring_sqe& next_sqe();
+
+  //! Call [io_uring_enter(2)](\ref man2::io_uring_enter), returning false if the wait timed out
+  bool enter( unsigned min_complete, int timeout_ms );
+
+public:
+  //! Can this process create an io_uring with the features that IOUring needs?
+  //! \details The answer is probed once (the syscall may be missing or forbidden, e.g. by seccomp)
+  static bool available();
+
+  //! Create an io_uring with (at least) `entries` submission queue entries
+  explicit IOUring( unsigned entries = 256 );
+  ~IOUring();
+
+  //! \name
+  //! Queue an operation. Nothing is handed to the kernel until submit() or wait().
+
+  //!@{
+  void prepare_poll( int fd, int16_t events, uint64_t user_data );
+  void prepare_cancel( uint64_t target_user_data );
+  void prepare_read( const FileDescriptor& fd, std::span<char> buffer, uint64_t user_data );
+  void prepare_write( const FileDescriptor& fd, std::string_view buffer, uint64_t user_data );
+  void prepare_read_fixed( const FileDescriptor& fd, uint16_t buffer_index, uint64_t user_data );
+  void prepare_write_fixed( const FileDescriptor& fd, uint16_t buffer_index, size_t len, uint64_t user_data );
+  void prepare_recv_multishot( const FileDescriptor& fd, uint16_t buffer_group, uint64_t user_data );
+  void prepare_read_select( const FileDescriptor& fd, uint16_t buffer_group, uint64_t user_data );
+  void prepare_remove_buffers( uint16_t buffer_group, uint64_t user_data );
+  //!@}
+
+  //! Register `count` buffers of `size` bytes with the kernel, for use by prepare_{read,write}_fixed()
+  void register_buffers( size_t count, size_t size );
+
+  //! Access a registered buffer
+  std::string& fixed_buffer( uint16_t buffer_index ) { return fixed_buffers_.at( buffer_index ); }
+
+  //! Give the kernel `count` buffers of `size` bytes to choose from for operations on `buffer_group`
+  void provide_buffers( uint16_t buffer_group, uint16_t count, size_t size );
+
+  //! The contents of a provided buffer, as filled by the completion of a buffer-selecting operation
+  std::string_view provided_buffer( uint16_t buffer_group, const Completion& completion ) const;
+
+  //! Give a provided buffer back to the kernel once its contents have been consumed
+  void recycle_buffer( uint16_t buffer_group, uint16_t buffer_id );
+
+  //! Free the memory of a buffer group, once prepare_remove_buffers() has taken it back from the kernel
+  //! (after which the group may be provided anew)
+  void release_buffers( uint16_t buffer_group );
+
+  //! Hand every queued operation to the kernel without waiting; returns the number submitted
+  unsigned submit();
+
+  //! Submit queued operations and wait up to `timeout_ms` (forever if negative) for a completion.
+  //! Returns false if the wait timed out.
+  bool wait( int timeout_ms );
+
+  //! Call `handler` on each available completion; returns the number of completions reaped
+  size_t reap( const std::function<void( const Completion& )>& handler );
+
+  //! An IOUring cannot be copied or moved (the kernel holds pointers into its memory)
+  IOUring( const IOUring& other ) = delete;
+  IOUring& operator=( const IOUring& other ) = delete;
+  IOUring( IOUring&& other ) = delete;
+  IOUring& operator=( IOUring&& other ) = delete;
+};
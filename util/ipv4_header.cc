@@ -11,25 +11,10 @@ using namespace std;
 // Parse from string.
 void IPv4Header::parse( Parser& parser )
 {
-  uint8_t first_byte {};
-  parser.integer( first_byte );
-  ver = first_byte >> 4;    // version
-  hlen = first_byte & 0x0f; // header length
-  parser.integer( tos );    // type of service
-  parser.integer( len );
-  parser.integer( id );
-
-  uint16_t fo_val {};
-  parser.integer( fo_val );
-  df = static_cast<bool>( fo_val & 0x4000 ); // don't fragment
-  mf = static_cast<bool>( fo_val & 0x2000 ); // more fragments
-  offset = fo_val & 0x1fff;                  // offset
-
-  parser.integer( ttl );
-  parser.integer( proto );
-  parser.integer( cksum );
-  parser.integer( src );
-  parser.integer( dst );
+  IPv4HeaderLayout::parse( *this, parser );
+  if ( parser.has_error() ) {
+    return;
+  }
 
   if ( ver != 4 ) {
     parser.set_error();
@@ -61,22 +46,7 @@ void IPv4Header::serialize( Serializer& serializer ) const
     throw runtime_error( "wrong IP version" );
   }
 
-  const uint8_t first_byte = ( static_cast<uint32_t>( ver ) << 4 ) | ( hlen & 0xfU );
-  serializer.integer( first_byte ); // version and header length
-  serializer.integer( tos );
-  serializer.integer( len );
-  serializer.integer( id );
-
-  const uint16_t fo_val = ( df ? 0x4000U : 0 ) | ( mf ? 0x2000U : 0 ) | ( offset & 0x1fffU );
-  serializer.integer( fo_val );
-
-  serializer.integer( ttl );
-  serializer.integer( proto );
-
-  serializer.integer( cksum );
-
-  serializer.integer( src );
-  serializer.integer( dst );
+  IPv4HeaderLayout::serialize( *this, serializer );
 }
 
 uint16_t IPv4Header::payload_length() const
@@ -104,16 +74,27 @@ uint32_t IPv4Header::pseudo_checksum() const
   return pcksum;
 }
 
+// Sum the header a 16-bit word at a time, straight from the fields (as serialize() would lay them out, with a
+// zero checksum), instead of serializing the header first
 void IPv4Header::compute_checksum()
 {
-  cksum = 0;
-  Serializer s;
-  serialize( s );
+  uint32_t sum = ( ( static_cast<uint32_t>( ver ) << 4 ) | ( hlen & 0xfU ) ) << 8 | tos;
+  sum += len;
+  sum += id;
+  sum += ( df ? 0x4000U : 0 ) | ( mf ? 0x2000U : 0 ) | ( offset & 0x1fffU );
+  sum += static_cast<uint32_t>( ttl ) << 8 | proto;
+  sum += ( src >> 16 ) + static_cast<uint16_t>( src );
+  sum += ( dst >> 16 ) + static_cast<uint16_t>( dst );
 
   // calculate checksum -- taken over header only
-  InternetChecksum check;
-  check.add( s.output() );
-  cksum = check.value();
+  cksum = InternetChecksum { sum }.value();
+}
+
+void IPv4Header::decrement_ttl()
+{
+  const uint16_t old_word = ttl << 8 | proto; // TTL and protocol share a 16-bit word of the header
+  --ttl;
+  cksum = InternetChecksum::adjust( cksum, old_word, ttl << 8 | proto );
 }
 
 std::string IPv4Header::to_string() const
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "header_layout.hh"
 #include "parser.hh"
 
 #include <cstddef>
@@ -57,9 +58,29 @@ struct IPv4Header
   // Set checksum to correct value
   void compute_checksum();
 
+  // Decrement the TTL, adjusting the (correct) checksum incrementally
+  void decrement_ttl();
+
   // Return a string containing a header in human-readable format
   std::string to_string() const;
 
   void parse( Parser& parser );
   void serialize( Serializer& serializer ) const;
 };
+
+// Layout of the IPv4 header (without options) on the wire
+using IPv4HeaderLayout = HeaderLayout<IPv4Header,
+                                      Field<"ver", &IPv4Header::ver, 0, 1, 4, 4>,
+                                      Field<"hlen", &IPv4Header::hlen, 0, 1, 0, 4>,
+                                      Field<"tos", &IPv4Header::tos, 1, 1>,
+                                      Field<"len", &IPv4Header::len, 2, 2>,
+                                      Field<"id", &IPv4Header::id, 4, 2>,
+                                      Field<"df", &IPv4Header::df, 6, 2, 14, 1>,
+                                      Field<"mf", &IPv4Header::mf, 6, 2, 13, 1>,
+                                      Field<"offset", &IPv4Header::offset, 6, 2, 0, 13>,
+                                      Field<"ttl", &IPv4Header::ttl, 8, 1>,
+                                      Field<"proto", &IPv4Header::proto, 9, 1>,
+                                      Field<"cksum", &IPv4Header::cksum, 10, 2>,
+                                      Field<"src", &IPv4Header::src, 12, 4>,
+                                      Field<"dst", &IPv4Header::dst, 16, 4>>;
+static_assert( IPv4HeaderLayout::LENGTH == IPv4Header::LENGTH );
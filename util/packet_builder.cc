@@ -0,0 +1,42 @@
+#include "packet_builder.hh"
+#include "packet_pool.hh"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+static size_t total_length( const vector<Buffer>& buffers )
+{
+  size_t length = 0;
+  for ( const auto& buf : buffers ) {
+    length += buf.size();
+  }
+  return length;
+}
+
+PacketBuilder::PacketBuilder( const vector<Buffer>& payload, const size_t headroom )
+  : storage_( PacketPool::take( headroom + total_length( payload ) ) ), begin_( headroom )
+{
+  storage_.resize( headroom );
+  for ( const auto& buf : payload ) {
+    storage_.append( buf );
+  }
+}
+
+void PacketBuilder::prepend( const string_view bytes )
+{
+  if ( bytes.size() > begin_ ) {
+    throw runtime_error( "PacketBuilder: not enough headroom for a " + to_string( bytes.size() ) + "-byte header" );
+  }
+  begin_ -= bytes.size();
+  ranges::copy( bytes, storage_.begin() + static_cast<ptrdiff_t>( begin_ ) );
+}
+
+Buffer PacketBuilder::finish()
+{
+  const size_t begin = begin_;
+  begin_ = 0;
+  return Buffer { move( storage_ ) }.substr( begin );
+}
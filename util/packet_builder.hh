@@ -0,0 +1,48 @@
+#pragma once
+
+#include "buffer.hh"
+#include "parser.hh"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//! \brief Builds an outbound packet in one contiguous buffer, from the payload outwards.
+//! \details The payload goes in first, behind room (headroom) for the headers of every layer below it; then
+//! each layer writes its header directly in front of what is already there. The finished packet is a single
+//! Buffer, to be written with a single system call.
+class PacketBuilder
+{
+  std::string storage_;
+  size_t begin_; //!< offset of the packet's first byte in storage_
+
+public:
+  //! Room for an Ethernet header, a virtio-net header, and an IPv4 and a TCP header with the largest options
+  static constexpr size_t DEFAULT_HEADROOM = 14 + 10 + 60 + 60;
+
+  //! Start a packet with `payload`, leaving `headroom` bytes in front of it for headers
+  explicit PacketBuilder( const std::vector<Buffer>& payload, size_t headroom = DEFAULT_HEADROOM );
+
+  //! Write `bytes` in front of the packet
+  void prepend( std::string_view bytes );
+
+  //! Write `header`, serialized, in front of the packet
+  template<class Header>
+  void prepend_header( const Header& header )
+  {
+    Serializer serializer;
+    header.serialize( serializer );
+    const std::vector<Buffer> pieces = serializer.output();
+    for ( auto piece = pieces.rbegin(); piece != pieces.rend(); ++piece ) {
+      prepend( std::string_view { *piece } );
+    }
+  }
+
+  //! The packet so far
+  std::string_view bytes() const { return std::string_view { storage_ }.substr( begin_ ); }
+  size_t size() const { return storage_.size() - begin_; }
+
+  //! The packet, as a Buffer (this leaves the builder empty)
+  Buffer finish();
+};
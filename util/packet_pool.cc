@@ -0,0 +1,154 @@
+#include "packet_pool.hh"
+
+#include <array>
+#include <bit>
+#include <new>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+static constexpr size_t NUM_CLASSES
+  = countr_zero( PacketPool::MAX_CAPACITY ) - countr_zero( PacketPool::MIN_CAPACITY ) + 1;
+
+struct FreeLists
+{
+  array<vector<string>, NUM_CLASSES> strings {}; // strings[i] have capacity of at least MIN_CAPACITY << i
+  size_t string_bytes {};                        // the capacity of all those strings
+  vector<void*> blocks {};
+  PacketPool::Stats stats {};
+
+  FreeLists();
+  ~FreeLists();
+  FreeLists( const FreeLists& other ) = delete;
+  FreeLists& operator=( const FreeLists& other ) = delete;
+};
+
+// Buffers (e.g. in static objects) can outlive a thread's pool: after it is gone, memory goes straight back to
+// the allocator.
+static thread_local bool pool_destroyed = false;
+static thread_local FreeLists pool;
+
+FreeLists::FreeLists()
+{
+  blocks.reserve( PacketPool::MAX_FREE );
+}
+
+FreeLists::~FreeLists()
+{
+  for ( void* block : blocks ) {
+    ::operator delete( block );
+  }
+  pool_destroyed = true;
+}
+
+// A Buffer's storage: the string, which goes back to the pool with the storage
+struct RecycledString
+{
+  string str;
+
+  explicit RecycledString( string&& s ) : str( move( s ) ) {}
+  ~RecycledString() { PacketPool::recycle( move( str ) ); }
+  RecycledString( const RecycledString& other ) = delete;
+  RecycledString& operator=( const RecycledString& other ) = delete;
+};
+
+// The class of strings with at least `capacity` bytes of room
+static size_t class_for_request( const size_t capacity )
+{
+  if ( capacity <= PacketPool::MIN_CAPACITY ) {
+    return 0;
+  }
+  return bit_width( capacity - 1 ) - countr_zero( PacketPool::MIN_CAPACITY );
+}
+
+string PacketPool::take( const size_t capacity )
+{
+  if ( not pool_destroyed and capacity <= MAX_CAPACITY ) {
+    auto& free_list = pool.strings[class_for_request( capacity )];
+    if ( not free_list.empty() ) {
+      string str = move( free_list.back() );
+      free_list.pop_back();
+      pool.string_bytes -= str.capacity();
+      ++pool.stats.reused;
+      return str;
+    }
+    ++pool.stats.allocated;
+  }
+
+  string str;
+  // round up to the size class, so that the string can be reused for any request of that class
+  str.reserve( capacity <= MAX_CAPACITY ? MIN_CAPACITY << class_for_request( capacity ) : capacity );
+  return str;
+}
+
+void PacketPool::recycle( string&& str )
+{
+  if ( pool_destroyed or str.capacity() < MIN_CAPACITY ) {
+    return; // (a short string may not have any memory of its own to recycle)
+  }
+
+  // the largest class whose requests this string can serve
+  const size_t size_class
+    = min<size_t>( bit_width( str.capacity() ) - 1 - countr_zero( MIN_CAPACITY ), NUM_CLASSES - 1 );
+  auto& free_list = pool.strings[size_class];
+  if ( free_list.size() >= MAX_FREE or pool.string_bytes + str.capacity() > MAX_FREE_BYTES ) {
+    ++pool.stats.released;
+    return;
+  }
+  if ( free_list.capacity() == 0 ) {
+    free_list.reserve( MAX_FREE );
+  }
+  str.clear();
+  pool.string_bytes += str.capacity();
+  free_list.push_back( move( str ) );
+  ++pool.stats.recycled;
+}
+
+shared_ptr<const string> PacketPool::share( string&& str )
+{
+  auto storage = allocate_shared<RecycledString>( Allocator<RecycledString> {}, move( str ) );
+  return { storage, &storage->str };
+}
+
+void* PacketPool::allocate_block( const size_t size )
+{
+  if ( size > BLOCK_SIZE ) {
+    return ::operator new( size );
+  }
+  if ( not pool_destroyed ) {
+    if ( not pool.blocks.empty() ) {
+      void* block = pool.blocks.back();
+      pool.blocks.pop_back();
+      ++pool.stats.reused;
+      return block;
+    }
+    ++pool.stats.allocated;
+  }
+  return ::operator new( BLOCK_SIZE );
+}
+
+void PacketPool::deallocate_block( void* block, const size_t size )
+{
+  if ( size > BLOCK_SIZE or pool_destroyed ) {
+    ::operator delete( block );
+    return;
+  }
+  if ( pool.blocks.size() >= MAX_FREE ) {
+    ++pool.stats.released;
+    ::operator delete( block );
+    return;
+  }
+  pool.blocks.push_back( block );
+  ++pool.stats.recycled;
+}
+
+const PacketPool::Stats& PacketPool::stats()
+{
+  return pool.stats;
+}
+
+void PacketPool::reset_stats()
+{
+  pool.stats = {};
+}
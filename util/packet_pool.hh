@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+//! \brief Per-thread pools of packet memory, so that the datagram path reuses it instead of going to the
+//! allocator for every packet.
+//! \details Strings are kept in free lists by size class (powers of two from MIN_CAPACITY to MAX_CAPACITY);
+//! take() hands out an empty string with at least the capacity asked for, and recycle() puts a string's memory
+//! back. Buffers keep their storage in small blocks from a free list of their own, and recycle the string when
+//! the last Buffer referring to it goes away. Each thread has its own free lists (memory freed on another thread
+//! than it was taken on simply joins that thread's lists). Each list holds at most MAX_FREE entries, and a
+//! thread's string lists hold at most MAX_FREE_BYTES in all (so that a burst of large strings cannot pin
+//! MAX_FREE of each class for good).
+class PacketPool
+{
+public:
+  static constexpr size_t MIN_CAPACITY = 64;
+  static constexpr size_t MAX_CAPACITY = 65536; //!< (enough for a TUN read of a whole TSO super-packet)
+  static constexpr size_t MAX_FREE = 1024;
+  static constexpr size_t MAX_FREE_BYTES = size_t { 4 } << 20;
+  static constexpr size_t BLOCK_SIZE = 128; //!< size of the small blocks (enough for a Buffer's storage)
+
+  //! Counts of this thread's requests to the pool
+  struct Stats
+  {
+    size_t reused {};    //!< strings and blocks handed out from a free list
+    size_t allocated {}; //!< strings and blocks that had to come from the allocator
+    size_t recycled {};  //!< strings and blocks put back on a free list
+    size_t released {};  //!< strings and blocks given back to the allocator (too small, or the lists were full)
+  };
+
+  //! An empty string with room for at least `capacity` bytes
+  static std::string take( size_t capacity );
+
+  //! Put the memory of `str` back for reuse
+  static void recycle( std::string&& str );
+
+  //! Shared, immutable storage holding `str`, which is recycled once the last reference goes away
+  static std::shared_ptr<const std::string> share( std::string&& str );
+
+  //! A block of `size` (at most BLOCK_SIZE) bytes
+  static void* allocate_block( size_t size );
+  static void deallocate_block( void* block, size_t size );
+
+  //! This thread's counts
+  static const Stats& stats();
+  static void reset_stats();
+
+  //! An allocator (for the standard containers and std::allocate_shared) that uses the pool's small blocks
+  template<class T>
+  struct Allocator
+  {
+    using value_type = T;
+
+    Allocator() = default;
+    template<class U>
+    Allocator( const Allocator<U>& /* other */ ) // NOLINT(*-explicit-*)
+    {}
+
+    T* allocate( const size_t n ) { return static_cast<T*>( allocate_block( n * sizeof( T ) ) ); }
+    void deallocate( T* p, const size_t n ) { deallocate_block( p, n * sizeof( T ) ); }
+
+    template<class U>
+    bool operator==( const Allocator<U>& /* other */ ) const
+    {
+      return true;
+    }
+  };
+};
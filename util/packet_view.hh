@@ -0,0 +1,83 @@
+#pragma once
+
+#include "checksum.hh"
+#include "ipv4_header.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+
+//! \brief An IPv4 datagram read (and, through a non-const view, modified) where it lies, without decoding it.
+//! \details The view overlays the bytes of a whole datagram, contiguous in memory, and reads or writes single
+//! header fields (at the offsets given by IPv4HeaderLayout) on demand. Only a datagram that valid() accepts may be
+//! viewed; the view does not own its bytes, which must outlive it.
+template<class Char>
+class BasicIPv4View
+{
+  static_assert( std::is_same_v<std::remove_const_t<Char>, char> );
+
+  Char* data_;
+  size_t size_;
+
+  template<FieldName Name>
+  using field = IPv4HeaderLayout::field<Name>;
+
+  static constexpr uint8_t PROTO_UDP = 17;
+
+public:
+  BasicIPv4View( Char* data, const size_t size ) : data_( data ), size_( size ) {}
+
+  //! A read-only view of the same datagram
+  operator BasicIPv4View<const char>() const // NOLINT(*-explicit-*)
+    requires( not std::is_const_v<Char> )
+  {
+    return { data_, size_ };
+  }
+
+  //! Is `bytes` an IPv4 datagram that can be viewed: a version 4 header, with a correct checksum, that fits?
+  static bool valid( const std::string_view bytes )
+  {
+    if ( bytes.size() < IPv4Header::LENGTH or field<"ver">::get( bytes.data() ) != 4 ) {
+      return false;
+    }
+    const size_t header_length = field<"hlen">::get( bytes.data() ) * 4;
+    if ( header_length < IPv4Header::LENGTH or header_length > bytes.size() ) {
+      return false;
+    }
+    InternetChecksum check;
+    check.add( bytes.substr( 0, header_length ) );
+    return check.value() == 0;
+  }
+
+  uint8_t ttl() const { return field<"ttl">::get( data_ ); }
+  uint8_t proto() const { return field<"proto">::get( data_ ); }
+  uint32_t src() const { return field<"src">::get( data_ ); }
+  uint32_t dst() const { return field<"dst">::get( data_ ); }
+  size_t header_length() const { return field<"hlen">::get( data_ ) * 4; }
+
+  //! Does the datagram start a TCP or UDP payload, with the ports in this fragment?
+  bool has_ports() const
+  {
+    return ( proto() == IPv4Header::PROTO_TCP or proto() == PROTO_UDP ) and not field<"mf">::get( data_ )
+           and field<"offset">::get( data_ ) == 0 and size_ >= header_length() + 4;
+  }
+
+  //! The source and destination ports (only if has_ports())
+  uint16_t src_port() const { return load_big_endian<uint16_t>( data_ + header_length() ); }
+  uint16_t dst_port() const { return load_big_endian<uint16_t>( data_ + header_length() + 2 ); }
+
+  //! Decrement the TTL, adjusting the checksum incrementally
+  void decrement_ttl()
+    requires( not std::is_const_v<Char> )
+  {
+    // (the TTL and protocol share a 16-bit word of the header)
+    const uint16_t old_word = ttl() << 8 | proto();
+    field<"ttl">::set( data_, ttl() - 1 );
+    const uint16_t cksum = InternetChecksum::adjust( field<"cksum">::get( data_ ), old_word, ttl() << 8 | proto() );
+    field<"cksum">::set( data_, cksum );
+  }
+};
+
+using IPv4View = BasicIPv4View<char>;
+using ConstIPv4View = BasicIPv4View<const char>;
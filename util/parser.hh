@@ -1,12 +1,12 @@
 #pragma once
 
 #include "buffer.hh"
+#include "packet_pool.hh"
 
 #include <algorithm>
 #include <concepts>
 #include <cstdint>
 #include <cstring>
-#include <deque>
 #include <numeric>
 #include <span>
 #include <stdexcept>
@@ -16,18 +16,47 @@
 
 class Serializer;
 
+//! Load a big-endian unsigned integer from the `sizeof( T )` bytes at `data`
+//! (compilers turn this into a single load and byte swap)
+template<std::unsigned_integral T>
+T load_big_endian( const char* data )
+{
+  if constexpr ( sizeof( T ) == 1 ) {
+    return static_cast<uint8_t>( *data );
+  } else {
+    T out {};
+    for ( size_t i = 0; i < sizeof( T ); i++ ) {
+      out <<= 8;
+      out |= static_cast<uint8_t>( data[i] );
+    }
+    return out;
+  }
+}
+
+//! Store `value` as a big-endian unsigned integer in the `sizeof( T )` bytes at `data`
+template<std::unsigned_integral T>
+void store_big_endian( char* data, const T value )
+{
+  for ( size_t i = 0; i < sizeof( T ); i++ ) {
+    data[i] = static_cast<char>( value >> ( ( sizeof( T ) - i - 1 ) * 8 ) );
+  }
+}
+
 class Parser
 {
   class BufferList
   {
     uint64_t size_ {};
-    std::deque<Buffer> buffer_ {};
+    // (pool memory for the common case of a few buffers; the consumed ones are left at the front)
+    std::vector<Buffer, PacketPool::Allocator<Buffer>> buffer_ {};
+    size_t front_ {}; // index of the first unconsumed buffer
     uint64_t skip_ {};
 
   public:
     // NOLINTNEXTLINE(*-explicit-*)
     BufferList( const std::vector<Buffer>& buffers )
     {
+      buffer_.reserve( buffers.size() );
       for ( const auto& x : buffers ) {
         append( x );
       }
@@ -39,60 +68,86 @@ class Parser
 
     std::string_view peek() const
     {
-      if ( buffer_.empty() ) {
+      if ( front_ == buffer_.size() ) {
         throw std::runtime_error( "peek on empty BufferList" );
       }
-      return std::string_view { buffer_.front() }.substr( skip_ );
+      return std::string_view { buffer_[front_] }.substr( skip_ );
     }
 
     void remove_prefix( uint64_t len )
     {
-      while ( len and not buffer_.empty() ) {
+      while ( len and front_ < buffer_.size() ) {
         const uint64_t to_pop_now = std::min( len, peek().size() );
         skip_ += to_pop_now;
         len -= to_pop_now;
         size_ -= to_pop_now;
-        if ( skip_ == buffer_.front().size() ) {
-          buffer_.pop_front();
+        if ( skip_ == buffer_[front_].size() ) {
+          buffer_[front_++] = {};
           skip_ = 0;
         }
       }
     }
 
+    //! Call `visit( piece )` on each piece of the unconsumed input, in order, without consuming it
+    template<class Visitor>
+    void for_each_piece( Visitor&& visit ) const
+    {
+      uint64_t skip = skip_;
+      for ( auto buf = buffer_.begin() + front_; buf != buffer_.end(); ++buf, skip = 0 ) {
+        visit( std::string_view { *buf }.substr( skip ) );
+      }
+    }
+
+    //! Copy the first `out.size()` bytes (which must be there) into `out`, without consuming them
+    void copy_prefix( std::span<char> out ) const
+    {
+      auto next = out.begin();
+      uint64_t skip = skip_;
+      for ( auto buf = buffer_.begin() + front_; next != out.end(); ++buf, skip = 0 ) {
+        const auto view = std::string_view { *buf }.substr( skip, out.end() - next );
+        next = std::copy( view.begin(), view.end(), next );
+      }
+    }
+
     void dump_all( std::vector<Buffer>& out )
     {
       out.clear();
       if ( empty() ) {
         return;
       }
-      std::string first_str = std::move( buffer_.front() );
-      if ( skip_ ) {
-        first_str = first_str.substr( skip_ );
-      }
-      out.emplace_back( std::move( first_str ) );
-      buffer_.pop_front();
-      for ( auto&& x : buffer_ ) {
-        out.emplace_back( std::move( x ) );
+      out.reserve( buffer_.size() - front_ );
+      out.push_back( buffer_[front_].substr( skip_ ) ); // (a slice: no bytes are copied)
+      for ( auto buf = buffer_.begin() + front_ + 1; buf != buffer_.end(); ++buf ) {
+        out.push_back( std::move( *buf ) );
       }
+      buffer_.clear();
+      front_ = skip_ = size_ = 0;
     }
 
     void dump_all( Buffer& out )
     {
-      std::vector<Buffer> concat;
-      dump_all( concat );
-      if ( concat.size() == 1 ) {
-        out = concat.front();
+      if ( buffer_.size() - front_ <= 1 ) {
+        out = empty() ? Buffer {} : buffer_[front_].substr( skip_ );
+        buffer_.clear();
+        front_ = skip_ = size_ = 0;
         return;
       }
 
-      out.release().clear();
+      std::vector<Buffer> concat;
+      dump_all( concat );
+      std::string joined = PacketPool::take( std::accumulate(
+        concat.begin(), concat.end(), size_t {}, []( size_t n, const Buffer& b ) { return n + b.size(); } ) );
       for ( const auto& s : concat ) {
-        out.release().append( s );
+        joined.append( s );
       }
+      out = Buffer { std::move( joined ) }; // (not into `out`'s old storage, which may be shared)
     }
 
     void append( Buffer str )
     {
+      if ( str.empty() ) {
+        return; // (an empty buffer would make peek() look empty while there is more input behind it)
+      }
       size_ += str.size();
       buffer_.push_back( std::move( str ) );
     }
@@ -125,20 +180,42 @@ public:
       return;
     }
 
-    if constexpr ( sizeof( T ) == 1 ) {
-      out = static_cast<uint8_t>( input_.peek().front() );
-      input_.remove_prefix( 1 );
+    // Fast path: the integer lies within the first buffer
+    const std::string_view front = input_.peek();
+    if ( front.size() >= sizeof( T ) ) {
+      out = load_big_endian<T>( front.data() );
+      input_.remove_prefix( sizeof( T ) );
       return;
-    } else {
-      out = static_cast<T>( 0 );
-      for ( size_t i = 0; i < sizeof( T ); i++ ) {
-        out <<= 8;
-        out |= static_cast<uint8_t>( input_.peek().front() );
-        input_.remove_prefix( 1 );
-      }
+    }
+
+    // Otherwise it is split between buffers: read it a byte at a time
+    out = static_cast<T>( 0 );
+    for ( size_t i = 0; i < sizeof( T ); i++ ) {
+      out <<= 8;
+      out |= static_cast<uint8_t>( input_.peek().front() );
+      input_.remove_prefix( 1 );
     }
   }
 
+  //! \brief The next `scratch.size()` bytes (typically a fixed-size header), without consuming them.
+  //! \details Returns a view straight into the input if the bytes lie within one buffer (valid until they
+  //! are consumed), or else copies them into `scratch` and returns a view of that. If the input is too
+  //! short, sets the error flag and returns an empty view.
+  std::string_view peek_fixed( std::span<char> scratch )
+  {
+    check_size( scratch.size() );
+    if ( has_error() ) {
+      return {};
+    }
+
+    const std::string_view front = input_.peek();
+    if ( front.size() >= scratch.size() ) {
+      return front.substr( 0, scratch.size() );
+    }
+    input_.copy_prefix( scratch );
+    return { scratch.data(), scratch.size() };
+  }
+
   void string( std::span<char> out )
   {
     check_size( out.size() );
@@ -172,12 +249,23 @@ public:
   {
     constexpr uint64_t len = sizeof( T );
 
+    if ( buffer_.empty() and buffer_.capacity() < PacketPool::MIN_CAPACITY ) {
+      buffer_ = PacketPool::take( PacketPool::MIN_CAPACITY ); // (room for any header)
+    }
     for ( uint64_t i = 0; i < len; ++i ) {
       const uint8_t byte_val = val >> ( ( len - i - 1 ) * 8 );
       buffer_.push_back( byte_val );
     }
   }
 
+  void string( const std::string_view str )
+  {
+    if ( buffer_.empty() and buffer_.capacity() < PacketPool::MIN_CAPACITY ) {
+      buffer_ = PacketPool::take( std::max( str.size(), PacketPool::MIN_CAPACITY ) );
+    }
+    buffer_.append( str );
+  }
+
   void buffer( const Buffer& buf )
   {
     flush();
@@ -186,6 +274,7 @@ public:
 
   void buffer( const std::vector<Buffer>& bufs )
   {
+    output_.reserve( output_.size() + 1 + bufs.size() ); // (the 1 is for whatever flush() adds)
     for ( const auto& b : bufs ) {
       buffer( b );
     }
@@ -193,6 +282,9 @@ public:
 
   void flush()
   {
+    if ( buffer_.empty() ) {
+      return;
+    }
     output_.emplace_back( std::move( buffer_ ) );
     buffer_.clear();
   }
@@ -200,7 +292,7 @@ public:
   std::vector<Buffer> output()
   {
     flush();
-    return output_;
+    return std::move( output_ );
   }
 };
 
@@ -1,12 +1,14 @@
 #include "socket.hh"
 
 #include "exception.hh"
+#include "packet_pool.hh"
 
 #include <cstddef>
 #include <linux/if_packet.h>
 #include <net/if.h>
 #include <stdexcept>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 using namespace std;
@@ -123,6 +125,9 @@ void DatagramSocket::recv( Address& source_address, string& payload )
   socklen_t fromlen = sizeof( datagram_source_address );
 
   payload.clear();
+  if ( payload.capacity() < kReadBufferSize ) {
+    payload = PacketPool::take( kReadBufferSize );
+  }
   payload.resize( kReadBufferSize );
 
   const ssize_t recv_len = CheckSystemCall(
@@ -151,6 +156,78 @@ void DatagramSocket::send( const string_view payload )
   register_write();
 }
 
+DatagramBatch::DatagramBatch( const size_t capacity, const size_t datagram_size )
+  : storage_( capacity * datagram_size, 0 )
+  , datagram_size_( datagram_size )
+  , iovecs_( capacity )
+  , headers_( capacity )
+{
+  for ( size_t i = 0; i < capacity; ++i ) {
+    iovecs_[i] = { storage_.data() + i * datagram_size, datagram_size }; // NOLINT(*-pointer-arithmetic)
+  }
+}
+
+string_view DatagramBatch::operator[]( const size_t i ) const
+{
+  if ( i >= count_ ) {
+    throw out_of_range( "DatagramBatch index" );
+  }
+  return string_view { storage_ }.substr( i * datagram_size_, headers_[i].msg_len );
+}
+
+//! \note If a datagram is too large for the batch's buffers, this method throws a std::runtime_error
+size_t DatagramSocket::recv_batch( DatagramBatch& batch )
+{
+  for ( size_t i = 0; i < batch.capacity(); ++i ) {
+    batch.headers_[i] = {};
+    batch.headers_[i].msg_hdr.msg_iov = &batch.iovecs_[i];
+    batch.headers_[i].msg_hdr.msg_iovlen = 1;
+  }
+  batch.count_ = 0;
+
+  const int count = CheckSystemCall(
+    "recvmmsg",
+    ::recvmmsg( fd_num(), batch.headers_.data(), batch.capacity(), MSG_TRUNC | MSG_WAITFORONE, nullptr ) );
+
+  for ( int i = 0; i < count; ++i ) {
+    if ( batch.headers_[i].msg_hdr.msg_flags & MSG_TRUNC ) { // NOLINT(*-signed-bitwise)
+      throw runtime_error( "recvmmsg (oversized datagram)" );
+    }
+  }
+
+  if ( count ) {
+    register_read();
+  }
+  batch.count_ = count;
+  return count;
+}
+
+size_t DatagramSocket::send_batch( const vector<vector<Buffer>>& datagrams )
+{
+  size_t total_buffers = 0;
+  for ( const auto& dgram : datagrams ) {
+    total_buffers += dgram.size();
+  }
+
+  vector<iovec> iovecs;
+  iovecs.reserve( total_buffers );
+  vector<mmsghdr> msgs( datagrams.size() );
+  for ( size_t i = 0; i < datagrams.size(); ++i ) {
+    msgs[i].msg_hdr.msg_iov = iovecs.data() + iovecs.size(); // NOLINT(*-pointer-arithmetic)
+    msgs[i].msg_hdr.msg_iovlen = datagrams[i].size();
+    for ( const auto& buf : datagrams[i] ) {
+      const string_view view = buf;
+      iovecs.push_back( { const_cast<char*>( view.data() ), view.size() } ); // NOLINT(*-const-cast)
+    }
+  }
+
+  const int count = CheckSystemCall( "sendmmsg", ::sendmmsg( fd_num(), msgs.data(), msgs.size(), 0 ) );
+  if ( count ) {
+    register_write();
+  }
+  return count;
+}
+
 // mark the socket as listening for incoming connections
 //! \param[in] backlog is the number of waiting connections to queue (see [listen(2)](\ref man2::listen))
 void TCPSocket::listen( const int backlog )
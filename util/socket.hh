@@ -5,7 +5,10 @@
 
 #include <cstdint>
 #include <functional>
+#include <string>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <vector>
 
 //! \brief Base class for network sockets (TCP, UDP, etc.)
 //! \details Socket is generally used via a subclass. See TCPSocket and UDPSocket for usage examples.
@@ -58,6 +61,30 @@ public:
   void throw_if_error() const;
 };
 
+//! Preallocated storage for a batch of datagrams, reused by every DatagramSocket::recv_batch call
+class DatagramBatch
+{
+  std::string storage_;
+  size_t datagram_size_;
+  std::vector<iovec> iovecs_;
+  std::vector<mmsghdr> headers_;
+  size_t count_ {};
+
+  friend class DatagramSocket;
+
+public:
+  //! \param[in] capacity is the maximum number of datagrams received per system call
+  //! \param[in] datagram_size is the largest datagram that can be received
+  DatagramBatch( size_t capacity, size_t datagram_size );
+
+  size_t capacity() const { return headers_.size(); } //!< Maximum number of datagrams in a batch
+  size_t size() const { return count_; }              //!< Number of datagrams received by the last call
+  bool empty() const { return count_ == 0; }          //!< Did the last call receive nothing?
+
+  //! The contents of the `i`th datagram (valid until the next recv_batch)
+  std::string_view operator[]( size_t i ) const;
+};
+
 class DatagramSocket : public Socket
 {
   using Socket::Socket;
@@ -71,6 +98,14 @@ public:
 
   //! Send datagram to the socket's connected address (must call connect() first)
   void send( std::string_view payload );
+
+  //! Receive up to `batch.capacity()` datagrams with one [recvmmsg(2)](\ref man2::recvmmsg)
+  //! \returns the number of datagrams received
+  size_t recv_batch( DatagramBatch& batch );
+
+  //! Send several datagrams to the socket's connected address with one [sendmmsg(2)](\ref man2::sendmmsg)
+  //! \returns the number of datagrams sent (from the front of `datagrams`)
+  size_t send_batch( const std::vector<std::vector<Buffer>>& datagrams );
 };
 
 //! A wrapper around [UDP sockets](\ref man7::udp)
@@ -119,3 +154,11 @@ public:
   //! Construct from a file descriptor
   explicit LocalStreamSocket( FileDescriptor&& fd ) : Socket( std::move( fd ), AF_UNIX, SOCK_STREAM ) {}
 };
+
+//! A wrapper around [Unix-domain datagram sockets](\ref man7::unix)
+class LocalDatagramSocket : public DatagramSocket
+{
+public:
+  //! Construct from a file descriptor
+  explicit LocalDatagramSocket( FileDescriptor&& fd ) : DatagramSocket( std::move( fd ), AF_UNIX, SOCK_DGRAM ) {}
+};
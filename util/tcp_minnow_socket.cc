@@ -65,6 +65,22 @@ TCPMinnowSocket<AdaptT>::TCPMinnowSocket( pair<FileDescriptor, FileDescriptor> d
   set_blocking( false );
 }
 
+template<typename AdaptT>
+void TCPMinnowSocket<AdaptT>::_segment_received( optional<TCPSegment> seg )
+{
+  if ( seg ) {
+    _tcp->receive( move( seg.value() ) );
+    collect_segments();
+  }
+
+  // debugging output:
+  if ( _thread_data.eof() and _tcp.value().sender().sequence_numbers_in_flight() == 0 and not _fully_acked ) {
+    cerr << "DEBUG: Outbound stream to " << _datagram_adapter.config().destination.to_string()
+         << " has been fully acknowledged.\n";
+    _fully_acked = true;
+  }
+}
+
 template<typename AdaptT>
 void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
 {
@@ -89,24 +105,34 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
   //    given to underlying datagram socket)
 
   // rule 1: read from filtered packet stream and dump into TCPConnection
-  _eventloop.add_rule(
-    "receive TCP segment from the network",
-    _datagram_adapter.fd(),
-    Direction::In,
-    [&] {
-      if ( auto seg = _datagram_adapter.read() ) {
-        _tcp->receive( move( seg.value() ) );
-        collect_segments();
+  if constexpr ( ReceivingAdapter<AdaptT> ) {
+    // the eventloop reads the packets, and the adapter parses them
+    _eventloop.add_receive_rule(
+      "receive TCP segment from the network",
+      _datagram_adapter.fd(),
+      _datagram_adapter.max_packet_size(),
+      [&]( const string_view packet ) { _segment_received( _datagram_adapter.receive( packet ) ); },
+      [&] { return _tcp->active(); } );
+
+    // (with a device shared by several sockets, the packets of this connection read by another socket too)
+    if constexpr ( requires { _datagram_adapter.inbox(); } ) {
+      if ( FileDescriptor* inbox = _datagram_adapter.inbox() ) {
+        _eventloop.add_receive_rule(
+          "receive TCP segment passed on by another socket",
+          *inbox,
+          _datagram_adapter.max_packet_size(),
+          [&]( const string_view packet ) { _segment_received( _datagram_adapter.receive( packet ) ); },
+          [&] { return _tcp->active(); } );
       }
-
-      // debugging output:
-      if ( _thread_data.eof() and _tcp.value().sender().sequence_numbers_in_flight() == 0 and not _fully_acked ) {
-        cerr << "DEBUG: Outbound stream to " << _datagram_adapter.config().destination.to_string()
-             << " has been fully acknowledged.\n";
-        _fully_acked = true;
-      }
-    },
-    [&] { return _tcp->active(); } );
+    }
+  } else {
+    _eventloop.add_rule(
+      "receive TCP segment from the network",
+      _datagram_adapter.fd(),
+      Direction::In,
+      [&] { _segment_received( _datagram_adapter.read() ); },
+      [&] { return _tcp->active(); } );
+  }
 
   // rule 2: read from pipe into outbound buffer
   _eventloop.add_rule(
@@ -178,9 +204,13 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
     _datagram_adapter.fd(),
     Direction::Out,
     [&] {
-      while ( not outgoing_segments_.empty() ) {
-        _datagram_adapter.write( outgoing_segments_.front() );
-        outgoing_segments_.pop();
+      if constexpr ( requires { _datagram_adapter.write( outgoing_segments_ ); } ) {
+        _datagram_adapter.write( outgoing_segments_ ); // the adapter may combine segments
+      } else {
+        while ( not outgoing_segments_.empty() ) {
+          _datagram_adapter.write( outgoing_segments_.front() );
+          outgoing_segments_.pop();
+        }
       }
     },
     [&] { return not outgoing_segments_.empty(); } );
@@ -240,6 +270,7 @@ void TCPMinnowSocket<AdaptT>::connect( const TCPConfig& c_tcp, const FdAdapterCo
   _initialize_TCP( c_tcp );
 
   _datagram_adapter.config_mut() = c_ad;
+  _datagram_adapter.claim_flow();
 
   cerr << "DEBUG: Connecting to " << c_ad.destination.to_string() << "...\n";
 
@@ -277,6 +308,7 @@ void TCPMinnowSocket<AdaptT>::listen_and_accept( const TCPConfig& c_tcp, const F
 
   _datagram_adapter.config_mut() = c_ad;
   _datagram_adapter.set_listening( true );
+  _datagram_adapter.claim_flow();
 
   cerr << "DEBUG: Listening for incoming connection...\n";
   _tcp_loop( [&] { return ( not _tcp->has_ackno() ) or ( _tcp->sender().sequence_numbers_in_flight() ); } );
@@ -326,7 +358,12 @@ template class TCPMinnowSocket<TCPOverIPv4OverEthernetAdapter>;
 //! Specialization of TCPMinnowSocket for LossyTCPOverIPv4OverTunFdAdapter
 template class TCPMinnowSocket<LossyTCPOverIPv4OverTunFdAdapter>;
 
-CS144TCPSocket::CS144TCPSocket() : TCPOverIPv4MinnowSocket( TCPOverIPv4OverTunFdAdapter( TunFD( "tun144" ) ) ) {}
+// (each CS144TCPSocket's TCP thread services its own queue of the TUN device, where it has several, and gets the
+// packets of its connection that land on another socket's queue passed on to it)
+CS144TCPSocket::CS144TCPSocket()
+  : TCPOverIPv4MinnowSocket(
+    TCPOverIPv4OverTunFdAdapter( TunFD::open_queue( "tun144" ), TunSteering::for_device( "tun144" ) ) )
+{}
 
 void CS144TCPSocket::connect( const Address& address )
 {
@@ -10,11 +10,20 @@
 #include "tuntap_adapter.hh"
 
 #include <atomic>
+#include <concepts>
 #include <cstdint>
 #include <optional>
+#include <string_view>
 #include <thread>
 #include <vector>
 
+//! An adapter that can parse packets read from its fd by someone else, so that an EventLoop may do the reading
+template<typename AdaptT>
+concept ReceivingAdapter = requires( AdaptT adapter, std::string_view packet ) {
+  { adapter.receive( packet ) } -> std::same_as<std::optional<TCPSegment>>;
+  { adapter.max_packet_size() } -> std::convertible_to<size_t>;
+};
+
 //! Multithreaded wrapper around TCPPeer that approximates the Unix sockets API
 template<typename AdaptT>
 class TCPMinnowSocket : public LocalStreamSocket
@@ -38,7 +47,11 @@ private:
   std::queue<TCPSegment> outgoing_segments_ {};
 
   //! eventloop that handles all the events (new inbound datagram, new outbound bytes, new inbound bytes)
-  EventLoop _eventloop {};
+  //! (with an adapter that can parse packets read for it, the eventloop reads them through io_uring if it can)
+  EventLoop _eventloop { ReceivingAdapter<AdaptT> ? EventLoop::Backend::IOUring : EventLoop::Backend::Poll };
+
+  //! Give a segment from the network (if any) to the TCPPeer
+  void _segment_received( std::optional<TCPSegment> seg );
 
   //! Process events while specified condition is true
   void _tcp_loop( const std::function<bool()>& condition );
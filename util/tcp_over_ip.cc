@@ -2,28 +2,54 @@
 
 #include "ipv4_datagram.hh"
 #include "ipv4_header.hh"
+#include "packet_builder.hh"
 #include "parser.hh"
 
+#include <algorithm>
 #include <arpa/inet.h>
+#include <array>
+#include <cstdint>
+#include <queue>
 #include <stdexcept>
 #include <unistd.h>
 #include <utility>
+#include <vector>
 
 using namespace std;
 
-//! \details This function attempts to parse a TCP segment from
-//! the IP datagram's payload.
+//! The TCP source and destination ports: the first four bytes of the segment, read without parsing it
+//! \returns nothing if the segment is too short to hold them
+static optional<pair<uint16_t, uint16_t>> peek_ports( const vector<Buffer>& segment )
+{
+  array<char, 4> ports {};
+  size_t filled = 0;
+  for ( const auto& buf : segment ) {
+    const size_t count = min( ports.size() - filled, buf.size() );
+    copy_n( buf.data(), count, ports.data() + filled );
+    filled += count;
+    if ( filled == ports.size() ) {
+      return pair { load_big_endian<uint16_t>( ports.data() ), load_big_endian<uint16_t>( ports.data() + 2 ) };
+    }
+  }
+  return {};
+}
+
+//! \details This function checks that the IP datagram's payload is a TCP segment
+//! related to the current connection, and then attempts to parse it.
 //!
-//! If this succeeds, it then checks that the received segment is related to the
-//! current connection. When a TCP connection has been established, this means
-//! checking that the source and destination ports in the TCP header are correct.
+//! The ports are read straight from the payload's bytes, so that a segment for another
+//! connection is dropped (and counted in filter_stats()) before it is checksummed or parsed.
+//! When a TCP connection has been established, both the source and destination ports must
+//! match; while it is listening, only the destination port.
 //!
 //! If the TCP connection is listening (i.e., TCPOverIPv4OverTunFdAdapter::_listen is `true`)
 //! and the TCP segment read from the wire includes a SYN, this function clears the
 //! `_listen` flag and records the source and destination addresses and port numbers
 //! from the TCP header; it uses this information to filter future reads.
+//! \param[in] checksum_valid is `true` if the TCP checksum has already been verified (e.g. by the device)
 //! \returns a std::optional<TCPSegment> that is empty if the segment was invalid or unrelated
-optional<TCPSegment> TCPOverIPv4Adapter::unwrap_tcp_in_ip( const InternetDatagram& ip_dgram )
+optional<TCPSegment> TCPOverIPv4Adapter::unwrap_tcp_in_ip( const InternetDatagram& ip_dgram,
+                                                           const bool checksum_valid )
 {
   // is the IPv4 datagram for us?
   // Note: it's valid to bind to address "0" (INADDR_ANY) and reply from actual address contacted
@@ -41,14 +67,26 @@ optional<TCPSegment> TCPOverIPv4Adapter::unwrap_tcp_in_ip( const InternetDatagra
     return {};
   }
 
-  // is the payload a valid TCP segment?
-  TCPSegment tcp_seg;
-  if ( not parse( tcp_seg, ip_dgram.payload, ip_dgram.header.pseudo_checksum() ) ) {
+  // is the TCP segment for us, and from our peer? (checked on the raw bytes, before any checksum or parse)
+  const optional<pair<uint16_t, uint16_t>> ports = peek_ports( ip_dgram.payload );
+  if ( not ports.has_value() ) {
+    return {};
+  }
+  const auto [src_port, dst_port] = ports.value();
+  if ( dst_port != config().source.port() ) {
+    _filter_stats.wrong_dst_port++;
+    return {};
+  }
+  if ( not listening() and src_port != config().destination.port() ) {
+    _filter_stats.wrong_src_port++;
     return {};
   }
 
-  // is the TCP segment for us?
-  if ( tcp_seg.udinfo.dst_port != config().source.port() ) {
+  // is the payload a valid TCP segment?
+  TCPSegment tcp_seg;
+  const optional<uint32_t> pseudo_checksum
+    = checksum_valid ? nullopt : optional<uint32_t> { ip_dgram.header.pseudo_checksum() };
+  if ( not parse( tcp_seg, ip_dgram.payload, pseudo_checksum ) ) {
     return {};
   }
 
@@ -64,11 +102,6 @@ optional<TCPSegment> TCPOverIPv4Adapter::unwrap_tcp_in_ip( const InternetDatagra
     }
   }
 
-  // is the TCP segment from our peer?
-  if ( tcp_seg.udinfo.src_port != config().destination.port() ) {
-    return {};
-  }
-
   return tcp_seg;
 }
 
@@ -87,9 +120,109 @@ InternetDatagram TCPOverIPv4Adapter::wrap_tcp_in_ip( TCPSegment& seg )
   ip_dgram.header.len = ip_dgram.header.hlen * 4 + 20 /* tcp header len */ + seg.sender_message.payload.size();
 
   // set payload, calculating TCP checksum using information from IP header
+  // (the payload Buffer is shared, not copied, behind the serialized TCP header)
   seg.compute_checksum( ip_dgram.header.pseudo_checksum() );
   ip_dgram.header.compute_checksum();
   ip_dgram.payload = serialize( seg );
 
   return ip_dgram;
 }
+
+//! \details For a datagram that is written with one system call from one buffer (where wrap_tcp_in_ip leaves
+//! the payload shared, in a separate piece). The payload is copied once, into a PacketBuilder; the TCP header
+//! (whose checksum comes from its fields and the payload, without serializing anything) is written in front of
+//! it, and then the IPv4 header.
+//! Sets the port numbers and checksum of `seg`.
+//! \param[in] seg is the TCP segment to convert
+//! \param[out] header is the IPv4 header of the datagram
+Buffer TCPOverIPv4Adapter::build_tcp_in_ip( TCPSegment& seg, IPv4Header& header )
+{
+  // set the port numbers in the TCP segment
+  seg.udinfo.src_port = config().source.port();
+  seg.udinfo.dst_port = config().destination.port();
+
+  // set the datagram's addresses and length
+  header.src = config().source.ipv4_numeric();
+  header.dst = config().destination.ipv4_numeric();
+  header.len = header.hlen * 4 + 20 /* tcp header len */ + seg.sender_message.payload.size();
+  header.compute_checksum();
+
+  seg.compute_checksum( header.pseudo_checksum() );
+
+  PacketBuilder packet { { seg.sender_message.payload } };
+  TCPSegment tcp_header = seg;
+  tcp_header.sender_message.payload = {};
+  packet.prepend_header( tcp_header );
+  packet.prepend_header( header );
+  return packet.finish();
+}
+
+//! \details Segments can share one datagram when they are consecutive pieces of the outbound stream: all but
+//! the last carry exactly as much payload as the first (the segment size given to the device), none carries a SYN
+//! or RST, only the last may carry a FIN, and all carry the same acknowledgment and window. The datagram's TCP
+//! checksum covers only the pseudo-header; the device completes it, cuts the datagram back into segments and
+//! leaves the FIN on the last one. A segment that cannot be combined still gets its checksum offloaded.
+//! \param[in,out] segments is the queue of outbound segments; the segments that were wrapped are removed from it
+//! \returns the VirtioNetHeader that describes the offloads, and the datagram
+pair<VirtioNetHeader, InternetDatagram> TCPOverIPv4Adapter::wrap_tcp_in_ip_gso( queue<TCPSegment>& segments )
+{
+  static constexpr size_t max_datagram_length = 65535;
+  static constexpr uint16_t headers_length = IPv4Header::LENGTH + 20 /* tcp header len */;
+
+  TCPSegment seg = move( segments.front() );
+  segments.pop();
+  seg.udinfo.src_port = config().source.port();
+  seg.udinfo.dst_port = config().destination.port();
+
+  const size_t gso_size = seg.sender_message.payload.size();
+  vector<Buffer> payload { seg.sender_message.payload };
+  size_t payload_length = gso_size;
+  Wrap32 next_seqno = seg.sender_message.seqno + gso_size;
+
+  const auto continues_run = [&]( const TCPSegment& next ) {
+    const TCPSenderMessage& msg = next.sender_message;
+    return gso_size > 0 and not seg.sender_message.SYN and not seg.sender_message.FIN and not seg.reset
+           and not msg.SYN and not next.reset and msg.seqno == next_seqno and not msg.payload.empty()
+           and msg.payload.size() <= gso_size and next.receiver_message.ackno == seg.receiver_message.ackno
+           and next.receiver_message.window_size == seg.receiver_message.window_size
+           and headers_length + payload_length + msg.payload.size() <= max_datagram_length;
+  };
+
+  size_t segment_count = 1;
+  while ( not segments.empty() and continues_run( segments.front() ) ) {
+    TCPSenderMessage& msg = segments.front().sender_message;
+    const size_t length = msg.payload.size();
+    payload_length += length;
+    next_seqno = next_seqno + length;
+    seg.sender_message.FIN = msg.FIN;
+    payload.push_back( msg.payload );
+    segments.pop();
+    ++segment_count;
+    if ( length < gso_size ) {
+      break; // only the last segment may be short
+    }
+  }
+
+  InternetDatagram ip_dgram;
+  ip_dgram.header.src = config().source.ipv4_numeric();
+  ip_dgram.header.dst = config().destination.ipv4_numeric();
+  ip_dgram.header.len = headers_length + payload_length;
+  ip_dgram.header.compute_checksum();
+
+  seg.sender_message.payload = {};
+  seg.compute_partial_checksum( ip_dgram.header.pseudo_checksum() );
+  ip_dgram.payload = serialize( seg );
+  ip_dgram.payload.insert( ip_dgram.payload.end(), payload.begin(), payload.end() );
+
+  VirtioNetHeader vnet;
+  vnet.flags = VirtioNetHeader::F_NEEDS_CSUM;
+  vnet.csum_start = IPv4Header::LENGTH;
+  vnet.csum_offset = 16; // offset of the checksum in the TCP header
+  if ( segment_count > 1 ) {
+    vnet.gso_type = VirtioNetHeader::GSO_TCPV4;
+    vnet.hdr_len = headers_length;
+    vnet.gso_size = gso_size;
+  }
+
+  return { vnet, move( ip_dgram ) };
+}
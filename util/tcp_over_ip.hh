@@ -4,14 +4,35 @@
 #include "fd_adapter.hh"
 #include "ipv4_datagram.hh"
 #include "tcp_segment.hh"
+#include "virtio_net_header.hh"
 
+#include <cstddef>
 #include <optional>
+#include <queue>
+#include <utility>
 
 //! \brief A converter from TCP segments to serialized IPv4 datagrams
 class TCPOverIPv4Adapter : public FdAdapterBase
 {
 public:
-  std::optional<TCPSegment> unwrap_tcp_in_ip( const InternetDatagram& ip_dgram );
+  //! Counts of inbound segments dropped on their ports, before they were checksummed or parsed
+  struct FilterStats
+  {
+    size_t wrong_dst_port {}; //!< segments for another local port
+    size_t wrong_src_port {}; //!< segments from a peer port other than the connection's
+  };
+
+  std::optional<TCPSegment> unwrap_tcp_in_ip( const InternetDatagram& ip_dgram, bool checksum_valid = false );
 
   InternetDatagram wrap_tcp_in_ip( TCPSegment& seg );
+
+  //! The datagram carrying `seg`, serialized in one contiguous buffer (filling in `header`)
+  Buffer build_tcp_in_ip( TCPSegment& seg, IPv4Header& header );
+
+  std::pair<VirtioNetHeader, InternetDatagram> wrap_tcp_in_ip_gso( std::queue<TCPSegment>& segments );
+
+  const FilterStats& filter_stats() const { return _filter_stats; }
+
+private:
+  FilterStats _filter_stats {};
 };
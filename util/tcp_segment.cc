@@ -3,60 +3,49 @@
 #include "wrapping_integers.hh"
 
 #include <cstddef>
+#include <string_view>
 
-static constexpr uint32_t TCPHeaderMinLen = 5; // 32-bit words
+static constexpr uint8_t TCPHeaderMinLen = 5; // 32-bit words
+static_assert( TCPHeaderLayout::LENGTH == TCPHeaderMinLen * 4 );
 
 using namespace std;
 
-void TCPSegment::parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum )
+void TCPSegment::parse( Parser& parser, optional<uint32_t> datagram_layer_pseudo_checksum )
 {
-  {
-    /* verify checksum */
-    Parser parser2 = parser;
-    Buffer all_remaining;
-    parser2.all_remaining( all_remaining );
-    InternetChecksum check { datagram_layer_pseudo_checksum };
-    check.add( all_remaining );
+  if ( datagram_layer_pseudo_checksum.has_value() ) {
+    /* verify checksum (over the header and payload, where they lie in the input) */
+    InternetChecksum check { datagram_layer_pseudo_checksum.value() };
+    parser.input().for_each_piece( [&check]( const string_view piece ) { check.add( piece ); } );
     if ( check.value() ) {
       parser.set_error();
       return;
     }
   }
 
-  uint32_t raw32 {};
-  uint16_t raw16 {};
-  uint8_t octet {};
-
-  parser.integer( udinfo.src_port );
-  parser.integer( udinfo.dst_port );
-
-  parser.integer( raw32 );
-  sender_message.seqno = Wrap32 { raw32 };
-
-  parser.integer( raw32 );
-  receiver_message.ackno = Wrap32 { raw32 };
-
-  parser.integer( octet );
-  const uint8_t data_offset = octet >> 4;
+  TCPHeader header;
+  TCPHeaderLayout::parse( header, parser );
+  if ( parser.has_error() ) {
+    return;
+  }
 
-  parser.integer( octet ); // flags
-  if ( not( octet & 0b0001'0000 ) ) {
+  udinfo.src_port = header.src_port;
+  udinfo.dst_port = header.dst_port;
+  udinfo.cksum = header.cksum;
+  sender_message.seqno = Wrap32 { header.seqno };
+  receiver_message.ackno = Wrap32 { header.ackno };
+  if ( not header.ack ) {
     receiver_message.ackno.reset(); // no ACK
   }
-
-  reset = octet & 0b0000'0100;
-  sender_message.SYN = octet & 0b0000'0010;
-  sender_message.FIN = octet & 0b0000'0001;
-
-  parser.integer( receiver_message.window_size );
-  parser.integer( udinfo.cksum );
-  parser.integer( raw16 ); // urgent pointer
+  reset = header.rst;
+  sender_message.SYN = header.syn;
+  sender_message.FIN = header.fin;
+  receiver_message.window_size = header.window_size;
 
   // skip any options or anything extra in the header
-  if ( data_offset < TCPHeaderMinLen ) {
+  if ( header.data_offset < TCPHeaderMinLen ) {
     parser.set_error();
   }
-  parser.remove_prefix( data_offset * 4 - TCPHeaderMinLen * 4 );
+  parser.remove_prefix( header.data_offset * 4 - TCPHeaderMinLen * 4 );
 
   parser.all_remaining( sender_message.payload );
 }
@@ -67,29 +56,53 @@ public:
   uint32_t raw_value() const { return raw_value_; }
 };
 
+uint8_t TCPSegment::flags() const
+{
+  return ( receiver_message.ackno.has_value() ? 0b0001'0000U : 0 ) | ( reset ? 0b0000'0100U : 0 )
+         | ( sender_message.SYN ? 0b0000'0010U : 0 ) | ( sender_message.FIN ? 0b0000'0001U : 0 );
+}
+
 void TCPSegment::serialize( Serializer& serializer ) const
 {
-  serializer.integer( udinfo.src_port );
-  serializer.integer( udinfo.dst_port );
-  serializer.integer( Wrap32Serializable { sender_message.seqno }.raw_value() );
-  serializer.integer( Wrap32Serializable { receiver_message.ackno.value_or( Wrap32 { 0 } ) }.raw_value() );
-  serializer.integer( uint8_t { TCPHeaderMinLen << 4 } ); // data offset
-  const uint8_t flags = ( receiver_message.ackno.has_value() ? 0b0001'0000U : 0 ) | ( reset ? 0b0000'0100U : 0 )
-                        | ( sender_message.SYN ? 0b0000'0010U : 0 ) | ( sender_message.FIN ? 0b0000'0001U : 0 );
-  serializer.integer( flags );
-  serializer.integer( receiver_message.window_size );
-  serializer.integer( udinfo.cksum );
-  serializer.integer( uint16_t { 0 } ); // urgent pointer
+  const Wrap32Serializable ackno { receiver_message.ackno.value_or( Wrap32 { 0 } ) };
+  const TCPHeader header { .src_port = udinfo.src_port,
+                           .dst_port = udinfo.dst_port,
+                           .seqno = Wrap32Serializable { sender_message.seqno }.raw_value(),
+                           .ackno = ackno.raw_value(),
+                           .data_offset = TCPHeaderMinLen,
+                           .ack = receiver_message.ackno.has_value(),
+                           .rst = reset,
+                           .syn = sender_message.SYN,
+                           .fin = sender_message.FIN,
+                           .window_size = receiver_message.window_size,
+                           .cksum = udinfo.cksum,
+                           .urgent_pointer = 0 };
+  TCPHeaderLayout::serialize( header, serializer );
   serializer.buffer( sender_message.payload );
 }
 
+// Sum the header a 16-bit word at a time, straight from the fields (with a zero checksum), and then the payload
+// where it lies, instead of serializing the segment first
 void TCPSegment::compute_checksum( uint32_t datagram_layer_pseudo_checksum )
 {
-  udinfo.cksum = 0;
-  Serializer s;
-  serialize( s );
-
-  InternetChecksum check { datagram_layer_pseudo_checksum };
-  check.add( s.output() );
+  const uint32_t seqno = Wrap32Serializable { sender_message.seqno }.raw_value();
+  const uint32_t ackno = Wrap32Serializable { receiver_message.ackno.value_or( Wrap32 { 0 } ) }.raw_value();
+
+  uint32_t sum = datagram_layer_pseudo_checksum;
+  sum += udinfo.src_port;
+  sum += udinfo.dst_port;
+  sum += ( seqno >> 16 ) + static_cast<uint16_t>( seqno );
+  sum += ( ackno >> 16 ) + static_cast<uint16_t>( ackno );
+  sum += ( TCPHeaderMinLen << 12 ) | flags(); // data offset and flags
+  sum += receiver_message.window_size;
+  // (the checksum and urgent pointer are zero)
+
+  InternetChecksum check { sum };
+  check.add( sender_message.payload );
   udinfo.cksum = check.value();
 }
+
+void TCPSegment::compute_partial_checksum( uint32_t datagram_layer_pseudo_checksum )
+{
+  udinfo.cksum = static_cast<uint16_t>( ~InternetChecksum { datagram_layer_pseudo_checksum }.value() );
+}
@@ -1,10 +1,44 @@
 #pragma once
 
+#include "header_layout.hh"
 #include "parser.hh"
 #include "tcp_receiver_message.hh"
 #include "tcp_sender_message.hh"
 #include "udinfo.hh"
 
+#include <optional>
+
+// The fixed part of a TCP header (without options), field by field as it is laid out on the wire
+struct TCPHeader
+{
+  uint16_t src_port {};
+  uint16_t dst_port {};
+  uint32_t seqno {};
+  uint32_t ackno {};
+  uint8_t data_offset {}; // header length (multiples of 32 bits)
+  bool ack {};
+  bool rst {};
+  bool syn {};
+  bool fin {};
+  uint16_t window_size {};
+  uint16_t cksum {};
+  uint16_t urgent_pointer {};
+};
+
+using TCPHeaderLayout = HeaderLayout<TCPHeader,
+                                     Field<"src_port", &TCPHeader::src_port, 0, 2>,
+                                     Field<"dst_port", &TCPHeader::dst_port, 2, 2>,
+                                     Field<"seqno", &TCPHeader::seqno, 4, 4>,
+                                     Field<"ackno", &TCPHeader::ackno, 8, 4>,
+                                     Field<"data_offset", &TCPHeader::data_offset, 12, 1, 4, 4>,
+                                     Field<"ack", &TCPHeader::ack, 13, 1, 4, 1>,
+                                     Field<"rst", &TCPHeader::rst, 13, 1, 2, 1>,
+                                     Field<"syn", &TCPHeader::syn, 13, 1, 1, 1>,
+                                     Field<"fin", &TCPHeader::fin, 13, 1, 0, 1>,
+                                     Field<"window_size", &TCPHeader::window_size, 14, 2>,
+                                     Field<"cksum", &TCPHeader::cksum, 16, 2>,
+                                     Field<"urgent_pointer", &TCPHeader::urgent_pointer, 18, 2>>;
+
 struct TCPSegment
 {
   TCPSenderMessage sender_message {};
@@ -12,8 +46,16 @@ struct TCPSegment
   bool reset {}; // Connection experienced an abnormal error and should be shut down
   UserDatagramInfo udinfo {};
 
-  void parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum );
+  // Without a pseudo-header checksum, the checksum is not verified (e.g. the device has already done it)
+  void parse( Parser& parser, std::optional<uint32_t> datagram_layer_pseudo_checksum );
   void serialize( Serializer& serializer ) const;
 
+  // Set the checksum (computed from the header fields and the payload, without serializing the segment)
   void compute_checksum( uint32_t datagram_layer_pseudo_checksum );
+
+  // Set the checksum to cover only the pseudo-header, for a device to complete (checksum offload)
+  void compute_partial_checksum( uint32_t datagram_layer_pseudo_checksum );
+
+  // The flags byte of the header (ACK, RST, SYN and FIN)
+  uint8_t flags() const;
 };
@@ -1,6 +1,7 @@
 #include "tun.hh"
 #include "exception.hh"
 
+#include <cerrno>
 #include <cstring>
 #include <fcntl.h>
 #include <linux/if.h>
@@ -14,20 +15,34 @@ using namespace std;
 //! \param[in] devname is the name of the TUN or TAP device, specified at its creation.
 //! \param[in] is_tun is `true` for a TUN device (expects IP datagrams), or `false` for a TAP device (expects
 //! Ethernet frames)
+//! \param[in] multi_queue is `true` to attach one of the queues of a multi-queue device. Each TunTapFD opened
+//! this way is an independent queue that can be serviced by its own thread. The kernel delivers the packets of a
+//! flow (by 4-tuple hash) to the queue that most recently transmitted packets of that flow, but only while it
+//! remembers the flow, so sockets that share a device pass each other's packets on through a TunSteering.
+//! \param[in] vnet_hdr is `true` to exchange packets prefixed with a VirtioNetHeader. The kernel is then told
+//! that this side can take partial checksums and TCP/IPv4 super-packets (TSO), so it may hand over large
+//! unsegmented packets instead of MSS-sized ones, and it accepts the same from us. The flag applies to the whole
+//! device, so every queue of a device must agree on it.
 //!
 //! To create a TUN device, you should already have run
 //!
-//!     ip tuntap add mode tun user `username` name `devname`
+//!     ip tuntap add mode tun user `username` name `devname` [multi_queue]
 //!
 //! as root before calling this function.
 
-TunTapFD::TunTapFD( const string& devname, const bool is_tun )
-  : FileDescriptor( ::CheckSystemCall( "open", open( CLONEDEV, O_RDWR | O_CLOEXEC ) ) )
+TunTapFD::TunTapFD( const string& devname, const bool is_tun, const bool multi_queue, const bool vnet_hdr )
+  : FileDescriptor( ::CheckSystemCall( "open", open( CLONEDEV, O_RDWR | O_CLOEXEC ) ) ), vnet_hdr_( vnet_hdr )
 {
   struct ifreq tun_req
   {};
 
   tun_req.ifr_flags = static_cast<int16_t>( ( is_tun ? IFF_TUN : IFF_TAP ) | IFF_NO_PI ); // no packetinfo
+  if ( multi_queue ) {
+    tun_req.ifr_flags |= IFF_MULTI_QUEUE;
+  }
+  if ( vnet_hdr ) {
+    tun_req.ifr_flags |= IFF_VNET_HDR;
+  }
 
   // copy devname to ifr_name, making sure to null terminate
 
@@ -35,4 +50,22 @@ TunTapFD::TunTapFD( const string& devname, const bool is_tun )
   tun_req.ifr_name[IFNAMSIZ - 1] = '\0';
 
   CheckSystemCall( "ioctl", ioctl( fd_num(), TUNSETIFF, static_cast<void*>( &tun_req ) ) );
+
+  if ( vnet_hdr ) {
+    CheckSystemCall( "ioctl", ioctl( fd_num(), TUNSETOFFLOAD, TUN_F_CSUM | TUN_F_TSO4 ) );
+  }
+}
+
+//! \details The kernel refuses (with EINVAL) to attach a queue whose IFF_MULTI_QUEUE flag differs from the
+//! device's, so a device that turns down a multi-queue attach is opened as a single-queue one instead.
+TunFD TunFD::open_queue( const string& devname )
+{
+  try {
+    return TunFD { devname, true };
+  } catch ( const unix_error& e ) {
+    if ( e.error_code() != EINVAL ) {
+      throw;
+    }
+    return TunFD { devname };
+  }
 }
@@ -3,14 +3,26 @@
 #include "file_descriptor.hh"
 
 #include <string>
+#include <utility>
 
 //! A FileDescriptor to a [Linux TUN/TAP](https://www.kernel.org/doc/Documentation/networking/tuntap.txt) device
 class TunTapFD : public FileDescriptor
 {
+  bool vnet_hdr_;
+
 public:
   //! Open an existing persistent [TUN or TAP
   //! device](https://www.kernel.org/doc/Documentation/networking/tuntap.txt).
-  explicit TunTapFD( const std::string& devname, bool is_tun );
+  //! With `multi_queue`, attach one more queue of a device created with `multi_queue`.
+  //! With `vnet_hdr`, every packet read or written is preceded by a VirtioNetHeader.
+  TunTapFD( const std::string& devname, bool is_tun, bool multi_queue = false, bool vnet_hdr = false );
+
+  //! Use an fd that already behaves like a TUN or TAP device (e.g. one end of a datagram socketpair standing in
+  //! for the kernel in a test)
+  TunTapFD( FileDescriptor&& fd, bool vnet_hdr ) : FileDescriptor( std::move( fd ) ), vnet_hdr_( vnet_hdr ) {}
+
+  //! Is every packet preceded by a VirtioNetHeader?
+  bool vnet_hdr() const { return vnet_hdr_; }
 };
 
 //! A FileDescriptor to a [Linux TUN](https://www.kernel.org/doc/Documentation/networking/tuntap.txt) device
@@ -18,7 +30,16 @@ class TunFD : public TunTapFD
 {
 public:
   //! Open an existing persistent [TUN device](https://www.kernel.org/doc/Documentation/networking/tuntap.txt).
-  explicit TunFD( const std::string& devname ) : TunTapFD( devname, true ) {}
+  explicit TunFD( const std::string& devname, bool multi_queue = false, bool vnet_hdr = false )
+    : TunTapFD( devname, true, multi_queue, vnet_hdr )
+  {}
+
+  //! Use an fd that already behaves like a TUN device
+  TunFD( FileDescriptor&& fd, bool vnet_hdr ) : TunTapFD( std::move( fd ), vnet_hdr ) {}
+
+  //! Attach one more queue of a multi-queue TUN device, or, if the device was created without `multi_queue`,
+  //! its only queue
+  static TunFD open_queue( const std::string& devname );
 };
 
 //! A FileDescriptor to a [Linux TAP](https://www.kernel.org/doc/Documentation/networking/tuntap.txt) device
@@ -26,5 +47,7 @@ class TapFD : public TunTapFD
 {
 public:
   //! Open an existing persistent [TAP device](https://www.kernel.org/doc/Documentation/networking/tuntap.txt).
-  explicit TapFD( const std::string& devname ) : TunTapFD( devname, false ) {}
+  explicit TapFD( const std::string& devname, bool multi_queue = false, bool vnet_hdr = false )
+    : TunTapFD( devname, false, multi_queue, vnet_hdr )
+  {}
 };
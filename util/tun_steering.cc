@@ -0,0 +1,112 @@
+#include "tun_steering.hh"
+
+#include "exception.hh"
+#include "ipv4_header.hh"
+#include "packet_view.hh"
+
+#include <array>
+#include <sys/socket.h>
+
+using namespace std;
+
+//! \returns nothing if the datagram is not a whole-enough IPv4 datagram carrying the ports of a TCP segment
+optional<TunSteering::Flow> TunSteering::inbound_flow( const string_view datagram )
+{
+  if ( not ConstIPv4View::valid( datagram ) ) {
+    return {};
+  }
+  const ConstIPv4View view { datagram.data(), datagram.size() };
+  if ( view.proto() != IPv4Header::PROTO_TCP or not view.has_ports() ) {
+    return {};
+  }
+  return Flow { view.dst(), view.dst_port(), view.src(), view.src_port() };
+}
+
+//! Connected Unix-domain datagram sockets, neither of which blocks
+static pair<FileDescriptor, FileDescriptor> nonblocking_datagram_pair()
+{
+  array<int, 2> fds {};
+  CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0, fds.data() ) );
+  pair<FileDescriptor, FileDescriptor> ends { FileDescriptor( fds[0] ), FileDescriptor( fds[1] ) };
+  ends.first.set_blocking( false );
+  ends.second.set_blocking( false );
+  return ends;
+}
+
+TunSteering::Inbox::Inbox( shared_ptr<TunSteering> steering )
+  : Inbox( move( steering ), nonblocking_datagram_pair() )
+{}
+
+TunSteering::Inbox::Inbox( shared_ptr<TunSteering> steering, pair<FileDescriptor, FileDescriptor> ends )
+  : steering_( move( steering ) ), reader_( move( ends.first ) ), writer_( move( ends.second ) )
+{}
+
+TunSteering::Inbox::~Inbox()
+{
+  if ( flow_ ) {
+    const lock_guard lock { steering_->mutex_ };
+    steering_->release( flow_.value(), this );
+  }
+}
+
+//! \details A flow claimed by another Inbox is taken over (the last socket to claim a connection gets its packets).
+void TunSteering::Inbox::claim( const Flow& flow )
+{
+  const lock_guard lock { steering_->mutex_ };
+  if ( flow_ ) {
+    steering_->release( flow_.value(), this );
+  }
+  steering_->claims_[flow] = this;
+  flow_ = flow;
+}
+
+//! \details A packet of the connection this Inbox claims is recognized without taking the lock, so a connected
+//! socket pays for the lookup only on the packets that the kernel put on the wrong queue.
+bool TunSteering::Inbox::pass_on( const string_view packet, const Flow& flow )
+{
+  if ( flow_ == flow ) {
+    return false;
+  }
+
+  const lock_guard lock { steering_->mutex_ };
+  Inbox* const owner = steering_->owner( flow );
+  if ( owner == nullptr or owner == this ) {
+    return false;
+  }
+  owner->writer_.write( packet ); // (when the Inbox is full, the packet is dropped, as the device would have)
+  return true;
+}
+
+void TunSteering::release( const Flow& flow, const Inbox* inbox )
+{
+  if ( const auto it = claims_.find( flow ); it != claims_.end() and it->second == inbox ) {
+    claims_.erase( it );
+  }
+}
+
+TunSteering::Inbox* TunSteering::owner( const Flow& flow ) const
+{
+  for ( const Flow& claim : { flow,
+                              Flow { flow.local_address, flow.local_port, 0, 0 },
+                              Flow { 0, flow.local_port, 0, 0 } } ) {
+    if ( const auto it = claims_.find( claim ); it != claims_.end() ) {
+      return it->second;
+    }
+  }
+  return nullptr;
+}
+
+shared_ptr<TunSteering> TunSteering::for_device( const string& devname )
+{
+  static mutex registry_mutex;
+  static map<string, weak_ptr<TunSteering>> registry;
+
+  const lock_guard lock { registry_mutex };
+  auto& entry = registry[devname];
+  shared_ptr<TunSteering> steering = entry.lock();
+  if ( not steering ) {
+    steering = make_shared<TunSteering>();
+    entry = steering;
+  }
+  return steering;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "file_descriptor.hh"
+
+#include <compare>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+//! \brief The TCP connections of the sockets in this process that share a multi-queue TUN device, so that a socket
+//! that reads a packet of another one's connection can pass it on.
+//! \details The kernel puts an inbound packet on the queue that last sent a packet of the same flow, but only while
+//! it remembers the flow: it forgets one 3 to 6 s after the flow last sent anything, and never records one that
+//! sent while the device had a single queue. Other packets go to a queue picked by their hash, often another
+//! socket's. So each socket claims its connection with an Inbox (a datagram socketpair, whose reading end it
+//! services next to its queue), and passes on every packet that belongs to another socket's Inbox.
+class TunSteering
+{
+public:
+  //! A TCP connection, as seen from this side. A listening socket's flow has a remote address and port of 0 (any
+  //! peer), and a local address of 0 stands for any local address.
+  struct Flow
+  {
+    uint32_t local_address {};
+    uint16_t local_port {};
+    uint32_t remote_address {};
+    uint16_t remote_port {};
+
+    auto operator<=>( const Flow& other ) const = default;
+  };
+
+  //! The flow of an inbound IPv4 datagram carrying a TCP segment (read from the device, so its destination is
+  //! the local side)
+  static std::optional<Flow> inbound_flow( std::string_view datagram );
+
+  //! Where the packets of one socket's connection arrive when another socket reads them
+  class Inbox
+  {
+    std::shared_ptr<TunSteering> steering_;
+    FileDescriptor reader_;
+    FileDescriptor writer_;
+    std::optional<Flow> flow_ {};
+
+    //! Construct from the two ends of a datagram socketpair
+    Inbox( std::shared_ptr<TunSteering> steering, std::pair<FileDescriptor, FileDescriptor> ends );
+
+  public:
+    explicit Inbox( std::shared_ptr<TunSteering> steering );
+    ~Inbox();
+
+    //! Take the packets of `flow` (instead of those of any flow claimed before)
+    void claim( const Flow& flow );
+
+    //! If `packet` (of `flow`) belongs to another Inbox, pass it on there
+    //! \returns true if the packet belongs to another Inbox (it is dropped if that one is full)
+    bool pass_on( std::string_view packet, const Flow& flow );
+
+    //! The end to read the packets passed on to this Inbox from
+    FileDescriptor& fd() { return reader_; }
+
+    //! \name
+    //! An Inbox stays where it is while it has a claim, so it cannot be copied or moved
+
+    //!@{
+    Inbox( const Inbox& other ) = delete;
+    Inbox( Inbox&& other ) = delete;
+    Inbox& operator=( const Inbox& other ) = delete;
+    Inbox& operator=( Inbox&& other ) = delete;
+    //!@}
+  };
+
+  //! The steering shared by the sockets of this process on the device named `devname`
+  static std::shared_ptr<TunSteering> for_device( const std::string& devname );
+
+private:
+  std::mutex mutex_ {};
+  std::map<Flow, Inbox*> claims_ {}; //!< Each claimed flow, and the Inbox that claimed it
+
+  //! Drop `inbox`'s claim on `flow` (unless another Inbox has taken the flow over since)
+  void release( const Flow& flow, const Inbox* inbox );
+
+  //! The Inbox whose claim takes the packets of `flow` (the connection's own, or else a listening one), if any
+  Inbox* owner( const Flow& flow ) const;
+};
@@ -1,22 +1,131 @@
 #include "tuntap_adapter.hh"
+#include "packet_pool.hh"
 #include "parser.hh"
 
 using namespace std;
 
+static constexpr size_t MAX_DATAGRAM_LENGTH = 65535; // (the largest that an IPv4 header's length can describe)
+
+//! \details If the device takes virtio-net headers, the datagram may be a super-datagram (the kernel hands over
+//! large segments without cutting them to the MTU), and its TCP checksum is trusted if the header says so. The
+//! read then has room for the largest IPv4 datagram, so that a super-datagram is never cut short.
 optional<TCPSegment> TCPOverIPv4OverTunFdAdapter::read()
 {
-  vector<string> strs( 2 );
-  strs.front().resize( IPv4Header::LENGTH );
+  if ( not _tun.vnet_hdr() ) {
+    vector<string> strs( 2 );
+    strs.front().resize( IPv4Header::LENGTH );
+    _tun.read( strs );
+
+    InternetDatagram ip_dgram;
+    const vector<Buffer> buffers = { move( strs.at( 0 ) ), move( strs.at( 1 ) ) };
+    if ( parse( ip_dgram, buffers ) ) {
+      return unwrap_tcp_in_ip( ip_dgram );
+    }
+    return {};
+  }
+
+  vector<string> strs( 3 );
+  strs.at( 0 ).resize( VirtioNetHeader::LENGTH );
+  strs.at( 1 ).resize( IPv4Header::LENGTH );
+  strs.at( 2 ) = PacketPool::take( MAX_DATAGRAM_LENGTH - IPv4Header::LENGTH );
+  strs.at( 2 ).resize( MAX_DATAGRAM_LENGTH - IPv4Header::LENGTH );
   _tun.read( strs );
 
+  VirtioNetHeader vnet;
   InternetDatagram ip_dgram;
-  const vector<Buffer> buffers = { strs.at( 0 ), strs.at( 1 ) };
-  if ( parse( ip_dgram, buffers ) ) {
-    return unwrap_tcp_in_ip( ip_dgram );
+  const vector<Buffer> buffers = { move( strs.at( 1 ) ), move( strs.at( 2 ) ) };
+  if ( parse( vnet, { strs.at( 0 ) } ) and parse( ip_dgram, buffers ) ) {
+    return unwrap_tcp_in_ip( ip_dgram, vnet.checksum_valid() );
   }
   return {};
 }
 
+//! \param[in] packet the bytes of one packet read from the device (with its virtio-net header, if the device takes
+//! them); they are copied, so they need not outlive the call
+optional<TCPSegment> TCPOverIPv4OverTunFdAdapter::receive( const string_view packet )
+{
+  if ( _inbox ) {
+    const size_t vnet_length = _tun.vnet_hdr() ? min( VirtioNetHeader::LENGTH, packet.size() ) : 0;
+    const auto flow = TunSteering::inbound_flow( packet.substr( vnet_length ) );
+    if ( flow and _inbox->pass_on( packet, flow.value() ) ) {
+      return {};
+    }
+  }
+
+  string bytes = PacketPool::take( packet.size() );
+  bytes.assign( packet );
+  Buffer datagram { move( bytes ) };
+
+  VirtioNetHeader vnet;
+  if ( _tun.vnet_hdr() ) {
+    if ( not parse( vnet, { datagram } ) ) {
+      return {};
+    }
+    datagram.remove_prefix( VirtioNetHeader::LENGTH );
+  }
+
+  InternetDatagram ip_dgram;
+  if ( not parse( ip_dgram, { datagram } ) ) {
+    return {};
+  }
+  const bool was_listening = listening();
+  optional<TCPSegment> seg = unwrap_tcp_in_ip( ip_dgram, vnet.checksum_valid() );
+  if ( was_listening and not listening() ) {
+    claim_flow(); // (the connection accepted, rather than every one to the port)
+  }
+  return seg;
+}
+
+void TCPOverIPv4OverTunFdAdapter::claim_flow()
+{
+  if ( not _inbox ) {
+    return;
+  }
+  const Address& source = config().source;
+  const Address& destination = config().destination;
+  if ( listening() ) {
+    _inbox->claim( { source.ipv4_numeric(), source.port(), 0, 0 } );
+  } else {
+    _inbox->claim( { source.ipv4_numeric(), source.port(), destination.ipv4_numeric(), destination.port() } );
+  }
+}
+
+size_t TCPOverIPv4OverTunFdAdapter::max_packet_size() const
+{
+  return ( _tun.vnet_hdr() ? VirtioNetHeader::LENGTH : 0 ) + MAX_DATAGRAM_LENGTH;
+}
+
+//! \param[in] seg the TCPSegment to send
+void TCPOverIPv4OverTunFdAdapter::write( TCPSegment& seg )
+{
+  if ( not _tun.vnet_hdr() ) {
+    IPv4Header header;
+    _tun.write( build_tcp_in_ip( seg, header ) );
+    return;
+  }
+
+  queue<TCPSegment> segments;
+  segments.push( seg );
+  write( segments );
+}
+
+//! \param[in,out] segments the TCPSegments to send; the queue is emptied
+void TCPOverIPv4OverTunFdAdapter::write( queue<TCPSegment>& segments )
+{
+  while ( not segments.empty() ) {
+    if ( not _tun.vnet_hdr() ) {
+      write( segments.front() );
+      segments.pop();
+      continue;
+    }
+
+    auto [vnet, ip_dgram] = wrap_tcp_in_ip_gso( segments );
+    vector<Buffer> buffers = serialize( vnet );
+    ranges::move( serialize( ip_dgram ), back_inserter( buffers ) );
+    _tun.write( buffers );
+  }
+}
+
 //! \param[in] tap Raw network device that will be owned by the adapter
 //! \param[in] eth_address Ethernet address (local address) of the adapter
 //! \param[in] ip_address IP address (local address) of the adapter
@@ -41,10 +150,28 @@ optional<TCPSegment> TCPOverIPv4OverEthernetAdapter::read()
   strs.at( 1 ).resize( IPv4Header::LENGTH );
   _tap.read( strs );
 
-  EthernetFrame frame;
   vector<Buffer> buffers;
-  ranges::transform( strs, back_inserter( buffers ), identity() );
-  if ( not parse( frame, buffers ) ) {
+  ranges::move( strs, back_inserter( buffers ) );
+  return receive_frame( buffers );
+}
+
+//! \param[in] frame the bytes of one frame read from the device; they are copied, so they need not outlive the call
+optional<TCPSegment> TCPOverIPv4OverEthernetAdapter::receive( const string_view frame )
+{
+  string bytes = PacketPool::take( frame.size() );
+  bytes.assign( frame );
+  return receive_frame( { Buffer { move( bytes ) } } );
+}
+
+size_t TCPOverIPv4OverEthernetAdapter::max_packet_size()
+{
+  return EthernetHeader::LENGTH + MAX_DATAGRAM_LENGTH;
+}
+
+optional<TCPSegment> TCPOverIPv4OverEthernetAdapter::receive_frame( const vector<Buffer>& frame_bytes )
+{
+  EthernetFrame frame;
+  if ( not parse( frame, frame_bytes ) ) {
     return {};
   }
 
@@ -5,10 +5,15 @@
 #include "tcp_over_ip.hh"
 #include "tcp_segment.hh"
 #include "tun.hh"
+#include "tun_steering.hh"
 
+#include <memory>
 #include <optional>
+#include <queue>
+#include <string_view>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 //! \brief A FD adapter for IPv4 datagrams read from and written to a TUN device
 class TCPOverIPv4OverTunFdAdapter : public TCPOverIPv4Adapter
@@ -16,15 +21,41 @@ class TCPOverIPv4OverTunFdAdapter : public TCPOverIPv4Adapter
 private:
   TunFD _tun;
 
+  //! Where the packets of this adapter's connection arrive when another socket on the device reads them (if the
+  //! device is shared through a TunSteering)
+  std::unique_ptr<TunSteering::Inbox> _inbox {};
+
 public:
   //! Construct from a TunFD
   explicit TCPOverIPv4OverTunFdAdapter( TunFD&& tun ) : _tun( std::move( tun ) ) {}
 
+  //! Construct from one queue of a device shared with other sockets of this process through `steering`
+  TCPOverIPv4OverTunFdAdapter( TunFD&& tun, std::shared_ptr<TunSteering> steering )
+    : _tun( std::move( tun ) ), _inbox( std::make_unique<TunSteering::Inbox>( std::move( steering ) ) )
+  {}
+
+  //! Claim the connection that the configuration (and listening flag) describes, if the device is shared
+  void claim_flow();
+
+  //! The inbox of packets passed on by other sockets on the device, or nullptr if the device is not shared
+  FileDescriptor* inbox() { return _inbox ? &_inbox->fd() : nullptr; }
+
   //! Attempts to read and parse an IPv4 datagram containing a TCP segment related to the current connection
   std::optional<TCPSegment> read();
 
+  //! Like read(), but parses a packet that was read from the device (or from the inbox) by someone else (e.g.
+  //! an EventLoop); a packet of another socket's connection is passed on to that socket
+  std::optional<TCPSegment> receive( std::string_view packet );
+
+  //! The longest packet that a read from the device can return
+  size_t max_packet_size() const;
+
   //! Creates an IPv4 datagram from a TCP segment and writes it to the TUN device
-  void write( TCPSegment& seg ) { _tun.write( serialize( wrap_tcp_in_ip( seg ) ) ); }
+  void write( TCPSegment& seg );
+
+  //! Writes a queue of TCP segments to the TUN device, combining runs of segments into super-datagrams
+  //! if the device takes virtio-net headers
+  void write( std::queue<TCPSegment>& segments );
 
   //! Access the underlying TUN device
   explicit operator TunFD&() { return _tun; }
@@ -51,6 +82,9 @@ private:
 
   void send_pending(); //!< Sends any pending Ethernet frames
 
+  //! Parses a frame read from the device
+  std::optional<TCPSegment> receive_frame( const std::vector<Buffer>& frame_bytes );
+
 public:
   //! Construct from a TapFD
   explicit TCPOverIPv4OverEthernetAdapter( TapFD&& tap,
@@ -60,6 +94,12 @@ public:
   //! Attempts to read and parse an Ethernet frame containing an IPv4 datagram that contains a TCP segment
   std::optional<TCPSegment> read();
 
+  //! Like read(), but parses a frame that was read from the device by someone else (e.g. an EventLoop)
+  std::optional<TCPSegment> receive( std::string_view frame );
+
+  //! The longest frame that a read from the device can return
+  static size_t max_packet_size();
+
   //! Sends a TCP segment (in an IPv4 datagram, in an Ethernet frame).
   void write( TCPSegment& seg );
 
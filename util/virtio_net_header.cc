@@ -0,0 +1,35 @@
+#include "virtio_net_header.hh"
+
+#include <bit>
+
+// (linux/virtio_net.h cannot be included from C++, so the constants in the header are spelled out by hand)
+
+using namespace std;
+
+// The Parser and Serializer use network byte order, but a TUN/TAP device uses the host's
+static uint16_t to_host_order( const uint16_t value )
+{
+  if constexpr ( endian::native == endian::little ) {
+    return static_cast<uint16_t>( ( value >> 8 ) | ( value << 8 ) );
+  }
+  return value;
+}
+
+void VirtioNetHeader::parse( Parser& parser )
+{
+  parser.integer( flags );
+  parser.integer( gso_type );
+  for ( uint16_t* field : { &hdr_len, &gso_size, &csum_start, &csum_offset } ) {
+    parser.integer( *field );
+    *field = to_host_order( *field );
+  }
+}
+
+void VirtioNetHeader::serialize( Serializer& serializer ) const
+{
+  serializer.integer( flags );
+  serializer.integer( gso_type );
+  for ( const uint16_t field : { hdr_len, gso_size, csum_start, csum_offset } ) {
+    serializer.integer( to_host_order( field ) );
+  }
+}
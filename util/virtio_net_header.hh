@@ -0,0 +1,34 @@
+#pragma once
+
+#include "parser.hh"
+
+#include <cstddef>
+#include <cstdint>
+
+// The virtio-net header that precedes every packet on a TUN/TAP device opened with IFF_VNET_HDR
+// (struct virtio_net_hdr, in the host's byte order). It carries checksum and segmentation offload
+// metadata, so that one "super-packet" can stand for a run of segments and so that checksums
+// can be left for the other side to fill in (or trusted without being recomputed).
+struct VirtioNetHeader
+{
+  static constexpr size_t LENGTH = 10; // virtio-net header length (without the num_buffers field)
+
+  static constexpr uint8_t F_NEEDS_CSUM = 1; // checksum is partial: complete it from csum_start onwards
+  static constexpr uint8_t F_DATA_VALID = 2; // checksum has already been verified
+
+  static constexpr uint8_t GSO_NONE = 0;  // not a super-packet
+  static constexpr uint8_t GSO_TCPV4 = 1; // TCP/IPv4 super-packet, to be cut into gso_size segments
+
+  uint8_t flags = 0;           // F_* flags
+  uint8_t gso_type = GSO_NONE; // kind of segmentation needed
+  uint16_t hdr_len = 0;        // length of the headers that are replicated in every segment
+  uint16_t gso_size = 0;       // payload bytes per segment (all but the last)
+  uint16_t csum_start = 0;     // where checksumming starts
+  uint16_t csum_offset = 0;    // where the checksum is stored, relative to csum_start
+
+  // Can the packet's transport-layer checksum be accepted without verifying it?
+  bool checksum_valid() const { return flags & ( F_NEEDS_CSUM | F_DATA_VALID ); }
+
+  void parse( Parser& parser );
+  void serialize( Serializer& serializer ) const;
+};